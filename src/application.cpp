@@ -1,12 +1,30 @@
 #include <application.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdlib>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <utility>
 
+namespace {
+
+// Maximum number of bytes of the cached frames of a time series.
+constexpr std::size_t series_cache_budget { std::size_t { 2 } << 30 };
+
+}
+
 Application::Application()
-    : ApplicationBase { "Test application" }
+    : Application { ApplicationOptions {} }
+{
+}
+
+Application::Application(const ApplicationOptions& options)
+    : ApplicationBase { "Test application", options }
     , m_shader_module { nullptr }
     , m_pipeline_layout { nullptr }
     , m_render_pipeline { nullptr }
@@ -15,7 +33,36 @@ Application::Application()
     , m_show_demo_window { true }
     , m_show_another_window { false }
     , m_clear_color { 0.45f, 0.55f, 0.60f, 1.0f }
+    , m_volume_loader { std::make_unique<VolumeLoader>() }
+    , m_volume_load {}
+    , m_volume { nullptr }
+    , m_volume_path {}
+    , m_device_limits { VolumeDeviceLimits::query(this->device()) }
+    , m_volume_fit_mode { VolumeFitMode::Resample }
+    , m_volume_fit {}
+    , m_volume_resampled_extends {}
+    , m_volume_bricks { nullptr }
+    , m_gpu_normalizer { std::make_unique<GPUVolumeNormalizer>(this->device()) }
+    , m_gpu_upload {}
+    , m_gpu_volume_info {}
+    , m_gpu_error {}
+    , m_gpu_normalization { false }
+    , m_volume_textures { this->device() }
+    , m_volume_renderer { std::make_unique<VolumeRenderer>(this->device(), this->surface_format()) }
+    , m_render_settings {}
+    , m_series { nullptr }
+    , m_series_pattern {}
+    , m_series_error {}
+    , m_series_frame { 0 }
+    , m_series_shown_frame { std::numeric_limits<std::size_t>::max() }
+    , m_series_playing { false }
+    , m_series_fps { 10.0f }
+    , m_series_time { 0.0f }
+    , m_volume_memory_budget_id {}
+    , m_volume_memory_budget { 8.0f }
 {
+    this->register_memory_budget();
+
     wgpu::ShaderModuleWGSLDescriptor wgsl_module_desc { wgpu::Default };
     wgsl_module_desc.code = R"(
         @vertex
@@ -83,11 +130,57 @@ Application::Application(Application&& app)
     , m_show_demo_window { std::exchange(app.m_show_demo_window, true) }
     , m_show_another_window { std::exchange(app.m_show_another_window, false) }
     , m_clear_color { std::exchange(app.m_clear_color, { 0.45f, 0.55f, 0.60f, 1.00f }) }
+    , m_volume_loader { std::move(app.m_volume_loader) }
+    , m_volume_load { std::move(app.m_volume_load) }
+    , m_volume { std::move(app.m_volume) }
+    , m_volume_path { app.m_volume_path }
+    , m_device_limits { app.m_device_limits }
+    , m_volume_fit_mode { app.m_volume_fit_mode }
+    , m_volume_fit { std::move(app.m_volume_fit) }
+    , m_volume_resampled_extends { std::move(app.m_volume_resampled_extends) }
+    , m_volume_bricks { std::move(app.m_volume_bricks) }
+    , m_gpu_normalizer { std::move(app.m_gpu_normalizer) }
+    , m_gpu_upload { std::move(app.m_gpu_upload) }
+    , m_gpu_volume_info { std::move(app.m_gpu_volume_info) }
+    , m_gpu_error { std::move(app.m_gpu_error) }
+    , m_gpu_normalization { std::exchange(app.m_gpu_normalization, false) }
+    , m_volume_textures { std::move(app.m_volume_textures) }
+    , m_volume_renderer { std::move(app.m_volume_renderer) }
+    , m_render_settings { app.m_render_settings }
+    , m_series { std::move(app.m_series) }
+    , m_series_pattern { app.m_series_pattern }
+    , m_series_error { std::move(app.m_series_error) }
+    , m_series_frame { std::exchange(app.m_series_frame, 0) }
+    , m_series_shown_frame { std::exchange(app.m_series_shown_frame, std::numeric_limits<std::size_t>::max()) }
+    , m_series_playing { std::exchange(app.m_series_playing, false) }
+    , m_series_fps { std::exchange(app.m_series_fps, 10.0f) }
+    , m_series_time { std::exchange(app.m_series_time, 0.0f) }
+    , m_volume_memory_budget_id {}
+    , m_volume_memory_budget { app.m_volume_memory_budget }
 {
+    // The budget callback refers to the application, so it is registered again.
+    if (app.m_volume_memory_budget_id) {
+        MemoryTracker::instance().remove_budget(*std::exchange(app.m_volume_memory_budget_id, std::nullopt));
+        this->register_memory_budget();
+    }
 }
 
 Application::~Application()
 {
+    // The tasks of the shared scheduler outlive the application, so the
+    // upload and the fit have to finish before the normalizer and the device
+    // are destroyed.
+    if (this->m_gpu_upload.valid()) {
+        this->m_gpu_upload.wait();
+    }
+    if (this->m_volume_fit.valid()) {
+        this->m_volume_fit.wait();
+    }
+
+    if (this->m_volume_memory_budget_id) {
+        MemoryTracker::instance().remove_budget(*this->m_volume_memory_budget_id);
+    }
+
     if (this->m_render_pipeline) {
         this->m_render_pipeline.release();
     }
@@ -101,8 +194,11 @@ Application::~Application()
     }
 }
 
-void Application::on_frame(wgpu::CommandEncoder& encoder, wgpu::TextureView& frame)
+void Application::on_frame(FrameGraph& frame_graph, wgpu::TextureView& frame)
 {
+    // Uploads staged during the last frame become visible now.
+    this->m_volume_textures.swap();
+
     ImGui::Begin("Hello, world!"); // Create a window called "Hello, World!".
 
     ImGui::Text("This is some useful text."); // Display a string.
@@ -123,23 +219,364 @@ void Application::on_frame(wgpu::CommandEncoder& encoder, wgpu::TextureView& fra
 
     ImGui::End();
 
-    auto color_attachments = std::array { wgpu::RenderPassColorAttachment { wgpu::Default } };
-    color_attachments[0].view = frame;
-    color_attachments[0].loadOp = wgpu::LoadOp::Clear;
-    color_attachments[0].storeOp = wgpu::StoreOp::Store;
-    color_attachments[0].clearValue = wgpu::Color { this->m_clear_color.x, this->m_clear_color.y, this->m_clear_color.z, this->m_clear_color.w };
-
-    wgpu::RenderPassDescriptor pass_desc { wgpu::Default };
-    pass_desc.colorAttachmentCount = color_attachments.size();
-    pass_desc.colorAttachments = color_attachments.data();
-    auto pass_encoder = encoder.beginRenderPass(pass_desc);
-    if (!pass_encoder) {
-        std::cerr << "Could not create render pass!" << std::endl;
-        std::exit(EXIT_FAILURE);
+    this->draw_volume_window();
+    this->draw_series_window();
+    this->update_series_playback();
+    this->draw_memory_window();
+    MemoryTracker::instance().check_budgets();
+
+    wgpu::Color clear_color { this->m_clear_color.x, this->m_clear_color.y, this->m_clear_color.z, this->m_clear_color.w };
+    frame_graph.add_render_pass(
+        "Application", frame, [this](wgpu::RenderPassEncoder& pass_encoder) {
+            pass_encoder.setPipeline(this->m_render_pipeline);
+            pass_encoder.draw(3, 1, 0, 0);
+        },
+        clear_color);
+
+    if (VolumeTexture* texture = this->m_volume_textures.front()) {
+        glm::vec3 size { texture->extends() };
+        if (const auto& volume = this->m_volume_textures.front_volume()) {
+            size *= volume->scale();
+        }
+        glm::vec2 target_size { this->frame_size() };
+        this->m_volume_renderer->prepare(*texture, size, this->m_render_settings, target_size.x / std::max(target_size.y, 1.0f));
+        frame_graph.add_render_pass("Volume", frame, [this](wgpu::RenderPassEncoder& pass_encoder) {
+            this->m_volume_renderer->draw(pass_encoder);
+        });
+    }
+}
+
+BenchmarkRecord Application::run_benchmark(const BenchmarkOptions& options)
+{
+    // The volume is loaded and fitted before the first frame, so every run
+    // starts from the same state. The demo window is hidden, as it would
+    // dominate the CPU time of the frames.
+    auto volume = std::make_shared<const PVMVolume>(options.volume);
+    this->finish_volume_fit(fit_volume(std::move(volume), this->m_device_limits, this->m_volume_fit_mode));
+    this->m_show_demo_window = false;
+
+    BenchmarkRecord record {};
+    std::size_t frame_count { options.warmup_frames + options.frames };
+    for (std::size_t frame { 0 }; frame < frame_count && !this->should_close(); ++frame) {
+        std::size_t script_frame { frame < options.warmup_frames ? 0 : frame - options.warmup_frames };
+        this->m_render_settings = options.script.settings(static_cast<float>(script_frame) * options.timestep, this->m_render_settings);
+
+        auto timing = this->render_frame(options.timestep, true);
+        if (timing && frame >= options.warmup_frames) {
+            record.add(timing->cpu_ms, timing->gpu_ms);
+        }
+    }
+    return record;
+}
+
+void Application::draw_volume_window()
+{
+    ImGui::Begin("Volume");
+
+    bool loading { (this->m_volume_load.valid() && !this->m_volume_load.done()) || this->m_volume_fit.valid() };
+    bool uploading { this->m_gpu_upload.valid() };
+    ImGui::BeginDisabled(loading || uploading);
+    ImGui::InputText("Path", this->m_volume_path.data(), this->m_volume_path.size());
+    ImGui::SameLine();
+    if (ImGui::Button("Load")) {
+        if (this->m_gpu_normalization) {
+            // The raw voxels are streamed into GPU buffers by a task of the shared
+            // scheduler, the reduction and normalization run on the GPU afterwards.
+            this->m_gpu_error.clear();
+            this->m_gpu_upload = TaskScheduler::shared().async(
+                [normalizer = this->m_gpu_normalizer.get(), path = std::string { this->m_volume_path.data() }]() {
+                    return normalizer->upload(path);
+                });
+            uploading = true;
+        } else {
+            this->m_gpu_error.clear();
+            this->m_volume_load = this->m_volume_loader->load(this->m_volume_path.data());
+            loading = true;
+        }
+    }
+    ImGui::Checkbox("Normalize on GPU", &this->m_gpu_normalization);
+    int fit_mode { static_cast<int>(this->m_volume_fit_mode) };
+    if (ImGui::Combo("Oversized volumes", &fit_mode, "Resample\0Split into textures\0")) {
+        this->m_volume_fit_mode = static_cast<VolumeFitMode>(fit_mode);
+    }
+    ImGui::EndDisabled();
+
+    if (uploading) {
+        if (this->m_gpu_upload.wait_for(std::chrono::seconds { 0 }) == std::future_status::ready) {
+            try {
+                GPURawVolume raw_volume { this->m_gpu_upload.get() };
+                const PVMInfo& info { raw_volume.info() };
+                this->m_volume_textures.stage(this->m_gpu_normalizer->normalize(raw_volume));
+                this->m_gpu_volume_info = info;
+                this->m_volume.reset();
+                this->m_volume_resampled_extends.reset();
+                this->m_volume_bricks.reset();
+                this->m_series.reset();
+            } catch (const std::exception& e) {
+                this->m_gpu_error = e.what();
+            }
+        } else {
+            ImGui::Text("Uploading raw voxels...");
+        }
+    }
+    if (!this->m_gpu_error.empty()) {
+        ImGui::TextColored(ImVec4 { 1.0f, 0.3f, 0.3f, 1.0f }, "Failed: %s", this->m_gpu_error.c_str());
+    }
+
+    if (this->m_volume_load.valid()) {
+        const PVMLoadProgress& progress { this->m_volume_load.progress() };
+        std::size_t bytes_total { progress.bytes_total };
+        std::size_t voxels_total { progress.voxels_total };
+        float read_fraction { bytes_total != 0 ? static_cast<float>(progress.bytes_read) / static_cast<float>(bytes_total) : 0.0f };
+        float normalized_fraction { voxels_total != 0 ? static_cast<float>(progress.voxels_normalized) / static_cast<float>(voxels_total) : 0.0f };
+
+        switch (this->m_volume_load.status()) {
+        case VolumeLoadStatus::Queued:
+            ImGui::Text("Queued");
+            break;
+        case VolumeLoadStatus::Loading:
+            ImGui::ProgressBar(read_fraction, ImVec2 { -1.0f, 0.0f }, "read");
+            ImGui::Text("decoded %.1f MiB", static_cast<double>(progress.bytes_decoded) / (1 << 20));
+            ImGui::ProgressBar(normalized_fraction, ImVec2 { -1.0f, 0.0f }, "normalized");
+            break;
+        case VolumeLoadStatus::Finished:
+            // Volumes exceeding the device limits are resampled or split by a
+            // task of the shared scheduler, the loaded volume stays available for the CPU.
+            this->m_volume_fit = TaskScheduler::shared().async(
+                [volume = std::shared_ptr<const PVMVolume> { this->m_volume_load.take() }, limits = this->m_device_limits,
+                    mode = this->m_volume_fit_mode]() { return fit_volume(volume, limits, mode); });
+            this->m_volume_load = VolumeLoadHandle {};
+            break;
+        case VolumeLoadStatus::Failed:
+            ImGui::TextColored(ImVec4 { 1.0f, 0.3f, 0.3f, 1.0f }, "Failed: %s", this->m_volume_load.error().c_str());
+            break;
+        case VolumeLoadStatus::Cancelled:
+            ImGui::Text("Cancelled");
+            break;
+        }
+
+        if (loading && ImGui::Button("Cancel")) {
+            this->m_volume_load.cancel();
+        }
+    }
+
+    if (this->m_volume_fit.valid()) {
+        if (this->m_volume_fit.wait_for(std::chrono::seconds { 0 }) == std::future_status::ready) {
+            try {
+                this->finish_volume_fit(this->m_volume_fit.get());
+            } catch (const std::exception& e) {
+                this->m_gpu_error = e.what();
+            }
+        } else {
+            ImGui::Text("Fitting the volume to the device...");
+        }
+    }
+
+    if (this->m_volume) {
+        ImGui::Text("%zu x %zu x %zu, %zu component(s)", this->m_volume->size_x(),
+            this->m_volume->size_y(), this->m_volume->size_z(), this->m_volume->components());
+        if (this->m_volume_resampled_extends) {
+            glm::vec<3, std::size_t> extends { *this->m_volume_resampled_extends };
+            ImGui::Text("resampled to %zu x %zu x %zu for the GPU", extends.x, extends.y, extends.z);
+        } else if (this->m_volume_bricks) {
+            ImGui::Text("split into %zu textures, %.1f MiB", this->m_volume_bricks->size(),
+                static_cast<double>(this->m_volume_bricks->byte_size()) / (1 << 20));
+        }
+    } else if (this->m_gpu_volume_info) {
+        const PVMInfo& info { *this->m_gpu_volume_info };
+        ImGui::Text("%zu x %zu x %zu, %zu component(s), normalized on GPU", info.extends.x,
+            info.extends.y, info.extends.z, info.components);
+    }
+
+    this->draw_render_settings();
+
+    ImGui::End();
+}
+
+void Application::draw_render_settings()
+{
+    if (!ImGui::CollapsingHeader("Rendering")) {
+        return;
+    }
+
+    VolumeRenderSettings& settings { this->m_render_settings };
+    ImGui::DragFloat3("Eye", &settings.eye.x, 0.01f);
+    ImGui::DragFloat3("Target", &settings.target.x, 0.01f);
+    ImGui::SliderFloat("Field of view", &settings.fov_y, 10.0f, 120.0f);
+    ImGui::DragFloatRange2("Transfer window", &settings.window_lower, &settings.window_upper, 0.005f, 0.0f, 1.0f);
+    ImGui::SliderFloat("Density", &settings.density, 0.1f, 128.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+    int steps { static_cast<int>(settings.steps) };
+    if (ImGui::SliderInt("Steps", &steps, 16, 2048)) {
+        settings.steps = static_cast<std::uint32_t>(steps);
+    }
+}
+
+void Application::finish_volume_fit(FittedVolume fitted)
+{
+    this->m_volume = std::move(fitted.original);
+    this->m_gpu_volume_info.reset();
+    this->m_series.reset();
+    this->m_volume_resampled_extends.reset();
+    this->m_volume_bricks.reset();
+
+    if (auto texture_volume = fitted.texture_volume()) {
+        if (fitted.resampled) {
+            this->m_volume_resampled_extends = fitted.resampled->extends();
+        }
+        this->m_volume_textures.stage(std::move(texture_volume));
+    } else if (VolumeTexture::supported(this->m_volume->components())) {
+        this->m_volume_bricks = std::make_unique<VolumeBrickTextures>(this->device(), *this->m_volume, fitted.regions);
+    }
+}
+
+void Application::draw_series_window()
+{
+    ImGui::Begin("Time series");
+
+    ImGui::InputText("Pattern", this->m_series_pattern.data(), this->m_series_pattern.size());
+    ImGui::SameLine();
+    if (ImGui::Button("Open")) {
+        try {
+            this->m_series = std::make_unique<VolumeSeries>(this->m_series_pattern.data(), *this->m_volume_loader, series_cache_budget);
+            this->m_series_error.clear();
+            this->m_series_frame = 0;
+            this->m_series_shown_frame = std::numeric_limits<std::size_t>::max();
+            this->m_series_time = 0.0f;
+        } catch (const std::exception& e) {
+            this->m_series.reset();
+            this->m_series_error = e.what();
+        }
+    }
+    if (!this->m_series_error.empty()) {
+        ImGui::TextColored(ImVec4 { 1.0f, 0.3f, 0.3f, 1.0f }, "%s", this->m_series_error.c_str());
+    }
+
+    if (this->m_series) {
+        VolumeSeries& series { *this->m_series };
+        if (ImGui::Button(this->m_series_playing ? "Pause" : "Play")) {
+            this->m_series_playing = !this->m_series_playing;
+            this->m_series_time = 0.0f;
+        }
+        ImGui::SameLine();
+        ImGui::SliderFloat("fps", &this->m_series_fps, 1.0f, 60.0f);
+
+        int frame { static_cast<int>(this->m_series_frame) };
+        if (ImGui::SliderInt("Frame", &frame, 0, static_cast<int>(series.frame_count()) - 1)) {
+            this->m_series_frame = static_cast<std::size_t>(frame);
+        }
+
+        int prefetch { static_cast<int>(series.prefetch_count()) };
+        if (ImGui::SliderInt("Prefetch", &prefetch, 0, 16)) {
+            series.set_prefetch_count(static_cast<std::size_t>(prefetch));
+        }
+
+        ImGui::Text("cache %.1f / %.1f MiB, %zu pending", static_cast<double>(series.resident_bytes()) / (1 << 20),
+            static_cast<double>(series.cache_budget()) / (1 << 20), series.pending_count());
+    }
+
+    ImGui::End();
+}
+
+void Application::update_series_playback()
+{
+    if (!this->m_series) {
+        return;
+    }
+
+    // Playback only advances to frames that are already resident. While the
+    // next frame is still loading the current one stays visible, so the
+    // render loop never waits for the disk.
+    VolumeSeries& series { *this->m_series };
+    if (this->m_series_playing) {
+        float frame_time { 1.0f / this->m_series_fps };
+        this->m_series_time = std::min(this->m_series_time + ImGui::GetIO().DeltaTime, frame_time);
+        if (this->m_series_time >= frame_time && this->m_series_shown_frame == this->m_series_frame) {
+            std::size_t next { (this->m_series_frame + 1) % series.frame_count() };
+            if (series.request(next)) {
+                this->m_series_time -= frame_time;
+                this->m_series_frame = next;
+            }
+        }
+    }
+
+    auto volume = series.request(this->m_series_frame);
+    if (volume && this->m_series_shown_frame != this->m_series_frame) {
+        this->m_volume_textures.stage(std::move(volume));
+        this->m_series_shown_frame = this->m_series_frame;
+    }
+}
+
+void Application::draw_memory_window()
+{
+    ImGui::Begin("Memory");
+
+    MemoryTracker& tracker { MemoryTracker::instance() };
+    constexpr double mib { 1 << 20 };
+    ImGui::Text("CPU %.1f MiB, GPU %.1f MiB (estimated)", static_cast<double>(tracker.total_bytes(false)) / mib,
+        static_cast<double>(tracker.total_bytes(true)) / mib);
+
+    if (ImGui::BeginTable("Memory tags", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Tag");
+        ImGui::TableSetupColumn("Current MiB");
+        ImGui::TableSetupColumn("Peak MiB");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableSetupColumn("Budget MiB");
+        ImGui::TableHeadersRow();
+        for (const MemoryTagStats& stats : tracker.snapshot()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s%s", memory_tag_name(stats.tag), is_gpu_memory_tag(stats.tag) ? " (GPU)" : "");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", static_cast<double>(stats.current_bytes) / mib);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", static_cast<double>(stats.peak_bytes) / mib);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", stats.allocations);
+            ImGui::TableNextColumn();
+            if (stats.budget_bytes != 0) {
+                ImGui::Text("%.1f", static_cast<double>(stats.budget_bytes) / mib);
+            } else {
+                ImGui::TextUnformatted("-");
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::SliderFloat("Volume budget (GiB)", &this->m_volume_memory_budget, 0.25f, 64.0f, "%.2f", ImGuiSliderFlags_Logarithmic)) {
+        this->register_memory_budget();
+    }
+
+    if (ImGui::Button("Reset peaks")) {
+        tracker.reset_peaks();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Dump CSV")) {
+        std::ofstream file { "memory.csv" };
+        tracker.write_csv(file);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Dump JSON")) {
+        std::ofstream file { "memory.json" };
+        tracker.write_json(file);
+    }
+
+    ImGui::End();
+}
+
+void Application::register_memory_budget()
+{
+    MemoryTracker& tracker { MemoryTracker::instance() };
+    if (this->m_volume_memory_budget_id) {
+        tracker.remove_budget(*this->m_volume_memory_budget_id);
     }
 
-    pass_encoder.setPipeline(this->m_render_pipeline);
-    pass_encoder.draw(3, 1, 0, 0);
-    pass_encoder.end();
-    pass_encoder.release();
+    // Cached frames of the time series are the only volumes that can be
+    // dropped, the shown volume is kept.
+    auto budget = static_cast<std::size_t>(static_cast<double>(this->m_volume_memory_budget) * (1 << 30));
+    this->m_volume_memory_budget_id = tracker.add_budget(MemoryTag::VolumeData, budget,
+        [this](MemoryTag, std::size_t current_bytes, std::size_t budget_bytes) {
+            if (this->m_series) {
+                this->m_series->evict(current_bytes - budget_bytes);
+            }
+        });
 }
\ No newline at end of file
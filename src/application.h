@@ -2,9 +2,28 @@
 
 #include <application_base.h>
 
+#include <array>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <benchmark.h>
+#include <gpu_normalizer.h>
+#include <memory_tracker.h>
+#include <pvm_volume.h>
+#include <task_scheduler.h>
+#include <volume_fit.h>
+#include <volume_loader.h>
+#include <volume_series.h>
+#include <volume_renderer.h>
+#include <volume_texture.h>
+
 class Application final : public ApplicationBase {
 public:
     Application();
+    Application(const ApplicationOptions& options);
     Application(const Application&) = delete;
     Application(Application&&);
     ~Application();
@@ -12,10 +31,27 @@ public:
     Application& operator=(const Application&) = delete;
     Application& operator=(Application&&) = delete;
 
+    /**
+     * Loads a volume and renders the frames of a benchmark script.
+     * Every frame waits for the GPU, so that its GPU time can be measured.
+     * Stops early if the window is closed.
+     * @param options volume and playback of the run
+     * @return times of the measured frames
+     */
+    BenchmarkRecord run_benchmark(const BenchmarkOptions& options);
+
 protected:
-    void on_frame(wgpu::CommandEncoder&, wgpu::TextureView&) override;
+    void on_frame(FrameGraph&, wgpu::TextureView&) override;
 
 private:
+    void draw_volume_window();
+    void draw_render_settings();
+    void finish_volume_fit(FittedVolume fitted);
+    void draw_series_window();
+    void update_series_playback();
+    void draw_memory_window();
+    void register_memory_budget();
+
     wgpu::ShaderModule m_shader_module;
     wgpu::PipelineLayout m_pipeline_layout;
     wgpu::RenderPipeline m_render_pipeline;
@@ -25,4 +61,36 @@ private:
     bool m_show_demo_window;
     bool m_show_another_window;
     ImVec4 m_clear_color;
+
+    std::unique_ptr<VolumeLoader> m_volume_loader;
+    VolumeLoadHandle m_volume_load;
+    std::shared_ptr<const PVMVolume> m_volume;
+    std::array<char, 512> m_volume_path;
+
+    VolumeDeviceLimits m_device_limits;
+    VolumeFitMode m_volume_fit_mode;
+    std::future<FittedVolume> m_volume_fit;
+    std::optional<glm::vec<3, std::size_t>> m_volume_resampled_extends;
+    std::unique_ptr<VolumeBrickTextures> m_volume_bricks;
+
+    std::unique_ptr<GPUVolumeNormalizer> m_gpu_normalizer;
+    std::future<GPURawVolume> m_gpu_upload;
+    std::optional<PVMInfo> m_gpu_volume_info;
+    std::string m_gpu_error;
+    bool m_gpu_normalization;
+
+    VolumeTextureDoubleBuffer m_volume_textures;
+    std::unique_ptr<VolumeRenderer> m_volume_renderer;
+    VolumeRenderSettings m_render_settings;
+    std::unique_ptr<VolumeSeries> m_series;
+    std::array<char, 512> m_series_pattern;
+    std::string m_series_error;
+    std::size_t m_series_frame;
+    std::size_t m_series_shown_frame;
+    bool m_series_playing;
+    float m_series_fps;
+    float m_series_time;
+
+    std::optional<std::size_t> m_volume_memory_budget_id;
+    float m_volume_memory_budget;
 };
\ No newline at end of file
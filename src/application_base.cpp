@@ -1,54 +1,67 @@
 #include "GLFW/glfw3.h"
 #include <application_base.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <span>
 #include <utility>
 #include <vector>
 
 #include <glfw3webgpu.h>
+#include <gpu_device.h>
+#include <webgpu/wgpu.h>
 
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_wgpu.h>
 
-ApplicationBase::ApplicationBase(const char* title)
+ApplicationBase::ApplicationBase(const char* title, const ApplicationOptions& options)
     : m_window { nullptr }
     , m_imgui_context { nullptr }
     , m_instance { nullptr }
     , m_surface { nullptr }
     , m_device { nullptr }
     , m_surface_format { wgpu::TextureFormat::Undefined }
-    , m_window_width { 1280 }
-    , m_window_height { 720 }
+    , m_present_mode { wgpu::PresentMode::Fifo }
+    , m_offscreen_texture { nullptr }
+    , m_offscreen_view { nullptr }
+    , m_frame_graph {}
+    , m_command_encoder_desc { wgpu::Default }
+    , m_command_buffer_desc { wgpu::Default }
+    , m_window_width { options.width }
+    , m_window_height { options.height }
     , m_window_width_scale { 1.0f }
     , m_window_height_scale { 1.0f }
 {
     // Init GLFW and window
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW!" << std::endl;
-        std::exit(EXIT_FAILURE);
-    }
-
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    this->m_window = glfwCreateWindow(this->m_window_width, this->m_window_height, title, nullptr, nullptr);
-    if (!this->m_window) {
-        std::cerr << "Could not create a window!" << std::endl;
-        std::exit(EXIT_FAILURE);
-    }
-    glfwGetWindowContentScale(this->m_window, &this->m_window_width_scale, &this->m_window_height_scale);
-
-    glfwSetWindowUserPointer(this->m_window, static_cast<void*>(this));
-    glfwSetFramebufferSizeCallback(this->m_window, [](GLFWwindow* window, int width, int height) {
-        if (width == 0 && height == 0) {
-            return;
+    if (!options.headless) {
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW!" << std::endl;
+            std::exit(EXIT_FAILURE);
         }
 
-        auto application = static_cast<ApplicationBase*>(glfwGetWindowUserPointer(window));
-        if (application) {
-            application->on_resize();
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        this->m_window = glfwCreateWindow(this->m_window_width, this->m_window_height, title, nullptr, nullptr);
+        if (!this->m_window) {
+            std::cerr << "Could not create a window!" << std::endl;
+            std::exit(EXIT_FAILURE);
         }
-    });
+        glfwGetWindowContentScale(this->m_window, &this->m_window_width_scale, &this->m_window_height_scale);
+
+        glfwSetWindowUserPointer(this->m_window, static_cast<void*>(this));
+        glfwSetFramebufferSizeCallback(this->m_window, [](GLFWwindow* window, int width, int height) {
+            if (width == 0 && height == 0) {
+                return;
+            }
+
+            auto application = static_cast<ApplicationBase*>(glfwGetWindowUserPointer(window));
+            if (application) {
+                application->on_resize();
+            }
+        });
+    }
 
     // Init WebGPU
     this->m_instance = wgpu::createInstance({ wgpu::Default });
@@ -57,85 +70,62 @@ ApplicationBase::ApplicationBase(const char* title)
         std::exit(EXIT_FAILURE);
     }
 
-    this->m_surface = wgpu::Surface { glfwGetWGPUSurface(this->m_instance, this->m_window) };
-    if (!this->m_surface) {
-        std::cerr << "Could not create WebGPU surface!" << std::endl;
-        std::exit(EXIT_FAILURE);
+    if (this->m_window) {
+        this->m_surface = wgpu::Surface { glfwGetWGPUSurface(this->m_instance, this->m_window) };
+        if (!this->m_surface) {
+            std::cerr << "Could not create WebGPU surface!" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
     }
 
-    wgpu::RequestAdapterOptions adapter_opts { wgpu::Default };
-    adapter_opts.compatibleSurface = this->m_surface;
-    auto adapter = this->m_instance.requestAdapter(adapter_opts);
+    auto adapter = request_adapter(this->m_instance, this->m_surface, options.software_adapter);
     if (!adapter) {
         std::cerr << "Could not create WebGPU adapter!" << std::endl;
         std::exit(EXIT_FAILURE);
     }
 
-    wgpu::SurfaceCapabilities surface_cap { wgpu::Default };
-    this->m_surface.getCapabilities(adapter, &surface_cap);
-    this->m_surface_format = surface_cap.formats[0];
+    if (this->m_surface) {
+        wgpu::SurfaceCapabilities surface_cap { wgpu::Default };
+        this->m_surface.getCapabilities(adapter, &surface_cap);
+        this->m_surface_format = surface_cap.formats[0];
+
+        // Without vsync the frames are presented as soon as they are done,
+        // preferably without waiting for the vertical blank at all.
+        if (!options.vsync) {
+            auto present_modes = std::span { surface_cap.presentModes, surface_cap.presentModeCount };
+            for (auto mode : { wgpu::PresentMode::Immediate, wgpu::PresentMode::Mailbox }) {
+                if (std::find(present_modes.begin(), present_modes.end(), mode) != present_modes.end()) {
+                    this->m_present_mode = mode;
+                    break;
+                }
+            }
+        }
+        surface_cap.freeMembers();
+    } else {
+        this->m_surface_format = wgpu::TextureFormat::RGBA8Unorm;
+    }
 
 #if SHOW_WEBGPU_INFO != 0
     this->inspect_adapter(adapter);
-    this->inspect_surface(adapter, this->m_surface);
+    if (this->m_surface) {
+        this->inspect_surface(adapter, this->m_surface);
+    }
 #endif
 
-    // Default limits from https://www.w3.org/TR/webgpu/#limits
-    wgpu::RequiredLimits device_limits { wgpu::Default };
-    device_limits.limits.maxTextureDimension1D = 8192;
-    device_limits.limits.maxTextureDimension2D = 8192;
-    device_limits.limits.maxTextureDimension3D = 2048;
-    device_limits.limits.maxTextureArrayLayers = 256;
-    device_limits.limits.maxBindGroups = 4;
-    device_limits.limits.maxBindGroupsPlusVertexBuffers = 24;
-    device_limits.limits.maxBindingsPerBindGroup = 1000;
-    device_limits.limits.maxDynamicUniformBuffersPerPipelineLayout = 8;
-    device_limits.limits.maxDynamicStorageBuffersPerPipelineLayout = 4;
-    device_limits.limits.maxSampledTexturesPerShaderStage = 16;
-    device_limits.limits.maxSamplersPerShaderStage = 16;
-    device_limits.limits.maxStorageBuffersPerShaderStage = 8;
-    device_limits.limits.maxStorageTexturesPerShaderStage = 4;
-    device_limits.limits.maxUniformBuffersPerShaderStage = 12;
-    device_limits.limits.maxUniformBufferBindingSize = 64 << 10;
-    device_limits.limits.maxStorageBufferBindingSize = 128 << 20;
-    device_limits.limits.minUniformBufferOffsetAlignment = 256;
-    device_limits.limits.minStorageBufferOffsetAlignment = 256;
-    device_limits.limits.maxVertexBuffers = 8;
-    device_limits.limits.maxBufferSize = 256 << 20;
-    device_limits.limits.maxVertexAttributes = 16;
-    device_limits.limits.maxVertexBufferArrayStride = 2048;
-    device_limits.limits.maxInterStageShaderComponents = 60;
-    device_limits.limits.maxInterStageShaderVariables = 16;
-    device_limits.limits.maxColorAttachments = 8;
-    device_limits.limits.maxColorAttachmentBytesPerSample = 32;
-    device_limits.limits.maxComputeWorkgroupStorageSize = 16 << 10;
-    device_limits.limits.maxComputeInvocationsPerWorkgroup = 256;
-    device_limits.limits.maxComputeWorkgroupSizeX = 256;
-    device_limits.limits.maxComputeWorkgroupSizeY = 256;
-    device_limits.limits.maxComputeWorkgroupSizeZ = 64;
-    device_limits.limits.maxComputeWorkgroupsPerDimension = 65535;
-
-    auto on_device_error = [](WGPUErrorType type, const char* message, void*) {
-        std::cerr << "Uncaptured device error: type " << type;
-        if (message) {
-            std::cerr << " (" << message << ")";
-        }
-        std::cerr << std::endl;
-    };
-
-    wgpu::DeviceDescriptor device_desc { wgpu::Default };
-    device_desc.label = "Application Device";
-    device_desc.requiredLimits = &device_limits;
-    device_desc.defaultQueue.label = "Default application queue";
-    device_desc.uncapturedErrorCallbackInfo.callback = on_device_error;
-    this->m_device = adapter.requestDevice(device_desc);
+    this->m_device = create_device(adapter, "Application Device", "Default application queue");
     adapter.release();
 
     if (!this->m_device) {
         std::cerr << "Could not create WebGPU device!" << std::endl;
         std::exit(EXIT_FAILURE);
     }
-    this->configure_surface();
+    if (this->m_surface) {
+        this->configure_surface();
+    } else {
+        this->create_offscreen_target();
+    }
+    this->m_command_encoder_desc.label = "Frame command encoder";
+    this->m_command_buffer_desc.label = "Frame command buffer";
 
     // Init Dear ImGUI
     IMGUI_CHECKVERSION();
@@ -145,7 +135,14 @@ ApplicationBase::ApplicationBase(const char* title)
         std::exit(EXIT_FAILURE);
     }
     ImGui::SetCurrentContext(this->m_imgui_context);
-    ImGui_ImplGlfw_InitForOther(this->m_window, true);
+    if (this->m_window) {
+        ImGui_ImplGlfw_InitForOther(this->m_window, true);
+    } else {
+        // Without a platform backend the display is described manually.
+        ImGuiIO& io { ImGui::GetIO() };
+        io.DisplaySize = ImVec2 { static_cast<float>(this->m_window_width), static_cast<float>(this->m_window_height) };
+        io.IniFilename = nullptr;
+    }
     ImGui_ImplWGPU_Init(this->m_device, 3, this->m_surface_format);
 }
 
@@ -156,6 +153,12 @@ ApplicationBase::ApplicationBase(ApplicationBase&& app)
     , m_surface { std::exchange(app.m_surface, nullptr) }
     , m_device { std::exchange(app.m_device, nullptr) }
     , m_surface_format { std::exchange(app.m_surface_format, wgpu::TextureFormat::Undefined) }
+    , m_present_mode { app.m_present_mode }
+    , m_offscreen_texture { std::exchange(app.m_offscreen_texture, nullptr) }
+    , m_offscreen_view { std::exchange(app.m_offscreen_view, nullptr) }
+    , m_frame_graph { std::move(app.m_frame_graph) }
+    , m_command_encoder_desc { app.m_command_encoder_desc }
+    , m_command_buffer_desc { app.m_command_buffer_desc }
     , m_window_width { std::exchange(app.m_window_width, 0) }
     , m_window_height { std::exchange(app.m_window_height, 0) }
     , m_window_width_scale { std::exchange(app.m_window_width_scale, 1.0f) }
@@ -171,10 +174,21 @@ ApplicationBase::~ApplicationBase()
     if (this->m_imgui_context) {
         ImGui::SetCurrentContext(this->m_imgui_context);
         ImGui_ImplWGPU_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
+        if (this->m_window) {
+            ImGui_ImplGlfw_Shutdown();
+        }
         ImGui::DestroyContext(this->m_imgui_context);
     }
 
+    if (this->m_offscreen_view) {
+        this->m_offscreen_view.release();
+    }
+
+    if (this->m_offscreen_texture) {
+        this->m_offscreen_texture.destroy();
+        this->m_offscreen_texture.release();
+    }
+
     if (this->m_device) {
         this->m_device.destroy();
         this->m_device.release();
@@ -210,17 +224,29 @@ void ApplicationBase::run()
         return;
     }
 
+    while (!glfwWindowShouldClose(this->m_window)) {
+        this->render_frame();
+    }
+}
+
+std::optional<FrameTiming> ApplicationBase::render_frame(std::optional<float> delta_time, bool wait_for_gpu)
+{
+    if (!this->m_imgui_context || !this->m_device) {
+        return std::nullopt;
+    }
+
     // Bind the Dear ImGui context.
     ImGui::SetCurrentContext(this->m_imgui_context);
 
-    auto queue = this->m_device.getQueue();
-    while (!glfwWindowShouldClose(this->m_window)) {
+    // Get a render target texture.
+    wgpu::Texture texture { nullptr };
+    wgpu::TextureView frame_view { this->m_offscreen_view };
+    if (this->m_window) {
         glfwPollEvents();
 
-        // Get a render target texture.
         wgpu::SurfaceTexture surface_texture { wgpu::Default };
         this->m_surface.getCurrentTexture(&surface_texture);
-        wgpu::Texture texture { surface_texture.texture };
+        texture = wgpu::Texture { surface_texture.texture };
         switch (surface_texture.status) {
         case WGPUSurfaceGetCurrentTextureStatus_Success:
             break;
@@ -231,7 +257,7 @@ void ApplicationBase::run()
                 texture.release();
             }
             this->configure_surface();
-            continue;
+            return std::nullopt;
         case WGPUSurfaceGetCurrentTextureStatus_OutOfMemory:
         case WGPUSurfaceGetCurrentTextureStatus_DeviceLost:
         case WGPUSurfaceGetCurrentTextureStatus_Force32:
@@ -239,59 +265,85 @@ void ApplicationBase::run()
             std::cerr << "Could not acquire the current surface texture" << std::endl;
             std::exit(EXIT_FAILURE);
         }
-        auto surface_texture_view = texture.createView();
+        frame_view = texture.createView();
+    }
+    auto frame_start = std::chrono::steady_clock::now();
 
-        // Init a Dear ImGui frame.
-        ImGui_ImplWGPU_NewFrame();
+    // Init a Dear ImGui frame.
+    ImGui_ImplWGPU_NewFrame();
+    ImGuiIO& io { ImGui::GetIO() };
+    if (this->m_window) {
         ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        // Init a command encoder for the frame.
-        wgpu::CommandEncoderDescriptor desc { wgpu::Default };
-        auto command_encoder = this->m_device.createCommandEncoder(desc);
-        if (!command_encoder) {
-            std::cerr << "Could create the frame command encoder" << std::endl;
-            std::exit(EXIT_FAILURE);
+        if (delta_time) {
+            io.DeltaTime = *delta_time;
         }
+    } else {
+        io.DeltaTime = delta_time.value_or(1.0f / 60.0f);
+    }
+    ImGui::NewFrame();
 
-        this->on_frame(command_encoder, surface_texture_view);
-
-        // Finish the Dear ImGui frame.
-        auto color_attachments = std::array { wgpu::RenderPassColorAttachment { wgpu::Default } };
-        color_attachments[0].view = surface_texture_view;
-        color_attachments[0].loadOp = wgpu::LoadOp::Load;
-        color_attachments[0].storeOp = wgpu::StoreOp::Store;
-        color_attachments[0].clearValue = wgpu::Color { 0.0, 1.0, 0.0, 1.0 };
-
-        wgpu::RenderPassDescriptor imgui_pass_desc { wgpu::Default };
-        imgui_pass_desc.colorAttachmentCount = color_attachments.size();
-        imgui_pass_desc.colorAttachments = color_attachments.data();
-        auto imgui_pass_encoder = command_encoder.beginRenderPass(imgui_pass_desc);
-        if (!imgui_pass_encoder) {
-            std::cerr << "Could not create Dear ImGui render pass!" << std::endl;
-            std::exit(EXIT_FAILURE);
+    // Init a command encoder for the frame.
+    auto command_encoder = this->m_device.createCommandEncoder(this->m_command_encoder_desc);
+    if (!command_encoder) {
+        std::cerr << "Could create the frame command encoder" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Collect the passes of the frame, with the Dear ImGui overlay last.
+    this->on_frame(this->m_frame_graph, frame_view);
+    ImGui::EndFrame();
+    ImGui::Render();
+    this->m_frame_graph.add_render_pass("Dear ImGui", frame_view, [](wgpu::RenderPassEncoder& pass_encoder) {
+        ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), pass_encoder);
+    });
+    try {
+        this->m_frame_graph.record(command_encoder);
+    } catch (...) {
+        command_encoder.release();
+        if (texture) {
+            frame_view.release();
+            texture.release();
         }
+        throw;
+    }
 
-        ImGui::EndFrame();
-        ImGui::Render();
-        ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), imgui_pass_encoder);
-        imgui_pass_encoder.end();
+    // Enqueue comands.
+    auto command_buffer = command_encoder.finish(this->m_command_buffer_desc);
+    command_encoder.release();
 
-        // Enqueue comands.
-        auto command_buffer = command_encoder.finish({ wgpu::Default });
-        imgui_pass_encoder.release();
-        command_encoder.release();
+    auto queue = this->m_device.getQueue();
+    queue.submit(command_buffer);
+    auto frame_submitted = std::chrono::steady_clock::now();
+
+    FrameTiming timing { std::chrono::duration<double, std::milli> { frame_submitted - frame_start }.count(), 0.0 };
+    if (wait_for_gpu) {
+        bool done { false };
+        auto callback = queue.onSubmittedWorkDone([&](wgpu::QueueWorkDoneStatus) { done = true; });
+        while (!done) {
+            wgpuDevicePoll(this->m_device, true, nullptr);
+        }
+        timing.gpu_ms = std::chrono::duration<double, std::milli> { std::chrono::steady_clock::now() - frame_submitted }.count();
+    }
 
-        queue.submit(command_buffer);
+    if (this->m_surface) {
         this->m_surface.present();
+    }
 
-        command_buffer.release();
-        surface_texture_view.release();
+    command_buffer.release();
+    queue.release();
+    if (texture) {
+        frame_view.release();
         texture.release();
     }
+    return timing;
 }
 
-void ApplicationBase::on_frame(wgpu::CommandEncoder&, wgpu::TextureView&) { }
+bool ApplicationBase::should_close() const
+{
+    return this->m_window && glfwWindowShouldClose(this->m_window);
+}
+
+void ApplicationBase::on_frame(FrameGraph&, wgpu::TextureView&) { }
 
 void ApplicationBase::on_resize()
 {
@@ -326,6 +378,37 @@ wgpu::TextureFormat ApplicationBase::surface_format() const
     return this->m_surface_format;
 }
 
+glm::uvec2 ApplicationBase::frame_size() const
+{
+    if (!this->m_window) {
+        return glm::uvec2 { this->m_window_width, this->m_window_height };
+    }
+    return glm::uvec2 {
+        static_cast<std::uint32_t>(this->m_window_width * this->m_window_width_scale),
+        static_cast<std::uint32_t>(this->m_window_height * this->m_window_height_scale),
+    };
+}
+
+void ApplicationBase::create_offscreen_target()
+{
+    wgpu::TextureDescriptor desc { wgpu::Default };
+    desc.label = "Offscreen frame";
+    desc.dimension = wgpu::TextureDimension::_2D;
+    desc.size.width = this->m_window_width;
+    desc.size.height = this->m_window_height;
+    desc.size.depthOrArrayLayers = 1;
+    desc.format = this->m_surface_format;
+    desc.usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::CopySrc;
+    desc.mipLevelCount = 1;
+    desc.sampleCount = 1;
+    this->m_offscreen_texture = this->m_device.createTexture(desc);
+    if (!this->m_offscreen_texture) {
+        std::cerr << "Could not create the offscreen frame!" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    this->m_offscreen_view = this->m_offscreen_texture.createView();
+}
+
 void ApplicationBase::configure_surface()
 {
     if (!this->m_device || !this->m_surface) {
@@ -337,7 +420,7 @@ void ApplicationBase::configure_surface()
     config.format = this->m_surface_format;
     config.width = static_cast<std::uint32_t>(this->m_window_width * this->m_window_width_scale);
     config.height = static_cast<std::uint32_t>(this->m_window_height * this->m_window_height_scale);
-    config.presentMode = wgpu::PresentMode::Fifo;
+    config.presentMode = this->m_present_mode;
     config.alphaMode = wgpu::CompositeAlphaMode::Opaque;
     config.device = this->m_device;
     this->m_surface.configure(config);
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
@@ -11,9 +12,38 @@
 #include <glm/glm.hpp>
 #pragma warning(pop)
 
+#include <frame_graph.h>
+
+/**
+ * Options of the window and device of an application.
+ *
+ * Headless applications have no window and draw into an offscreen texture of
+ * the given size, e.g. for benchmarks on machines without a display.
+ */
+struct ApplicationOptions {
+    bool headless { false };
+    bool software_adapter { false };
+    bool vsync { true };
+    std::uint32_t width { 1280 };
+    std::uint32_t height { 720 };
+};
+
+/**
+ * Times spent on a single frame in milliseconds.
+ *
+ * The CPU time covers the recording of the frame, from the start of the
+ * Dear ImGui frame until the submission. The GPU time runs from the
+ * submission until the queue finished the frame, and is only measured if
+ * the frame waited for the GPU.
+ */
+struct FrameTiming {
+    double cpu_ms;
+    double gpu_ms;
+};
+
 class ApplicationBase {
 public:
-    ApplicationBase(const char* title);
+    ApplicationBase(const char* title, const ApplicationOptions& options = {});
     ApplicationBase(const ApplicationBase&) = delete;
     ApplicationBase(ApplicationBase&&);
     virtual ~ApplicationBase();
@@ -23,8 +53,29 @@ public:
 
     void run();
 
+    /**
+     * Renders a single frame, and presents it if the application has a window.
+     * @param delta_time time step passed to Dear ImGui, or nothing to use the elapsed time
+     * @param wait_for_gpu block until the GPU finished the frame, and measure its GPU time
+     * @return timing of the frame, or nothing if no frame could be rendered
+     */
+    std::optional<FrameTiming> render_frame(std::optional<float> delta_time = std::nullopt, bool wait_for_gpu = false);
+
+    /**
+     * Checks if the window of the application was closed.
+     * @return window was closed, always false for headless applications
+     */
+    bool should_close() const;
+
 protected:
-    virtual void on_frame(wgpu::CommandEncoder&, wgpu::TextureView&);
+    /**
+     * Registers the passes of a frame.
+     * The Dear ImGui overlay is added after them, and shares the render pass
+     * of the last one drawing into the frame.
+     * @param frame_graph passes of the frame
+     * @param frame color target of the frame
+     */
+    virtual void on_frame(FrameGraph& frame_graph, wgpu::TextureView& frame);
     virtual void on_resize();
 
     wgpu::Device& device();
@@ -32,7 +83,14 @@ protected:
 
     wgpu::TextureFormat surface_format() const;
 
+    /**
+     * Returns the size of the frames in pixels.
+     * @return width and height of the color target
+     */
+    glm::uvec2 frame_size() const;
+
 private:
+    void create_offscreen_target();
     void configure_surface();
     void inspect_adapter(wgpu::Adapter&) const;
     void inspect_surface(wgpu::Adapter&, wgpu::Surface&) const;
@@ -43,6 +101,12 @@ private:
     wgpu::Surface m_surface;
     wgpu::Device m_device;
     wgpu::TextureFormat m_surface_format;
+    wgpu::PresentMode m_present_mode;
+    wgpu::Texture m_offscreen_texture;
+    wgpu::TextureView m_offscreen_view;
+    FrameGraph m_frame_graph;
+    wgpu::CommandEncoderDescriptor m_command_encoder_desc;
+    wgpu::CommandBufferDescriptor m_command_buffer_desc;
     uint32_t m_window_width;
     uint32_t m_window_height;
     float m_window_width_scale;
@@ -0,0 +1,307 @@
+#include <benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+struct SummaryField {
+    const char* name;
+    double TimingSummary::*value;
+};
+
+constexpr std::array<SummaryField, 4> summary_fields { {
+    { "mean", &TimingSummary::mean },
+    { "p95", &TimingSummary::p95 },
+    { "p99", &TimingSummary::p99 },
+    { "worst", &TimingSummary::worst },
+} };
+
+double percentile(std::span<const double> sorted, double fraction)
+{
+    auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+BenchmarkKeyframe interpolate(const BenchmarkKeyframe& a, const BenchmarkKeyframe& b, float t)
+{
+    auto mix = [t](float x, float y) { return x + (y - x) * t; };
+    return BenchmarkKeyframe {
+        mix(a.time, b.time),
+        mix(a.yaw, b.yaw),
+        mix(a.pitch, b.pitch),
+        mix(a.distance, b.distance),
+        a.target + (b.target - a.target) * t,
+        mix(a.window_lower, b.window_lower),
+        mix(a.window_upper, b.window_upper),
+    };
+}
+
+}
+
+BenchmarkScript::BenchmarkScript(std::vector<BenchmarkKeyframe> keyframes)
+    : m_keyframes { std::move(keyframes) }
+{
+    if (this->m_keyframes.empty()) {
+        throw std::invalid_argument("a benchmark script requires at least one keyframe");
+    }
+    for (std::size_t i { 1 }; i < this->m_keyframes.size(); ++i) {
+        if (!(this->m_keyframes[i].time > this->m_keyframes[i - 1].time)) {
+            throw std::invalid_argument("the keyframe times must be strictly increasing");
+        }
+    }
+}
+
+BenchmarkScript BenchmarkScript::load(const std::filesystem::path& path)
+{
+    std::ifstream file { path };
+    if (!file) {
+        throw std::runtime_error("could not open the benchmark script " + path.string());
+    }
+
+    std::vector<BenchmarkKeyframe> keyframes {};
+    std::string line {};
+    for (std::size_t line_number { 1 }; std::getline(file, line); ++line_number) {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        BenchmarkKeyframe keyframe {};
+        std::istringstream values { line };
+        values >> keyframe.time >> keyframe.yaw >> keyframe.pitch >> keyframe.distance >> keyframe.target.x
+            >> keyframe.target.y >> keyframe.target.z >> keyframe.window_lower >> keyframe.window_upper;
+        if (!values) {
+            throw std::runtime_error("invalid keyframe in line " + std::to_string(line_number) + " of " + path.string());
+        }
+        keyframes.push_back(keyframe);
+    }
+    return BenchmarkScript { std::move(keyframes) };
+}
+
+BenchmarkScript BenchmarkScript::orbit()
+{
+    glm::vec3 center { 0.0f, 0.0f, 0.0f };
+    return BenchmarkScript { {
+        { 0.0f, 0.0f, 20.0f, 2.0f, center, 0.1f, 0.9f },
+        { 2.0f, 90.0f, 45.0f, 1.6f, center, 0.2f, 0.8f },
+        { 4.0f, 180.0f, -10.0f, 1.2f, center, 0.3f, 0.6f },
+        { 6.0f, 270.0f, -45.0f, 1.0f, center, 0.05f, 0.5f },
+        { 8.0f, 360.0f, 20.0f, 2.0f, center, 0.1f, 0.9f },
+    } };
+}
+
+float BenchmarkScript::duration() const
+{
+    return this->m_keyframes.back().time - this->m_keyframes.front().time;
+}
+
+VolumeRenderSettings BenchmarkScript::settings(float time, const VolumeRenderSettings& base) const
+{
+    float duration { this->duration() };
+    float local_time { duration > 0.0f ? std::fmod(std::max(time, 0.0f), duration) : 0.0f };
+    local_time += this->m_keyframes.front().time;
+
+    auto next = std::upper_bound(this->m_keyframes.begin(), this->m_keyframes.end(), local_time,
+        [](float t, const BenchmarkKeyframe& keyframe) { return t < keyframe.time; });
+    BenchmarkKeyframe keyframe {};
+    if (next == this->m_keyframes.begin()) {
+        keyframe = this->m_keyframes.front();
+    } else if (next == this->m_keyframes.end()) {
+        keyframe = this->m_keyframes.back();
+    } else {
+        const BenchmarkKeyframe& previous { *std::prev(next) };
+        keyframe = interpolate(previous, *next, (local_time - previous.time) / (next->time - previous.time));
+    }
+
+    float yaw { glm::radians(keyframe.yaw) };
+    float pitch { glm::radians(keyframe.pitch) };
+    glm::vec3 direction { std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw) };
+
+    VolumeRenderSettings settings { base };
+    settings.eye = keyframe.target + keyframe.distance * direction;
+    settings.target = keyframe.target;
+    settings.window_lower = keyframe.window_lower;
+    settings.window_upper = keyframe.window_upper;
+    return settings;
+}
+
+const std::vector<BenchmarkKeyframe>& BenchmarkScript::keyframes() const
+{
+    return this->m_keyframes;
+}
+
+TimingSummary summarize_timings(std::span<const double> times)
+{
+    if (times.empty()) {
+        return TimingSummary { 0.0, 0.0, 0.0, 0.0 };
+    }
+
+    std::vector<double> sorted { times.begin(), times.end() };
+    std::sort(sorted.begin(), sorted.end());
+    return TimingSummary {
+        std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size()),
+        percentile(sorted, 0.95),
+        percentile(sorted, 0.99),
+        sorted.back(),
+    };
+}
+
+void BenchmarkSummary::write(std::ostream& stream) const
+{
+    auto precision = stream.precision(9);
+    stream << "frames " << this->frames << '\n';
+    for (auto [device, summary] : { std::pair { "cpu", &this->cpu }, std::pair { "gpu", &this->gpu } }) {
+        for (const SummaryField& field : summary_fields) {
+            stream << device << '_' << field.name << "_ms " << summary->*field.value << '\n';
+        }
+    }
+    stream.precision(precision);
+}
+
+BenchmarkSummary BenchmarkSummary::read(std::istream& stream)
+{
+    std::map<std::string, double> values {};
+    std::string line {};
+    while (std::getline(stream, line)) {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        std::string key {};
+        double value {};
+        std::istringstream entry { line };
+        if (!(entry >> key >> value)) {
+            throw std::runtime_error("invalid baseline entry: " + line);
+        }
+        values[key] = value;
+    }
+
+    auto get = [&](const std::string& key) {
+        auto it = values.find(key);
+        if (it == values.end()) {
+            throw std::runtime_error("missing baseline entry " + key);
+        }
+        return it->second;
+    };
+
+    BenchmarkSummary summary { static_cast<std::size_t>(get("frames")), {}, {} };
+    for (auto [device, timing] : { std::pair { "cpu", &summary.cpu }, std::pair { "gpu", &summary.gpu } }) {
+        for (const SummaryField& field : summary_fields) {
+            timing->*field.value = get(std::string { device } + '_' + field.name + "_ms");
+        }
+    }
+    return summary;
+}
+
+BenchmarkRecord::BenchmarkRecord()
+    : m_cpu_ms {}
+    , m_gpu_ms {}
+{
+}
+
+void BenchmarkRecord::add(double cpu_ms, double gpu_ms)
+{
+    this->m_cpu_ms.push_back(cpu_ms);
+    this->m_gpu_ms.push_back(gpu_ms);
+}
+
+std::size_t BenchmarkRecord::frame_count() const
+{
+    return this->m_cpu_ms.size();
+}
+
+BenchmarkSummary BenchmarkRecord::summary() const
+{
+    return BenchmarkSummary {
+        this->frame_count(),
+        summarize_timings(this->m_cpu_ms),
+        summarize_timings(this->m_gpu_ms),
+    };
+}
+
+void BenchmarkRecord::write_csv(std::ostream& stream) const
+{
+    stream << "frame,cpu_ms,gpu_ms\n";
+    for (std::size_t i { 0 }; i < this->frame_count(); ++i) {
+        stream << i << ',' << this->m_cpu_ms[i] << ',' << this->m_gpu_ms[i] << '\n';
+    }
+}
+
+std::vector<BenchmarkRegression> find_regressions(const BenchmarkSummary& current, const BenchmarkSummary& baseline,
+    double tolerance, double min_difference_ms)
+{
+    std::vector<BenchmarkRegression> regressions {};
+    for (auto [device, current_timing, baseline_timing] : { std::tuple { "cpu", &current.cpu, &baseline.cpu },
+             std::tuple { "gpu", &current.gpu, &baseline.gpu } }) {
+        for (const SummaryField& field : summary_fields) {
+            if (field.value == &TimingSummary::worst) {
+                continue;
+            }
+
+            double current_ms { current_timing->*field.value };
+            double baseline_ms { baseline_timing->*field.value };
+            if (current_ms > baseline_ms * (1.0 + tolerance) && current_ms - baseline_ms > min_difference_ms) {
+                regressions.push_back(BenchmarkRegression { std::string { device } + '_' + field.name, baseline_ms, current_ms });
+            }
+        }
+    }
+    return regressions;
+}
+
+void write_comparison(std::ostream& stream, const BenchmarkSummary& current, const BenchmarkSummary& baseline)
+{
+    auto flags = stream.flags();
+    auto precision = stream.precision();
+    stream << std::left << std::setw(12) << "metric" << std::right << std::setw(12) << "baseline" << std::setw(12)
+           << "current" << std::setw(10) << "change" << '\n';
+    for (auto [device, current_timing, baseline_timing] : { std::tuple { "cpu", &current.cpu, &baseline.cpu },
+             std::tuple { "gpu", &current.gpu, &baseline.gpu } }) {
+        for (const SummaryField& field : summary_fields) {
+            double current_ms { current_timing->*field.value };
+            double baseline_ms { baseline_timing->*field.value };
+            double change { baseline_ms > 0.0 ? 100.0 * (current_ms - baseline_ms) / baseline_ms : 0.0 };
+            stream << std::left << std::setw(12) << (std::string { device } + '_' + field.name) << std::right
+                   << std::fixed << std::setprecision(3) << std::setw(12) << baseline_ms << std::setw(12) << current_ms
+                   << std::showpos << std::setprecision(1) << std::setw(9) << change << '%' << std::noshowpos << '\n';
+        }
+    }
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+void write_kernel_timings(std::ostream& stream, std::span<const KernelTiming> timings)
+{
+    std::size_t name_width { 6 };
+    for (const KernelTiming& kernel : timings) {
+        name_width = std::max(name_width, kernel.name.size() + 2);
+    }
+
+    auto flags = stream.flags();
+    auto precision = stream.precision();
+    stream << std::left << std::setw(static_cast<int>(name_width)) << "kernel" << std::right;
+    for (const SummaryField& field : summary_fields) {
+        stream << std::setw(10) << (std::string { field.name } + " ms");
+    }
+    stream << '\n' << std::fixed << std::setprecision(3);
+    for (const KernelTiming& kernel : timings) {
+        stream << std::left << std::setw(static_cast<int>(name_width)) << kernel.name << std::right;
+        for (const SummaryField& field : summary_fields) {
+            stream << std::setw(10) << kernel.timing.*field.value;
+        }
+        stream << '\n';
+    }
+    stream.flags(flags);
+    stream.precision(precision);
+}
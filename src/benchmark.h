@@ -0,0 +1,262 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <volume_renderer.h>
+
+/**
+ * Camera and transfer window of a benchmark at a point in time.
+ *
+ * The camera orbits around its target, with the yaw measured around the y
+ * axis from the z axis and the pitch measured from the xz plane, both in
+ * degrees. Distances and the target use the units of `VolumeRenderSettings`.
+ */
+struct BenchmarkKeyframe {
+    float time;
+    float yaw;
+    float pitch;
+    float distance;
+    glm::vec3 target;
+    float window_lower;
+    float window_upper;
+};
+
+/**
+ * Camera and transfer function path played back by a benchmark.
+ *
+ * The keyframes are interpolated linearly, so a yaw running from 0 to 360
+ * degrees describes a full orbit. Scripts are text files with one keyframe
+ * per line, listing `time yaw pitch distance target_x target_y target_z
+ * window_lower window_upper`. Empty lines and lines starting with '#' are
+ * ignored.
+ */
+class BenchmarkScript {
+public:
+    /**
+     * Creates a script from keyframes.
+     * @param keyframes keyframes with strictly increasing times
+     */
+    BenchmarkScript(std::vector<BenchmarkKeyframe> keyframes);
+    BenchmarkScript(const BenchmarkScript&) = default;
+    BenchmarkScript(BenchmarkScript&&) noexcept = default;
+    ~BenchmarkScript() = default;
+
+    BenchmarkScript& operator=(const BenchmarkScript&) = default;
+    BenchmarkScript& operator=(BenchmarkScript&&) noexcept = default;
+
+    /**
+     * Reads a script from a file.
+     * @param path path of the script
+     * @return read script
+     */
+    static BenchmarkScript load(const std::filesystem::path& path);
+
+    /**
+     * Creates the default script, a full orbit with changing distance, pitch and transfer window.
+     * @return default script
+     */
+    static BenchmarkScript orbit();
+
+    /**
+     * Returns the time between the first and the last keyframe.
+     * @return duration of the script
+     */
+    float duration() const;
+
+    /**
+     * Interpolates the camera and transfer window at a point in time.
+     * Times past the last keyframe start the script over.
+     * @param time time since the start of the script
+     * @param base settings providing the fields not controlled by the script
+     * @return render settings at the time
+     */
+    VolumeRenderSettings settings(float time, const VolumeRenderSettings& base) const;
+
+    const std::vector<BenchmarkKeyframe>& keyframes() const;
+
+private:
+    std::vector<BenchmarkKeyframe> m_keyframes;
+};
+
+/**
+ * Statistics of frame times in milliseconds.
+ */
+struct TimingSummary {
+    double mean;
+    double p95;
+    double p99;
+    double worst;
+};
+
+/**
+ * Computes the statistics of frame times.
+ * The percentiles use the nearest rank.
+ * @param times frame times in milliseconds
+ * @return statistics, all zero if there are no times
+ */
+TimingSummary summarize_timings(std::span<const double> times);
+
+/**
+ * Statistics of a benchmark run, stored as baseline for later runs.
+ *
+ * Baselines are text files with one `key value` pair per line, e.g.
+ * `cpu_p95_ms 1.25`. Lines starting with '#' are ignored.
+ */
+struct BenchmarkSummary {
+    std::size_t frames;
+    TimingSummary cpu;
+    TimingSummary gpu;
+
+    /**
+     * Writes the summary in the baseline format.
+     * @param stream output stream
+     */
+    void write(std::ostream& stream) const;
+
+    /**
+     * Reads a summary written by `write`.
+     * @param stream input stream
+     * @return read summary
+     */
+    static BenchmarkSummary read(std::istream& stream);
+};
+
+/**
+ * Measured times of the frames of a benchmark run.
+ */
+class BenchmarkRecord {
+public:
+    BenchmarkRecord();
+    BenchmarkRecord(const BenchmarkRecord&) = default;
+    BenchmarkRecord(BenchmarkRecord&&) noexcept = default;
+    ~BenchmarkRecord() = default;
+
+    BenchmarkRecord& operator=(const BenchmarkRecord&) = default;
+    BenchmarkRecord& operator=(BenchmarkRecord&&) noexcept = default;
+
+    /**
+     * Appends the times of a frame.
+     * @param cpu_ms CPU time of the frame
+     * @param gpu_ms GPU time of the frame
+     */
+    void add(double cpu_ms, double gpu_ms);
+
+    /**
+     * Returns the number of recorded frames.
+     * @return frame count
+     */
+    std::size_t frame_count() const;
+
+    /**
+     * Computes the statistics of the recorded frames.
+     * @return summary of the run
+     */
+    BenchmarkSummary summary() const;
+
+    /**
+     * Writes the times of all frames as CSV.
+     * @param stream output stream
+     */
+    void write_csv(std::ostream& stream) const;
+
+private:
+    std::vector<double> m_cpu_ms;
+    std::vector<double> m_gpu_ms;
+};
+
+/**
+ * Statistic of a run exceeding its baseline.
+ */
+struct BenchmarkRegression {
+    std::string metric;
+    double baseline_ms;
+    double current_ms;
+};
+
+/**
+ * Compares the mean and percentile times of a run with a baseline.
+ *
+ * A time regressed if it exceeds the baseline by more than the relative
+ * tolerance and by more than the absolute difference, so that noise of very
+ * short frames is not reported. The worst frame times are too noisy and
+ * are only reported, not compared.
+ * @param current summary of the run
+ * @param baseline summary of the baseline
+ * @param tolerance allowed relative increase, e.g. 0.1 for 10%
+ * @param min_difference_ms smallest increase reported
+ * @return regressed statistics
+ */
+std::vector<BenchmarkRegression> find_regressions(const BenchmarkSummary& current, const BenchmarkSummary& baseline,
+    double tolerance = 0.1, double min_difference_ms = 0.05);
+
+/**
+ * Writes the statistics of a run side by side with a baseline.
+ * @param stream output stream
+ * @param current summary of the run
+ * @param baseline summary of the baseline
+ */
+void write_comparison(std::ostream& stream, const BenchmarkSummary& current, const BenchmarkSummary& baseline);
+
+/**
+ * Measured run times of a CPU kernel.
+ */
+struct KernelTiming {
+    std::string name;
+    TimingSummary timing;
+};
+
+/**
+ * Measures the run times of a CPU kernel.
+ * The kernel runs once before the measurement, so that caches and lazily
+ * allocated memory are warm.
+ * @param name name of the kernel
+ * @param repetitions number of measured runs
+ * @param kernel measured function
+ * @return statistics of the run times
+ */
+template <typename Kernel>
+KernelTiming time_kernel(std::string_view name, std::size_t repetitions, Kernel&& kernel)
+{
+    kernel();
+    std::vector<double> times {};
+    times.reserve(repetitions);
+    for (std::size_t i { 0 }; i < repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        times.push_back(std::chrono::duration<double, std::milli> { std::chrono::steady_clock::now() - start }.count());
+    }
+    return KernelTiming { std::string { name }, summarize_timings(times) };
+}
+
+/**
+ * Writes the run times of kernels as a table.
+ * @param stream output stream
+ * @param timings measured kernels
+ */
+void write_kernel_timings(std::ostream& stream, std::span<const KernelTiming> timings);
+
+/**
+ * Volume and playback of a benchmark run.
+ *
+ * The frames advance by a fixed time step, independent of how long they
+ * take to render. The first frames upload the volume and build the pipelines,
+ * so they are rendered before the measurement starts.
+ */
+struct BenchmarkOptions {
+    std::filesystem::path volume;
+    BenchmarkScript script { BenchmarkScript::orbit() };
+    std::size_t frames { 600 };
+    std::size_t warmup_frames { 10 };
+    float timestep { 1.0f / 60.0f };
+};
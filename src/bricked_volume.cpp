@@ -0,0 +1,458 @@
+#include <bricked_volume.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+
+#include <dds_codec.h>
+#include <memory_tracker.h>
+
+namespace {
+
+constexpr std::array<char, 8> brick_magic { 'B', 'R', 'I', 'C', 'K', 'V', 'O', 'L' };
+constexpr std::uint32_t brick_format_version { 1 };
+
+template <typename T>
+void write_value(std::ostream& stream, T value)
+{
+    std::array<unsigned char, sizeof(T)> bytes {};
+    std::memcpy(bytes.data(), &value, sizeof(T));
+    if constexpr (std::endian::native == std::endian::big) {
+        std::reverse(bytes.begin(), bytes.end());
+    }
+    stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+template <typename T>
+T read_value(std::istream& stream)
+{
+    std::array<unsigned char, sizeof(T)> bytes {};
+    if (!stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+        throw std::runtime_error("unexpected end of bricked volume");
+    }
+    if constexpr (std::endian::native == std::endian::big) {
+        std::reverse(bytes.begin(), bytes.end());
+    }
+    T value;
+    std::memcpy(&value, bytes.data(), sizeof(T));
+    return value;
+}
+
+std::size_t brick_count(std::size_t size, std::size_t brick_size)
+{
+    return (size + brick_size - 1) / brick_size;
+}
+
+void validate_brick_layout(glm::vec<3, std::size_t> extends, std::size_t components, std::size_t brick_size)
+{
+    if (extends.x == 0 || extends.y == 0 || extends.z == 0 || components == 0) {
+        throw std::invalid_argument("empty volume");
+    }
+    if (brick_size == 0 || brick_size > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::invalid_argument("invalid brick size");
+    }
+}
+
+/**
+ * Writes the header of a bricked volume.
+ * @return offset of the component ranges, which are rewritten once known
+ */
+std::streamoff write_brick_header(std::ostream& file, glm::vec<3, std::size_t> extends, std::size_t components,
+    glm::vec3 scale, std::size_t brick_size, const std::vector<glm::vec2>& ranges)
+{
+    file.write(brick_magic.data(), brick_magic.size());
+    write_value<std::uint32_t>(file, brick_format_version);
+    write_value<std::uint64_t>(file, extends.x);
+    write_value<std::uint64_t>(file, extends.y);
+    write_value<std::uint64_t>(file, extends.z);
+    write_value<std::uint32_t>(file, static_cast<std::uint32_t>(components));
+    write_value<std::uint32_t>(file, static_cast<std::uint32_t>(brick_size));
+    write_value<float>(file, scale.x);
+    write_value<float>(file, scale.y);
+    write_value<float>(file, scale.z);
+
+    std::streamoff ranges_offset { file.tellp() };
+    for (const auto& range : ranges) {
+        write_value<float>(file, range.x);
+        write_value<float>(file, range.y);
+    }
+    return ranges_offset;
+}
+
+std::vector<glm::vec2> empty_ranges(std::size_t components)
+{
+    return std::vector<glm::vec2>(components, glm::vec2 { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() });
+}
+
+/**
+ * Extends the minimum/maximum of all components, in the same order as PVMVolume.
+ */
+void accumulate_ranges(std::span<const unsigned char> data, std::vector<glm::vec2>& ranges)
+{
+    std::size_t components { ranges.size() };
+    for (std::size_t i { 0 }; i < data.size(); ++i) {
+        float value { static_cast<float>(data[i]) };
+        glm::vec2& range { ranges[components - (i % components) - 1] };
+        range.x = std::min(range.x, value);
+        range.y = std::max(range.y, value);
+    }
+}
+
+/**
+ * Writes the row of bricks covering a slab of up to `brick_size` z-slices.
+ * @param slab voxels of the slab, x-fastest
+ * @param depth number of slices of the slab
+ * @param brick scratch buffer of a whole brick
+ */
+void write_brick_row(std::ostream& file, const unsigned char* slab, std::size_t depth,
+    glm::vec<3, std::size_t> extends, std::size_t components, std::size_t brick_size, std::vector<unsigned char>& brick)
+{
+    std::size_t row_bytes { brick_size * components };
+    for (std::size_t by { 0 }; by < brick_count(extends.y, brick_size); ++by) {
+        for (std::size_t bx { 0 }; bx < brick_count(extends.x, brick_size); ++bx) {
+            std::fill(brick.begin(), brick.end(), static_cast<unsigned char>(0));
+
+            std::size_t x0 { bx * brick_size };
+            std::size_t row_voxels { std::min(brick_size, extends.x - x0) };
+            for (std::size_t z { 0 }; z < depth; ++z) {
+                for (std::size_t y { 0 }; y < brick_size && by * brick_size + y < extends.y; ++y) {
+                    std::size_t voxel_index { x0 + (by * brick_size + y) * extends.x + z * extends.x * extends.y };
+                    std::copy_n(slab + voxel_index * components, row_voxels * components,
+                        brick.data() + (y + z * brick_size) * row_bytes);
+                }
+            }
+
+            file.write(reinterpret_cast<const char*>(brick.data()), static_cast<std::streamsize>(brick.size()));
+        }
+    }
+}
+
+}
+
+BrickedVolume::BrickedVolume(const std::filesystem::path& brick_path, std::size_t residency_budget)
+    : m_mutex {}
+    , m_file { brick_path, std::ios::binary }
+    , m_bricks { residency_budget }
+    , m_brick_reads { 0 }
+    , m_component_ranges {}
+    , m_name { brick_path.string() }
+    , m_data_offset { 0 }
+    , m_size_x { 0 }
+    , m_size_y { 0 }
+    , m_size_z { 0 }
+    , m_components { 0 }
+    , m_brick_size { 0 }
+    , m_bricks_x { 0 }
+    , m_bricks_y { 0 }
+    , m_bricks_z { 0 }
+    , m_scale_x { 0.0f }
+    , m_scale_y { 0.0f }
+    , m_scale_z { 0.0f }
+{
+    if (!this->m_file) {
+        throw std::runtime_error("could not open bricked volume");
+    }
+
+    std::array<char, brick_magic.size()> magic {};
+    this->m_file.read(magic.data(), magic.size());
+    if (!this->m_file || magic != brick_magic) {
+        throw std::runtime_error("not a bricked volume");
+    }
+    if (read_value<std::uint32_t>(this->m_file) != brick_format_version) {
+        throw std::runtime_error("unsupported bricked volume version");
+    }
+
+    this->m_size_x = static_cast<std::size_t>(read_value<std::uint64_t>(this->m_file));
+    this->m_size_y = static_cast<std::size_t>(read_value<std::uint64_t>(this->m_file));
+    this->m_size_z = static_cast<std::size_t>(read_value<std::uint64_t>(this->m_file));
+    this->m_components = static_cast<std::size_t>(read_value<std::uint32_t>(this->m_file));
+    this->m_brick_size = static_cast<std::size_t>(read_value<std::uint32_t>(this->m_file));
+    this->m_scale_x = read_value<float>(this->m_file);
+    this->m_scale_y = read_value<float>(this->m_file);
+    this->m_scale_z = read_value<float>(this->m_file);
+    if (this->m_size_x == 0 || this->m_size_y == 0 || this->m_size_z == 0 || this->m_components == 0 || this->m_brick_size == 0) {
+        throw std::runtime_error("invalid bricked volume header");
+    }
+
+    this->m_component_ranges.resize(this->m_components);
+    for (auto& range : this->m_component_ranges) {
+        range.x = read_value<float>(this->m_file);
+        range.y = read_value<float>(this->m_file);
+    }
+
+    this->m_data_offset = static_cast<std::uint64_t>(this->m_file.tellg());
+    this->m_bricks_x = brick_count(this->m_size_x, this->m_brick_size);
+    this->m_bricks_y = brick_count(this->m_size_y, this->m_brick_size);
+    this->m_bricks_z = brick_count(this->m_size_z, this->m_brick_size);
+}
+
+void BrickedVolume::convert(const std::filesystem::path& pvm_path, const std::filesystem::path& brick_path,
+    std::size_t brick_size)
+{
+    // Only a slab of `brick_size` slices is kept in memory, so volumes larger
+    // than the system memory can be converted. The component ranges are only
+    // known at the end and are written into the header afterwards.
+    std::ofstream file {};
+    std::streamoff ranges_offset { 0 };
+    std::vector<glm::vec2> ranges {};
+    std::vector<unsigned char> slab {};
+    std::vector<unsigned char> brick {};
+    TrackedAllocation memory { MemoryTag::VolumeDecoding };
+    PVMInfo volume {};
+    std::size_t slice_size { 0 };
+
+    auto info_sink = [&](const PVMInfo& info) {
+        validate_brick_layout(info.extends, info.components, brick_size);
+        volume = info;
+        slice_size = pvm_volume_bytes(PVMInfo { glm::vec<3, std::size_t> { info.extends.x, info.extends.y, 1 }, info.components, info.scale });
+        std::size_t slab_bytes { pvm_volume_bytes(PVMInfo { glm::vec<3, std::size_t> { info.extends.x, info.extends.y, std::min(brick_size, info.extends.z) }, info.components, info.scale }) };
+        std::size_t brick_bytes { pvm_volume_bytes(PVMInfo { glm::vec<3, std::size_t> { brick_size }, info.components, info.scale }) };
+        slab.resize(slab_bytes);
+        brick.resize(brick_bytes);
+        memory.resize(slab_bytes + brick_bytes);
+
+        file.open(brick_path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("could not create bricked volume");
+        }
+        ranges = empty_ranges(info.components);
+        ranges_offset = write_brick_header(file, info.extends, info.components, info.scale, brick_size, ranges);
+        return true;
+    };
+
+    auto slice_sink = [&](std::size_t z, std::span<const unsigned char> slice) {
+        accumulate_ranges(slice, ranges);
+        std::size_t slab_z { z % brick_size };
+        std::copy(slice.begin(), slice.end(), slab.begin() + static_cast<std::ptrdiff_t>(slab_z * slice_size));
+        if (slab_z + 1 == brick_size || z + 1 == volume.extends.z) {
+            write_brick_row(file, slab.data(), slab_z + 1, volume.extends, volume.components, brick_size, brick);
+        }
+        return static_cast<bool>(file);
+    };
+
+    if (!read_pvm_slices(pvm_path, info_sink, slice_sink)) {
+        throw std::runtime_error("could not write bricked volume");
+    }
+
+    file.seekp(ranges_offset);
+    for (const auto& range : ranges) {
+        write_value<float>(file, range.x);
+        write_value<float>(file, range.y);
+    }
+    if (!file) {
+        throw std::runtime_error("could not write bricked volume");
+    }
+}
+
+void BrickedVolume::write(const std::filesystem::path& brick_path, const unsigned char* data,
+    glm::vec<3, std::size_t> extends, std::size_t components, glm::vec3 scale, std::size_t brick_size)
+{
+    validate_brick_layout(extends, components, brick_size);
+
+    std::ofstream file { brick_path, std::ios::binary | std::ios::trunc };
+    if (!file) {
+        throw std::runtime_error("could not create bricked volume");
+    }
+
+    std::vector<glm::vec2> ranges { empty_ranges(components) };
+    accumulate_ranges(std::span { data, extends.x * extends.y * extends.z * components }, ranges);
+    write_brick_header(file, extends, components, scale, brick_size, ranges);
+
+    // Consecutive slices are contiguous, so each row of bricks is written from its slab in place.
+    std::size_t slice_size { extends.x * extends.y * components };
+    std::vector<unsigned char> brick(brick_size * brick_size * brick_size * components);
+    for (std::size_t bz { 0 }; bz < brick_count(extends.z, brick_size); ++bz) {
+        std::size_t z0 { bz * brick_size };
+        write_brick_row(file, data + z0 * slice_size, std::min(brick_size, extends.z - z0), extends, components, brick_size, brick);
+    }
+
+    if (!file) {
+        throw std::runtime_error("could not write bricked volume");
+    }
+}
+
+bool BrickedVolume::is_scalar_field() const
+{
+    return this->m_components == 1;
+}
+
+bool BrickedVolume::is_vector_field() const
+{
+    return this->m_components > 1;
+}
+
+std::size_t BrickedVolume::components() const
+{
+    return this->m_components;
+}
+
+std::size_t BrickedVolume::size_x() const
+{
+    return this->m_size_x;
+}
+
+std::size_t BrickedVolume::size_y() const
+{
+    return this->m_size_y;
+}
+
+std::size_t BrickedVolume::size_z() const
+{
+    return this->m_size_z;
+}
+
+glm::vec<3, std::size_t> BrickedVolume::extends() const
+{
+    return glm::vec<3, std::size_t> {
+        this->m_size_x,
+        this->m_size_y,
+        this->m_size_z
+    };
+}
+
+float BrickedVolume::scale_x() const
+{
+    return this->m_scale_x;
+}
+
+float BrickedVolume::scale_y() const
+{
+    return this->m_scale_y;
+}
+
+float BrickedVolume::scale_z() const
+{
+    return this->m_scale_z;
+}
+
+glm::vec3 BrickedVolume::scale() const
+{
+    return glm::vec3 { this->m_scale_x, this->m_scale_y, this->m_scale_z };
+}
+
+glm::vec3 BrickedVolume::voxel_position_start(std::size_t x, std::size_t y, std::size_t z) const
+{
+    glm::vec3 idx_f { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) };
+    return idx_f * this->scale();
+}
+
+glm::vec3 BrickedVolume::voxel_position_end(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel_position_start(x, y, z) + this->scale();
+}
+
+glm::vec3 BrickedVolume::voxel_position_center(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel_position_start(x, y, z) + (this->scale() * 0.5f);
+}
+
+float BrickedVolume::voxel(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel(x, y, z, 0);
+}
+
+float BrickedVolume::voxel(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const
+{
+    float value { this->voxel_normalized(x, y, z, component) };
+    glm::vec2 range { this->m_component_ranges[component] };
+    float start { range.x };
+    float end { range.y };
+
+    return (start * (1.0f - value)) + (end * value);
+}
+
+float BrickedVolume::voxel_normalized(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel_normalized(x, y, z, 0);
+}
+
+float BrickedVolume::voxel_normalized(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const
+{
+    if (x >= this->m_size_x) {
+        throw std::out_of_range("x coordinate out of range");
+    }
+    if (y >= this->m_size_y) {
+        throw std::out_of_range("y coordinate out of range");
+    }
+    if (z >= this->m_size_z) {
+        throw std::out_of_range("z coordinate out of range");
+    }
+    if (component >= this->m_components) {
+        throw std::out_of_range("component index out of range");
+    }
+
+    std::size_t brick_index { (x / this->m_brick_size) + (y / this->m_brick_size) * this->m_bricks_x
+        + (z / this->m_brick_size) * this->m_bricks_x * this->m_bricks_y };
+    Brick brick { this->brick(brick_index) };
+
+    std::size_t bx { x % this->m_brick_size };
+    std::size_t by { y % this->m_brick_size };
+    std::size_t bz { z % this->m_brick_size };
+    std::size_t voxel_index { (bx + by * this->m_brick_size + bz * this->m_brick_size * this->m_brick_size) * this->m_components };
+    float value { static_cast<float>((*brick)[voxel_index + (this->m_components - 1 - component)]) };
+
+    glm::vec2 range { this->m_component_ranges[component] };
+    float min = range.x;
+    float max = range.y;
+    return (value - min) / (max - min);
+}
+
+std::size_t BrickedVolume::brick_size() const
+{
+    return this->m_brick_size;
+}
+
+std::size_t BrickedVolume::brick_bytes() const
+{
+    return this->m_brick_size * this->m_brick_size * this->m_brick_size * this->m_components;
+}
+
+std::size_t BrickedVolume::resident_bytes() const
+{
+    std::scoped_lock lock { this->m_mutex };
+    return this->m_bricks.size();
+}
+
+std::size_t BrickedVolume::residency_budget() const
+{
+    std::scoped_lock lock { this->m_mutex };
+    return this->m_bricks.budget();
+}
+
+void BrickedVolume::set_residency_budget(std::size_t budget)
+{
+    std::scoped_lock lock { this->m_mutex };
+    this->m_bricks.set_budget(budget);
+}
+
+std::size_t BrickedVolume::brick_reads() const
+{
+    std::scoped_lock lock { this->m_mutex };
+    return this->m_brick_reads;
+}
+
+BrickedVolume::Brick BrickedVolume::brick(std::size_t brick_index) const
+{
+    std::scoped_lock lock { this->m_mutex };
+    if (auto brick = this->m_bricks.find(brick_index)) {
+        return *brick;
+    }
+
+    std::size_t brick_bytes { this->brick_bytes() };
+    auto data = make_tracked_shared(MemoryTag::BrickCache, brick_bytes, std::vector<unsigned char>(brick_bytes));
+    std::uint64_t offset { this->m_data_offset + static_cast<std::uint64_t>(brick_index) * brick_bytes };
+    this->m_file.seekg(static_cast<std::streamoff>(offset));
+    if (!this->m_file.read(reinterpret_cast<char*>(data->data()), static_cast<std::streamsize>(brick_bytes))) {
+        this->m_file.clear();
+        throw std::runtime_error("could not read brick");
+    }
+    this->m_brick_reads++;
+
+    Brick brick { std::move(data) };
+    this->m_bricks.insert(brick_index, brick, brick_bytes);
+    return brick;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <lru_cache.h>
+
+/**
+ * Out-of-core volume stored as bricks in a file.
+ *
+ * The volume is split into cubic bricks that are read on demand and kept in
+ * a LRU cache bounded by a residency budget, so that volumes larger than the
+ * system memory can be accessed. The accessors mirror the ones of `PVMVolume`
+ * and return the same values for a converted volume.
+ *
+ * File layout (little-endian):
+ *  - magic "BRICKVOL", format version (u32)
+ *  - size x/y/z (u64), components (u32), brick size (u32)
+ *  - voxel scale x/y/z (f32), minimum/maximum of each component (f32)
+ *  - bricks in x-fastest order, each holding brick size^3 voxels with the
+ *    raw component bytes in PVM order; bricks on the border are padded
+ */
+class BrickedVolume {
+public:
+    /**
+     * Opens a bricked volume file.
+     * @param brick_path path to the bricked volume
+     * @param residency_budget maximum number of bytes of resident bricks
+     */
+    BrickedVolume(const std::filesystem::path& brick_path, std::size_t residency_budget);
+    BrickedVolume(const BrickedVolume&) = delete;
+    BrickedVolume(BrickedVolume&&) = delete;
+    ~BrickedVolume() = default;
+
+    BrickedVolume& operator=(const BrickedVolume&) = delete;
+    BrickedVolume& operator=(BrickedVolume&&) = delete;
+
+    /**
+     * Converts a PVM volume into a bricked volume file.
+     * The volume is decoded slice by slice and only a row of bricks is kept
+     * in memory, so the volume may be larger than the system memory.
+     * @param pvm_path path to the PVM volume
+     * @param brick_path path of the written bricked volume
+     * @param brick_size number of voxels along each edge of a brick
+     */
+    static void convert(const std::filesystem::path& pvm_path, const std::filesystem::path& brick_path,
+        std::size_t brick_size = 64);
+
+    /**
+     * Writes raw voxel data as a bricked volume file.
+     * @param brick_path path of the written bricked volume
+     * @param data voxel data with the component bytes of each voxel in PVM order
+     * @param extends number of voxels in each direction
+     * @param components number of components of each voxel
+     * @param scale size of a voxel
+     * @param brick_size number of voxels along each edge of a brick
+     */
+    static void write(const std::filesystem::path& brick_path, const unsigned char* data,
+        glm::vec<3, std::size_t> extends, std::size_t components, glm::vec3 scale, std::size_t brick_size = 64);
+
+    bool is_scalar_field() const;
+    bool is_vector_field() const;
+    std::size_t components() const;
+    std::size_t size_x() const;
+    std::size_t size_y() const;
+    std::size_t size_z() const;
+    glm::vec<3, std::size_t> extends() const;
+    float scale_x() const;
+    float scale_y() const;
+    float scale_z() const;
+    glm::vec3 scale() const;
+    glm::vec3 voxel_position_start(std::size_t x, std::size_t y, std::size_t z) const;
+    glm::vec3 voxel_position_end(std::size_t x, std::size_t y, std::size_t z) const;
+    glm::vec3 voxel_position_center(std::size_t x, std::size_t y, std::size_t z) const;
+    float voxel(std::size_t x, std::size_t y, std::size_t z) const;
+    float voxel(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const;
+    float voxel_normalized(std::size_t x, std::size_t y, std::size_t z) const;
+    float voxel_normalized(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const;
+
+    /**
+     * Returns the number of voxels along each edge of a brick.
+     * @return brick size
+     */
+    std::size_t brick_size() const;
+
+    /**
+     * Returns the number of bytes of a single brick.
+     * @return brick size in bytes
+     */
+    std::size_t brick_bytes() const;
+
+    /**
+     * Returns the number of bytes of the resident bricks.
+     * @return resident bytes
+     */
+    std::size_t resident_bytes() const;
+
+    /**
+     * Returns the maximum number of bytes of resident bricks.
+     * @return residency budget
+     */
+    std::size_t residency_budget() const;
+
+    /**
+     * Changes the residency budget, evicting bricks exceeding it.
+     * @param budget maximum number of bytes of resident bricks
+     */
+    void set_residency_budget(std::size_t budget);
+
+    /**
+     * Returns the number of bricks read from disk so far.
+     * @return number of brick reads
+     */
+    std::size_t brick_reads() const;
+
+private:
+    using Brick = std::shared_ptr<const std::vector<unsigned char>>;
+
+    Brick brick(std::size_t brick_index) const;
+
+    mutable std::mutex m_mutex;
+    mutable std::ifstream m_file;
+    mutable LRUCache<std::size_t, Brick> m_bricks;
+    mutable std::size_t m_brick_reads;
+    std::vector<glm::vec2> m_component_ranges;
+    std::string m_name;
+    std::uint64_t m_data_offset;
+    std::size_t m_size_x;
+    std::size_t m_size_y;
+    std::size_t m_size_z;
+    std::size_t m_components;
+    std::size_t m_brick_size;
+    std::size_t m_bricks_x;
+    std::size_t m_bricks_y;
+    std::size_t m_bricks_z;
+    float m_scale_x;
+    float m_scale_y;
+    float m_scale_z;
+};
@@ -0,0 +1,649 @@
+#include <command_line.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <application.h>
+#include <benchmark.h>
+#include <bricked_volume.h>
+#include <compressed_volume.h>
+#include <dds_codec.h>
+#include <gpu_device.h>
+#include <gpu_normalizer.h>
+#include <streamline_tracer.h>
+#include <task_scheduler.h>
+#include <volume_layout.h>
+#include <volume_view.h>
+
+namespace {
+
+void print_usage()
+{
+    std::cerr << "Usage: app --verify-gpu [volume] [--software]\n"
+                 "       app --verify-bricks\n"
+                 "       app --verify-compressed [volume]\n"
+                 "       app --verify-streamlines\n"
+                 "       app --bench-layouts <volume> [repetitions]\n"
+                 "       app --bench-kernels <volume> [repetitions]\n"
+                 "       app --bench-scaling <volume> [max threads] [repetitions]\n"
+                 "       app --benchmark <volume> [options]"
+              << std::endl;
+}
+
+// Parses a count of at least `minimum`, e.g. a number of frames.
+std::size_t parse_count(std::string_view arg, std::size_t minimum = 1)
+{
+    std::size_t count { 0 };
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), count);
+    if (error != std::errc {} || end != arg.data() + arg.size() || count < minimum) {
+        throw std::invalid_argument(
+            "expected an integer of at least " + std::to_string(minimum) + " instead of '" + std::string { arg } + "'");
+    }
+    return count;
+}
+
+// Parses a finite number greater than zero, e.g. a time step.
+double parse_positive(std::string_view arg)
+{
+    double value { 0.0 };
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    if (error != std::errc {} || end != arg.data() + arg.size() || !std::isfinite(value) || !(value > 0.0)) {
+        throw std::invalid_argument("expected a positive number instead of '" + std::string { arg } + "'");
+    }
+    return value;
+}
+
+// Parses an optional positive count, e.g. a number of repetitions.
+std::size_t count_argument(std::span<char*> args, std::size_t index, std::size_t fallback)
+{
+    if (index >= args.size()) {
+        return fallback;
+    }
+    return parse_count(args[index]);
+}
+
+// Returns the voxels of a synthetic volume, whose components all span a range of values.
+std::vector<unsigned char> synthetic_volume(glm::vec<3, std::size_t> extends, std::size_t components)
+{
+    std::vector<unsigned char> voxels(extends.x * extends.y * extends.z * components);
+    std::size_t i { 0 };
+    for (std::size_t z { 0 }; z < extends.z; ++z) {
+        for (std::size_t y { 0 }; y < extends.y; ++y) {
+            for (std::size_t x { 0 }; x < extends.x; ++x) {
+                for (std::size_t c { 0 }; c < components; ++c) {
+                    voxels[i++] = static_cast<unsigned char>((x * 3 + y * 5 + z * 7 + c * 101) % 256);
+                }
+            }
+        }
+    }
+    return voxels;
+}
+
+// Writes a synthetic volume as PVM file into the temporary directory.
+std::filesystem::path write_synthetic_volume(const char* name, glm::vec<3, std::size_t> extends, std::size_t components)
+{
+    std::filesystem::path path { std::filesystem::temp_directory_path() / name };
+    std::vector<unsigned char> voxels { synthetic_volume(extends, components) };
+    write_pvm_volume(path, voxels.data(), extends, components);
+    return path;
+}
+
+// Compares the GPU normalization with the CPU reference, without opening a
+// window. Without a volume, a synthetic one is verified. Returns 77 if no
+// device is available, which CTest reports as skipped.
+int verify_gpu_normalization(const std::optional<std::filesystem::path>& volume_path, bool software)
+{
+    auto instance = wgpu::createInstance({ wgpu::Default });
+    if (!instance) {
+        std::cerr << "Could not create WebGPU instance!" << std::endl;
+        return 77;
+    }
+
+    auto device = create_headless_device(instance, software);
+    if (!device) {
+        std::cerr << "Could not create WebGPU device!" << std::endl;
+        instance.release();
+        return 77;
+    }
+
+    bool matches { false };
+    std::filesystem::path synthetic_path {};
+    try {
+        if (!volume_path) {
+            synthetic_path = write_synthetic_volume("verify_gpu.pvm", glm::vec<3, std::size_t> { 67, 45, 33 }, 2);
+        }
+        GPUVolumeNormalizer normalizer { device };
+        matches = normalizer.verify(volume_path.value_or(synthetic_path), std::cout);
+    } catch (const std::exception& e) {
+        std::cerr << "Verification failed: " << e.what() << std::endl;
+    }
+
+    if (!synthetic_path.empty()) {
+        std::error_code error {};
+        std::filesystem::remove(synthetic_path, error);
+    }
+    device.destroy();
+    device.release();
+    instance.release();
+    return matches ? 0 : 1;
+}
+
+// Converts a synthetic volume into bricks and reads it back through a brick
+// cache smaller than the volume, comparing every voxel with `PVMVolume`.
+int verify_bricked_volume()
+{
+    constexpr glm::vec<3, std::size_t> extends { 100, 90, 70 };
+    constexpr std::size_t components { 2 };
+    constexpr std::size_t brick_size { 16 };
+    std::filesystem::path pvm_path {};
+    std::filesystem::path brick_path { std::filesystem::temp_directory_path() / "verify_bricks.brk" };
+
+    bool passed { false };
+    try {
+        pvm_path = write_synthetic_volume("verify_bricks.pvm", extends, components);
+        BrickedVolume::convert(pvm_path, brick_path, brick_size);
+
+        PVMVolume reference { pvm_path };
+        std::size_t volume_bytes { extends.x * extends.y * extends.z * components };
+        BrickedVolume bricked { brick_path, volume_bytes / 4 };
+        std::size_t mismatches { 0 };
+        std::size_t max_resident_bytes { 0 };
+        for (std::size_t z { 0 }; z < extends.z; ++z) {
+            for (std::size_t y { 0 }; y < extends.y; ++y) {
+                for (std::size_t x { 0 }; x < extends.x; ++x) {
+                    for (std::size_t c { 0 }; c < components; ++c) {
+                        if (reference.voxel(x, y, z, c) != bricked.voxel(x, y, z, c)
+                            || reference.voxel_normalized(x, y, z, c) != bricked.voxel_normalized(x, y, z, c)) {
+                            mismatches++;
+                        }
+                    }
+                }
+                max_resident_bytes = std::max(max_resident_bytes, bricked.resident_bytes());
+            }
+        }
+
+        std::size_t brick_count { ((extends.x + brick_size - 1) / brick_size) * ((extends.y + brick_size - 1) / brick_size)
+            * ((extends.z + brick_size - 1) / brick_size) };
+        std::cout << "Compared " << volume_bytes << " values: " << mismatches << " mismatches" << std::endl;
+        std::cout << "Read " << bricked.brick_reads() << " times from " << brick_count << " bricks, at most "
+                  << max_resident_bytes << " of " << bricked.residency_budget() << " budget bytes resident" << std::endl;
+        passed = mismatches == 0 && bricked.brick_reads() > brick_count && max_resident_bytes <= bricked.residency_budget();
+    } catch (const std::exception& e) {
+        std::cerr << "Verification failed: " << e.what() << std::endl;
+    }
+
+    std::error_code error {};
+    if (!pvm_path.empty()) {
+        std::filesystem::remove(pvm_path, error);
+    }
+    std::filesystem::remove(brick_path, error);
+    return passed ? 0 : 1;
+}
+
+// Compresses a volume losslessly and lossily and compares every voxel with
+// `PVMVolume`. Without a volume, a synthetic one is verified. The lossless
+// values have to be exact, the lossy ones within the maximum error.
+int verify_compressed_volume(const std::optional<std::filesystem::path>& volume_path)
+{
+    constexpr std::size_t brick_size { 16 };
+    constexpr std::uint32_t max_error { 4 };
+    std::filesystem::path synthetic_path {};
+
+    bool passed { false };
+    try {
+        if (!volume_path) {
+            synthetic_path = write_synthetic_volume("verify_compressed.pvm", glm::vec<3, std::size_t> { 100, 90, 70 }, 2);
+        }
+        PVMVolume reference { volume_path.value_or(synthetic_path) };
+
+        // Returns the number of values differing by more than `tolerance`.
+        // Constant components are NaN in both volumes.
+        auto compare = [&](const CompressedVolume& compressed, std::uint32_t tolerance) {
+            std::size_t mismatches { 0 };
+            long largest_error { 0 };
+            glm::vec<3, std::size_t> extends { reference.extends() };
+            for (std::size_t z { 0 }; z < extends.z; ++z) {
+                for (std::size_t y { 0 }; y < extends.y; ++y) {
+                    for (std::size_t x { 0 }; x < extends.x; ++x) {
+                        for (std::size_t c { 0 }; c < reference.components(); ++c) {
+                            float expected { reference.voxel(x, y, z, c) };
+                            float actual { compressed.voxel(x, y, z, c) };
+                            if (std::isnan(expected) || std::isnan(actual)) {
+                                mismatches += std::isnan(expected) != std::isnan(actual) ? 1 : 0;
+                                continue;
+                            }
+                            long error { std::abs(std::lround(expected) - std::lround(actual)) };
+                            largest_error = std::max(largest_error, error);
+                            mismatches += error > static_cast<long>(tolerance) ? 1 : 0;
+                        }
+                    }
+                }
+            }
+            std::cout << compressed.uncompressed_bytes() << " values, " << mismatches << " mismatches, largest error "
+                      << largest_error << ", ratio " << std::fixed << std::setprecision(2) << compressed.compression_ratio()
+                      << std::defaultfloat << std::endl;
+            return mismatches;
+        };
+
+        CompressedVolume lossless { reference, CompressionMode::Lossless, 0, brick_size };
+        std::cout << "Lossless: ";
+        std::size_t lossless_mismatches { compare(lossless, 0) };
+
+        CompressedVolume lossy { reference, CompressionMode::Lossy, max_error, brick_size };
+        std::cout << "Lossy with maximum error " << max_error << ": ";
+        std::size_t lossy_mismatches { compare(lossy, max_error) };
+        passed = lossless_mismatches == 0 && lossy_mismatches == 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Verification failed: " << e.what() << std::endl;
+    }
+
+    if (!synthetic_path.empty()) {
+        std::error_code error {};
+        std::filesystem::remove(synthetic_path, error);
+    }
+    return passed ? 0 : 1;
+}
+
+// Traces the same seeds through a synthetic vortex on schedulers with one and
+// with several workers, the lines have to be identical.
+int verify_streamlines()
+{
+    constexpr glm::vec<3, std::size_t> extends { 48, 40, 32 };
+    constexpr std::size_t components { 3 };
+    constexpr std::size_t thread_count { 7 };
+    std::filesystem::path path { std::filesystem::temp_directory_path() / "verify_streamlines.pvm" };
+
+    bool passed { false };
+    try {
+        // Rotation around the z axis with a vertical drift, stored as signed bytes around 127.5.
+        std::vector<unsigned char> voxels(extends.x * extends.y * extends.z * components);
+        glm::vec3 center { glm::vec3 { extends } * 0.5f };
+        std::size_t i { 0 };
+        for (std::size_t z { 0 }; z < extends.z; ++z) {
+            for (std::size_t y { 0 }; y < extends.y; ++y) {
+                for (std::size_t x { 0 }; x < extends.x; ++x, i += components) {
+                    glm::vec3 position { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) };
+                    glm::vec3 vector { center.y - position.y, position.x - center.x, 0.25f * center.z - 0.5f * std::abs(position.z - center.z) };
+                    vector /= center;
+                    for (std::size_t c { 0 }; c < components; ++c) {
+                        float value { std::clamp(127.5f + 127.5f * vector[static_cast<int>(c)], 0.0f, 255.0f) };
+                        voxels[i + components - 1 - c] = static_cast<unsigned char>(value);
+                    }
+                }
+            }
+        }
+        write_pvm_volume(path, voxels.data(), extends, components);
+
+        PVMVolume volume { path };
+        StreamlineParameters parameters {};
+        parameters.max_points = 512;
+        StreamlineTracer tracer { volume, 127.5f };
+        std::vector<glm::vec3> seeds { tracer.random_seeds(1024, 1) };
+
+        // The traces run as tasks, so their batches stay on the workers of each scheduler.
+        auto trace = [&](std::size_t workers) {
+            StreamlineBuffers buffers {};
+            TaskScheduler scheduler { workers };
+            scheduler.submit([&]() { buffers = tracer.trace(seeds, parameters); }).get();
+            return buffers;
+        };
+        StreamlineBuffers expected { trace(1) };
+        StreamlineBuffers actual { trace(thread_count) };
+
+        passed = expected.line_offsets == actual.line_offsets && expected.position_x == actual.position_x
+            && expected.position_y == actual.position_y && expected.position_z == actual.position_z
+            && expected.speed == actual.speed;
+        std::cout << "Traced " << expected.line_count() << " lines with " << expected.point_count() << " points on 1 and "
+                  << thread_count << " threads: " << (passed ? "identical" : "different") << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Verification failed: " << e.what() << std::endl;
+    }
+
+    std::error_code error {};
+    std::filesystem::remove(path, error);
+    return passed ? 0 : 1;
+}
+
+void print_benchmark_usage()
+{
+    std::cerr << "Usage: app --benchmark <volume> [--frames N] [--warmup N] [--timestep seconds] [--script file]\n"
+                 "                             [--baseline file] [--tolerance fraction] [--write-baseline file]\n"
+                 "                             [--csv file] [--headless] [--software] [--width N] [--height N]"
+              << std::endl;
+}
+
+// Plays back a camera and transfer function path with a fixed time step and
+// without vsync, and compares the frame times with a stored baseline.
+int run_benchmark(std::span<char*> args)
+{
+    ApplicationOptions app_options {};
+    app_options.vsync = false;
+    BenchmarkOptions options {};
+    options.volume = args[0];
+    std::optional<std::string> baseline_path {};
+    std::optional<std::string> write_baseline_path {};
+    std::optional<std::string> csv_path {};
+    double tolerance { 0.1 };
+
+    try {
+        for (std::size_t i { 1 }; i < args.size(); ++i) {
+            std::string_view arg { args[i] };
+            auto value = [&]() {
+                if (i + 1 >= args.size()) {
+                    throw std::invalid_argument("missing value of " + std::string { arg });
+                }
+                return std::string { args[++i] };
+            };
+            auto extent = [&]() {
+                std::size_t pixels { parse_count(value()) };
+                if (pixels > std::numeric_limits<std::uint32_t>::max()) {
+                    throw std::invalid_argument("window size too large");
+                }
+                return static_cast<std::uint32_t>(pixels);
+            };
+
+            if (arg == "--frames") {
+                options.frames = parse_count(value());
+            } else if (arg == "--warmup") {
+                options.warmup_frames = parse_count(value(), 0);
+            } else if (arg == "--timestep") {
+                options.timestep = static_cast<float>(parse_positive(value()));
+            } else if (arg == "--script") {
+                options.script = BenchmarkScript::load(value());
+            } else if (arg == "--baseline") {
+                baseline_path = value();
+            } else if (arg == "--tolerance") {
+                tolerance = parse_positive(value());
+            } else if (arg == "--write-baseline") {
+                write_baseline_path = value();
+            } else if (arg == "--csv") {
+                csv_path = value();
+            } else if (arg == "--headless") {
+                app_options.headless = true;
+            } else if (arg == "--software") {
+                app_options.software_adapter = true;
+            } else if (arg == "--width") {
+                app_options.width = extent();
+            } else if (arg == "--height") {
+                app_options.height = extent();
+            } else {
+                throw std::invalid_argument("unknown option " + std::string { arg });
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid benchmark arguments: " << e.what() << std::endl;
+        print_benchmark_usage();
+        return 1;
+    }
+
+    BenchmarkRecord record {};
+    try {
+        Application app { app_options };
+        record = app.run_benchmark(options);
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    BenchmarkSummary summary { record.summary() };
+    std::cout << "Rendered " << summary.frames << " frames of " << options.volume.string() << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "        mean ms    p95 ms    p99 ms  worst ms" << std::endl;
+    std::cout << "cpu " << std::setw(11) << summary.cpu.mean << std::setw(10) << summary.cpu.p95 << std::setw(10)
+              << summary.cpu.p99 << std::setw(10) << summary.cpu.worst << std::endl;
+    std::cout << "gpu " << std::setw(11) << summary.gpu.mean << std::setw(10) << summary.gpu.p95 << std::setw(10)
+              << summary.gpu.p99 << std::setw(10) << summary.gpu.worst << std::endl;
+    std::cout << std::defaultfloat;
+
+    if (csv_path) {
+        std::ofstream file { *csv_path };
+        record.write_csv(file);
+    }
+    if (write_baseline_path) {
+        std::ofstream file { *write_baseline_path };
+        summary.write(file);
+    }
+    if (!baseline_path) {
+        return 0;
+    }
+
+    BenchmarkSummary baseline {};
+    try {
+        std::ifstream file { *baseline_path };
+        if (!file) {
+            throw std::runtime_error("could not open " + *baseline_path);
+        }
+        baseline = BenchmarkSummary::read(file);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid baseline: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << std::endl;
+    write_comparison(std::cout, summary, baseline);
+    auto regressions = find_regressions(summary, baseline, tolerance);
+    for (const BenchmarkRegression& regression : regressions) {
+        std::cout << "Regression: " << regression.metric << " " << regression.baseline_ms << " ms -> "
+                  << regression.current_ms << " ms" << std::endl;
+    }
+    return regressions.empty() ? 0 : 2;
+}
+
+// Times per-component kernels on the interleaved and the planar layout of a volume.
+int benchmark_layouts(const char* volume_path, std::size_t repetitions)
+{
+    std::vector<KernelTiming> timings {};
+    try {
+        PVMVolume interleaved { volume_path };
+        PlanarVolume planar { interleaved };
+        std::size_t components { interleaved.components() };
+        std::size_t voxels { planar.voxel_count() };
+        std::cout << "Volume " << volume_path << ": " << voxels << " voxels, " << components << " component(s)" << std::endl;
+
+        std::vector<float> buffer(voxels * components);
+        timings.push_back(time_kernel("interleaved -> planar", repetitions, [&]() { planar = PlanarVolume { interleaved }; }));
+        timings.push_back(time_kernel("planar -> interleaved", repetitions, [&]() { planar.interleave(buffer); }));
+        timings.push_back(time_kernel("magnitude interleaved", repetitions, [&]() { component_magnitude(interleaved); }));
+        timings.push_back(time_kernel("magnitude planar", repetitions, [&]() { component_magnitude(planar); }));
+        for (std::size_t c { 0 }; c < components; ++c) {
+            std::string suffix { " c" + std::to_string(c) };
+            timings.push_back(time_kernel("histogram interleaved" + suffix, repetitions, [&]() { component_histogram(interleaved, c, 256); }));
+            timings.push_back(time_kernel("histogram planar" + suffix, repetitions, [&]() { component_histogram(planar, c, 256); }));
+            buffer.resize(voxels);
+            timings.push_back(time_kernel("extract interleaved" + suffix, repetitions, [&]() { extract_component(interleaved, c, buffer); }));
+            timings.push_back(time_kernel("extract planar" + suffix, repetitions, [&]() { extract_component(planar, c, buffer); }));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Layout benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    write_kernel_timings(std::cout, timings);
+    return 0;
+}
+
+// Times the volume view kernels with a runtime component count and with the
+// specialization picked by `visit_components`.
+int benchmark_view_kernels(const char* volume_path, std::size_t repetitions)
+{
+    std::vector<KernelTiming> timings {};
+    try {
+        PVMVolume volume { volume_path };
+        VolumeView<const float> normalized { volume.view() };
+        std::size_t components { volume.components() };
+        std::size_t voxels { normalized.voxel_count() };
+        std::cout << "Volume " << volume_path << ": " << voxels << " voxels, " << components << " component(s)" << std::endl;
+
+        // Restore the non-normalized values, as input of the range and normalization kernels.
+        std::vector<glm::vec2> ranges {};
+        for (std::size_t c { 0 }; c < components; ++c) {
+            ranges.push_back(volume.component_range(c));
+        }
+        std::vector<float> values(voxels * components);
+        VolumeView<float> values_view { values.data(), volume.extends(), components };
+        for (std::size_t i { 0 }; i < voxels; ++i) {
+            for (std::size_t c { 0 }; c < components; ++c) {
+                values_view.at(i, c) = ranges[c].x + normalized.at(i, c) * (ranges[c].y - ranges[c].x);
+            }
+        }
+        VolumeView<const float> raw { values_view };
+
+        std::mt19937 generator { 1 };
+        glm::vec3 upper { glm::vec3 { volume.extends() } - 1.0f };
+        std::uniform_real_distribution<float> distribution { 0.0f, 1.0f };
+        std::vector<glm::vec3> positions(std::size_t { 1 } << 20);
+        for (glm::vec3& position : positions) {
+            position = glm::vec3 { distribution(generator), distribution(generator), distribution(generator) } * upper;
+        }
+
+        std::vector<float> output(std::max(voxels * components, positions.size()));
+        std::vector<glm::vec2> output_ranges(components);
+        std::vector<std::size_t> histogram {};
+        std::vector<glm::vec3> gradient {};
+        auto time_both = [&](const std::string& name, const VolumeView<const float>& view, auto kernel) {
+            timings.push_back(time_kernel(name + " generic", repetitions, [&]() { kernel(view); }));
+            timings.push_back(time_kernel(name + " specialized", repetitions, [&]() { visit_components(view, kernel); }));
+        };
+
+        time_both("ranges", raw, [&](auto view) {
+            std::fill(output_ranges.begin(), output_ranges.end(), glm::vec2 { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() });
+            accumulate_voxel_ranges(view, output_ranges);
+        });
+        time_both("normalize", raw, [&](auto view) {
+            constexpr std::size_t view_components { std::remove_cvref_t<decltype(view)>::static_components };
+            normalize_voxels(view, ranges, VolumeView<float, view_components> { output.data(), view.extends(), components });
+        });
+        time_both("histogram", normalized, [&](auto view) { histogram = voxel_histogram(view, 0, 256); });
+        time_both("gradient", normalized, [&](auto view) { gradient = voxel_gradient(view, 0); });
+        time_both("sample", normalized, [&](auto view) {
+            sample_voxels(view, positions, 0, std::span { output.data(), positions.size() });
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Kernel benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    write_kernel_timings(std::cout, timings);
+    return 0;
+}
+
+// Times the load of a volume on schedulers with 1 to `max_threads` workers.
+int benchmark_load_scaling(const char* volume_path, std::size_t max_threads, std::size_t repetitions)
+{
+    std::vector<KernelTiming> timings {};
+    try {
+        for (std::size_t threads { 1 }; threads <= max_threads; ++threads) {
+            // The load runs as a task, so its normalization stays on the workers of this scheduler.
+            TaskScheduler scheduler { threads };
+            timings.push_back(time_kernel("load " + std::to_string(threads) + " thread(s)", repetitions, [&]() {
+                scheduler.submit([&]() { PVMVolume volume { volume_path }; }).get();
+            }));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Scaling benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    write_kernel_timings(std::cout, timings);
+    std::cout << std::endl << "threads  speedup" << std::endl << std::fixed << std::setprecision(2);
+    for (std::size_t i { 0 }; i < timings.size(); ++i) {
+        std::cout << std::setw(7) << i + 1 << std::setw(9) << timings.front().timing.mean / timings[i].timing.mean << std::endl;
+    }
+    std::cout << std::defaultfloat;
+    return 0;
+}
+
+}
+
+std::optional<int> run_command_line_mode(std::span<char*> args)
+{
+    if (args.empty()) {
+        return std::nullopt;
+    }
+
+    std::string_view mode { args[0] };
+    if (mode == "--verify-bricks") {
+        return verify_bricked_volume();
+    }
+    if (mode == "--verify-streamlines") {
+        return verify_streamlines();
+    }
+    if (mode == "--verify-compressed") {
+        if (args.size() > 2) {
+            print_usage();
+            return 1;
+        }
+        return verify_compressed_volume(args.size() == 2 ? std::optional<std::filesystem::path> { args[1] } : std::nullopt);
+    }
+    if (mode == "--verify-gpu") {
+        std::optional<std::filesystem::path> volume_path {};
+        bool software { false };
+        for (const char* arg : args.subspan(1)) {
+            if (std::string_view { arg } == "--software") {
+                software = true;
+            } else {
+                volume_path = arg;
+            }
+        }
+        return verify_gpu_normalization(volume_path, software);
+    }
+    if (mode != "--benchmark" && mode != "--bench-layouts" && mode != "--bench-kernels" && mode != "--bench-scaling") {
+        if (!mode.starts_with("--")) {
+            return std::nullopt;
+        }
+        std::cerr << "Unknown mode " << mode << std::endl;
+        print_usage();
+        return 1;
+    }
+    if (args.size() < 2) {
+        std::cerr << "Missing volume of " << mode << std::endl;
+        print_usage();
+        return 1;
+    }
+
+    const char* volume_path { args[1] };
+    if (mode == "--benchmark") {
+        return run_benchmark(args.subspan(1));
+    }
+
+    std::size_t repetitions { 0 };
+    std::size_t max_threads { 0 };
+    try {
+        if (mode == "--bench-scaling") {
+            max_threads = count_argument(args, 2, std::max(std::thread::hardware_concurrency(), 1u));
+            repetitions = count_argument(args, 3, 3);
+        } else {
+            repetitions = count_argument(args, 2, 10);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid arguments: " << e.what() << std::endl;
+        print_usage();
+        return 1;
+    }
+
+    if (mode == "--bench-layouts") {
+        return benchmark_layouts(volume_path, repetitions);
+    }
+    if (mode == "--bench-kernels") {
+        return benchmark_view_kernels(volume_path, repetitions);
+    }
+    return benchmark_load_scaling(volume_path, max_threads, repetitions);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <optional>
+#include <span>
+
+/**
+ * Runs the mode selected on the command line instead of the application.
+ *
+ * The modes verify or benchmark parts of the application without user
+ * interaction: `--verify-gpu`, `--verify-bricks`, `--verify-streamlines`,
+ * `--benchmark`, `--bench-layouts`, `--bench-kernels` and `--bench-scaling`.
+ * Invalid arguments print the usage.
+ *
+ * @param args command line arguments without the program name
+ * @return exit code of the mode, or nothing if no mode was selected
+ */
+std::optional<int> run_command_line_mode(std::span<char*> args);
@@ -0,0 +1,434 @@
+#include <compressed_volume.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::size_t group_size { 32 };
+constexpr std::uint32_t group_header_bits { 4 };
+
+class BitWriter {
+public:
+    BitWriter(std::vector<std::uint8_t>& output)
+        : m_output { output }
+        , m_buffer { 0 }
+        , m_bits { 0 }
+    {
+    }
+
+    void write(std::uint32_t value, std::uint32_t bits)
+    {
+        this->m_buffer |= static_cast<std::uint64_t>(value) << this->m_bits;
+        this->m_bits += bits;
+        while (this->m_bits >= 8) {
+            this->m_output.push_back(static_cast<std::uint8_t>(this->m_buffer));
+            this->m_buffer >>= 8;
+            this->m_bits -= 8;
+        }
+    }
+
+    void flush()
+    {
+        if (this->m_bits > 0) {
+            this->m_output.push_back(static_cast<std::uint8_t>(this->m_buffer));
+            this->m_buffer = 0;
+            this->m_bits = 0;
+        }
+    }
+
+private:
+    std::vector<std::uint8_t>& m_output;
+    std::uint64_t m_buffer;
+    std::uint32_t m_bits;
+};
+
+class BitReader {
+public:
+    BitReader(const std::vector<std::uint8_t>& input)
+        : m_input { input }
+        , m_position { 0 }
+        , m_buffer { 0 }
+        , m_bits { 0 }
+    {
+    }
+
+    std::uint32_t read(std::uint32_t bits)
+    {
+        while (this->m_bits < bits) {
+            std::uint64_t byte { this->m_position < this->m_input.size() ? this->m_input[this->m_position] : 0u };
+            this->m_buffer |= byte << this->m_bits;
+            this->m_position++;
+            this->m_bits += 8;
+        }
+        std::uint32_t value { static_cast<std::uint32_t>(this->m_buffer & ((std::uint64_t { 1 } << bits) - 1)) };
+        this->m_buffer >>= bits;
+        this->m_bits -= bits;
+        return value;
+    }
+
+private:
+    const std::vector<std::uint8_t>& m_input;
+    std::size_t m_position;
+    std::uint64_t m_buffer;
+    std::uint32_t m_bits;
+};
+
+std::uint32_t zigzag(std::int32_t value)
+{
+    return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+}
+
+std::int32_t unzigzag(std::uint32_t value)
+{
+    return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+}
+
+// Predicts a value from its left neighbour, or from the row/slice before at the border.
+std::int32_t predict(const std::uint8_t* plane, glm::vec<3, std::size_t> extends, std::size_t x, std::size_t y, std::size_t z)
+{
+    std::size_t index { x + y * extends.x + z * extends.x * extends.y };
+    if (x > 0) {
+        return plane[index - 1];
+    }
+    if (y > 0) {
+        return plane[index - extends.x];
+    }
+    if (z > 0) {
+        return plane[index - extends.x * extends.y];
+    }
+    return 0;
+}
+
+void encode_plane(const std::uint8_t* values, glm::vec<3, std::size_t> extends, std::uint32_t max_error,
+    BitWriter& writer)
+{
+    std::size_t count { extends.x * extends.y * extends.z };
+    std::int32_t step { static_cast<std::int32_t>(2 * max_error + 1) };
+    std::vector<std::uint8_t> reconstructed(count);
+
+    std::array<std::uint32_t, group_size> group {};
+    for (std::size_t start { 0 }; start < count; start += group_size) {
+        std::size_t end { std::min(start + group_size, count) };
+        std::uint32_t group_bits { 0 };
+        for (std::size_t i { start }; i < end; ++i) {
+            std::size_t x { i % extends.x };
+            std::size_t y { (i / extends.x) % extends.y };
+            std::size_t z { i / (extends.x * extends.y) };
+            std::int32_t prediction { predict(reconstructed.data(), extends, x, y, z) };
+
+            // Quantize the residual to the nearest multiple of the step.
+            std::int32_t residual { static_cast<std::int32_t>(values[i]) - prediction };
+            std::int32_t quantized { residual >= 0 ? (residual + static_cast<std::int32_t>(max_error)) / step
+                                                   : -((-residual + static_cast<std::int32_t>(max_error)) / step) };
+            reconstructed[i] = static_cast<std::uint8_t>(std::clamp(prediction + quantized * step, 0, 255));
+
+            group[i - start] = zigzag(quantized);
+            group_bits = std::max(group_bits, static_cast<std::uint32_t>(std::bit_width(group[i - start])));
+        }
+
+        writer.write(group_bits, group_header_bits);
+        for (std::size_t i { start }; i < end; ++i) {
+            writer.write(group[i - start], group_bits);
+        }
+    }
+}
+
+void decode_plane(BitReader& reader, glm::vec<3, std::size_t> extends, std::uint32_t max_error, std::uint8_t* plane)
+{
+    std::size_t count { extends.x * extends.y * extends.z };
+    std::int32_t step { static_cast<std::int32_t>(2 * max_error + 1) };
+
+    for (std::size_t start { 0 }; start < count; start += group_size) {
+        std::size_t end { std::min(start + group_size, count) };
+        std::uint32_t group_bits { reader.read(group_header_bits) };
+        for (std::size_t i { start }; i < end; ++i) {
+            std::size_t x { i % extends.x };
+            std::size_t y { (i / extends.x) % extends.y };
+            std::size_t z { i / (extends.x * extends.y) };
+            std::int32_t prediction { predict(plane, extends, x, y, z) };
+            std::int32_t quantized { unzigzag(reader.read(group_bits)) };
+            plane[i] = static_cast<std::uint8_t>(std::clamp(prediction + quantized * step, 0, 255));
+        }
+    }
+}
+
+}
+
+CompressedVolume::CompressedVolume(const PVMVolume& volume, CompressionMode mode,
+    std::uint32_t max_error, std::size_t brick_size, std::size_t cache_budget)
+    : m_mutex {}
+    , m_cache { cache_budget }
+    , m_bricks {}
+    , m_compressed_memory { MemoryTag::CompressedVolumes }
+    , m_component_ranges {}
+    , m_mode { mode }
+    , m_max_error { mode == CompressionMode::Lossless ? 0 : max_error }
+    , m_size_x { volume.size_x() }
+    , m_size_y { volume.size_y() }
+    , m_size_z { volume.size_z() }
+    , m_components { volume.components() }
+    , m_brick_size { brick_size }
+    , m_bricks_x { 0 }
+    , m_bricks_y { 0 }
+    , m_scale_x { volume.scale_x() }
+    , m_scale_y { volume.scale_y() }
+    , m_scale_z { volume.scale_z() }
+{
+    if (brick_size == 0) {
+        throw std::invalid_argument("invalid brick size");
+    }
+    if (this->m_max_error > 127) {
+        throw std::invalid_argument("maximum error out of range");
+    }
+
+    for (std::size_t c { 0 }; c < this->m_components; ++c) {
+        this->m_component_ranges.push_back(volume.component_range(c));
+    }
+
+    this->m_bricks_x = (this->m_size_x + brick_size - 1) / brick_size;
+    this->m_bricks_y = (this->m_size_y + brick_size - 1) / brick_size;
+    std::size_t bricks_z { (this->m_size_z + brick_size - 1) / brick_size };
+    this->m_bricks.resize(this->m_bricks_x * this->m_bricks_y * bricks_z);
+
+    // The volume only holds normalized values, the 8-bit values are recovered
+    // from the component ranges.
+    const float* data { volume.data() };
+    std::vector<std::uint8_t> plane(brick_size * brick_size * brick_size);
+    for (std::size_t brick_index { 0 }; brick_index < this->m_bricks.size(); ++brick_index) {
+        glm::vec<3, std::size_t> extends { this->brick_extends(brick_index) };
+        glm::vec<3, std::size_t> origin {
+            (brick_index % this->m_bricks_x) * brick_size,
+            ((brick_index / this->m_bricks_x) % this->m_bricks_y) * brick_size,
+            (brick_index / (this->m_bricks_x * this->m_bricks_y)) * brick_size
+        };
+
+        std::vector<std::uint8_t>& compressed { this->m_bricks[brick_index] };
+        BitWriter writer { compressed };
+        for (std::size_t c { 0 }; c < this->m_components; ++c) {
+            glm::vec2 range { this->m_component_ranges[c] };
+            std::size_t i { 0 };
+            for (std::size_t z { origin.z }; z < origin.z + extends.z; ++z) {
+                for (std::size_t y { origin.y }; y < origin.y + extends.y; ++y) {
+                    for (std::size_t x { origin.x }; x < origin.x + extends.x; ++x) {
+                        std::size_t voxel_index { (x + y * this->m_size_x + z * this->m_size_x * this->m_size_y) * this->m_components };
+                        float normalized { data[voxel_index + (this->m_components - 1 - c)] };
+                        float value { range.x == range.y ? range.x : range.x + normalized * (range.y - range.x) };
+                        plane[i++] = static_cast<std::uint8_t>(std::clamp(std::lround(value), 0l, 255l));
+                    }
+                }
+            }
+            encode_plane(plane.data(), extends, this->m_max_error, writer);
+        }
+        writer.flush();
+        compressed.shrink_to_fit();
+    }
+
+    std::size_t compressed_bytes { 0 };
+    for (const auto& compressed : this->m_bricks) {
+        compressed_bytes += compressed.size();
+    }
+    this->m_compressed_memory.resize(compressed_bytes);
+}
+
+bool CompressedVolume::is_scalar_field() const
+{
+    return this->m_components == 1;
+}
+
+bool CompressedVolume::is_vector_field() const
+{
+    return this->m_components > 1;
+}
+
+std::size_t CompressedVolume::components() const
+{
+    return this->m_components;
+}
+
+std::size_t CompressedVolume::size_x() const
+{
+    return this->m_size_x;
+}
+
+std::size_t CompressedVolume::size_y() const
+{
+    return this->m_size_y;
+}
+
+std::size_t CompressedVolume::size_z() const
+{
+    return this->m_size_z;
+}
+
+glm::vec<3, std::size_t> CompressedVolume::extends() const
+{
+    return glm::vec<3, std::size_t> {
+        this->m_size_x,
+        this->m_size_y,
+        this->m_size_z
+    };
+}
+
+float CompressedVolume::scale_x() const
+{
+    return this->m_scale_x;
+}
+
+float CompressedVolume::scale_y() const
+{
+    return this->m_scale_y;
+}
+
+float CompressedVolume::scale_z() const
+{
+    return this->m_scale_z;
+}
+
+glm::vec3 CompressedVolume::scale() const
+{
+    return glm::vec3 { this->m_scale_x, this->m_scale_y, this->m_scale_z };
+}
+
+glm::vec3 CompressedVolume::voxel_position_start(std::size_t x, std::size_t y, std::size_t z) const
+{
+    glm::vec3 idx_f { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) };
+    return idx_f * this->scale();
+}
+
+glm::vec3 CompressedVolume::voxel_position_end(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel_position_start(x, y, z) + this->scale();
+}
+
+glm::vec3 CompressedVolume::voxel_position_center(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel_position_start(x, y, z) + (this->scale() * 0.5f);
+}
+
+float CompressedVolume::voxel(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel(x, y, z, 0);
+}
+
+float CompressedVolume::voxel(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const
+{
+    float value { this->voxel_normalized(x, y, z, component) };
+    glm::vec2 range { this->m_component_ranges[component] };
+    float start { range.x };
+    float end { range.y };
+
+    return (start * (1.0f - value)) + (end * value);
+}
+
+float CompressedVolume::voxel_normalized(std::size_t x, std::size_t y, std::size_t z) const
+{
+    return this->voxel_normalized(x, y, z, 0);
+}
+
+float CompressedVolume::voxel_normalized(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const
+{
+    if (x >= this->m_size_x) {
+        throw std::out_of_range("x coordinate out of range");
+    }
+    if (y >= this->m_size_y) {
+        throw std::out_of_range("y coordinate out of range");
+    }
+    if (z >= this->m_size_z) {
+        throw std::out_of_range("z coordinate out of range");
+    }
+    if (component >= this->m_components) {
+        throw std::out_of_range("component index out of range");
+    }
+
+    std::size_t brick_index { (x / this->m_brick_size) + (y / this->m_brick_size) * this->m_bricks_x
+        + (z / this->m_brick_size) * this->m_bricks_x * this->m_bricks_y };
+    glm::vec<3, std::size_t> extends { this->brick_extends(brick_index) };
+    Brick brick { this->brick(brick_index) };
+
+    std::size_t plane_size { extends.x * extends.y * extends.z };
+    std::size_t index { (x % this->m_brick_size) + (y % this->m_brick_size) * extends.x
+        + (z % this->m_brick_size) * extends.x * extends.y };
+    float value { static_cast<float>((*brick)[component * plane_size + index]) };
+
+    glm::vec2 range { this->m_component_ranges[component] };
+    float min = range.x;
+    float max = range.y;
+    return (value - min) / (max - min);
+}
+
+CompressionMode CompressedVolume::mode() const
+{
+    return this->m_mode;
+}
+
+std::uint32_t CompressedVolume::max_error() const
+{
+    return this->m_max_error;
+}
+
+std::size_t CompressedVolume::uncompressed_bytes() const
+{
+    return this->m_size_x * this->m_size_y * this->m_size_z * this->m_components;
+}
+
+std::size_t CompressedVolume::compressed_bytes() const
+{
+    std::size_t bytes { 0 };
+    for (const auto& brick : this->m_bricks) {
+        bytes += brick.size();
+    }
+    return bytes;
+}
+
+double CompressedVolume::compression_ratio() const
+{
+    std::size_t compressed { this->compressed_bytes() };
+    if (compressed == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(this->uncompressed_bytes()) / static_cast<double>(compressed);
+}
+
+std::size_t CompressedVolume::cached_bytes() const
+{
+    std::scoped_lock lock { this->m_mutex };
+    return this->m_cache.size();
+}
+
+glm::vec<3, std::size_t> CompressedVolume::brick_extends(std::size_t brick_index) const
+{
+    std::size_t bx { brick_index % this->m_bricks_x };
+    std::size_t by { (brick_index / this->m_bricks_x) % this->m_bricks_y };
+    std::size_t bz { brick_index / (this->m_bricks_x * this->m_bricks_y) };
+    return glm::vec<3, std::size_t> {
+        std::min(this->m_brick_size, this->m_size_x - bx * this->m_brick_size),
+        std::min(this->m_brick_size, this->m_size_y - by * this->m_brick_size),
+        std::min(this->m_brick_size, this->m_size_z - bz * this->m_brick_size)
+    };
+}
+
+CompressedVolume::Brick CompressedVolume::brick(std::size_t brick_index) const
+{
+    std::scoped_lock lock { this->m_mutex };
+    if (auto brick = this->m_cache.find(brick_index)) {
+        return *brick;
+    }
+
+    glm::vec<3, std::size_t> extends { this->brick_extends(brick_index) };
+    std::size_t plane_size { extends.x * extends.y * extends.z };
+    std::size_t brick_bytes { plane_size * this->m_components };
+    auto planes = make_tracked_shared(MemoryTag::BrickCache, brick_bytes, std::vector<std::uint8_t>(brick_bytes));
+
+    BitReader reader { this->m_bricks[brick_index] };
+    for (std::size_t c { 0 }; c < this->m_components; ++c) {
+        decode_plane(reader, extends, this->m_max_error, planes->data() + c * plane_size);
+    }
+
+    Brick brick { std::move(planes) };
+    this->m_cache.insert(brick_index, brick, brick->size());
+    return brick;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <lru_cache.h>
+#include <memory_tracker.h>
+#include <pvm_volume.h>
+
+/**
+ * Compression modes of a `CompressedVolume`.
+ */
+enum class CompressionMode {
+    Lossless,
+    Lossy,
+};
+
+/**
+ * In-memory volume compressed brick by brick.
+ *
+ * Each brick stores the 8-bit voxel values of every component as a delta
+ * stream, packed in groups of 32 values that share the smallest bit width
+ * able to hold them, similar to the runs of the DDS coder. The lossy mode
+ * quantizes the deltas in a closed loop, so that no value differs from the
+ * original by more than the requested error. Bricks are decompressed on
+ * access and kept in a small LRU cache. The accessors mirror the ones of
+ * `PVMVolume`.
+ */
+class CompressedVolume {
+public:
+    /**
+     * Compresses a volume.
+     * @param volume volume to compress
+     * @param mode compression mode
+     * @param max_error maximum absolute error of the 8-bit values in lossy mode
+     * @param brick_size number of voxels along each edge of a brick
+     * @param cache_budget maximum number of bytes of decompressed bricks
+     */
+    CompressedVolume(const PVMVolume& volume, CompressionMode mode = CompressionMode::Lossless,
+        std::uint32_t max_error = 0, std::size_t brick_size = 32, std::size_t cache_budget = 8 << 20);
+    CompressedVolume(const CompressedVolume&) = delete;
+    CompressedVolume(CompressedVolume&&) = delete;
+    ~CompressedVolume() = default;
+
+    CompressedVolume& operator=(const CompressedVolume&) = delete;
+    CompressedVolume& operator=(CompressedVolume&&) = delete;
+
+    bool is_scalar_field() const;
+    bool is_vector_field() const;
+    std::size_t components() const;
+    std::size_t size_x() const;
+    std::size_t size_y() const;
+    std::size_t size_z() const;
+    glm::vec<3, std::size_t> extends() const;
+    float scale_x() const;
+    float scale_y() const;
+    float scale_z() const;
+    glm::vec3 scale() const;
+    glm::vec3 voxel_position_start(std::size_t x, std::size_t y, std::size_t z) const;
+    glm::vec3 voxel_position_end(std::size_t x, std::size_t y, std::size_t z) const;
+    glm::vec3 voxel_position_center(std::size_t x, std::size_t y, std::size_t z) const;
+    float voxel(std::size_t x, std::size_t y, std::size_t z) const;
+    float voxel(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const;
+    float voxel_normalized(std::size_t x, std::size_t y, std::size_t z) const;
+    float voxel_normalized(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const;
+
+    /**
+     * Returns the compression mode.
+     * @return compression mode
+     */
+    CompressionMode mode() const;
+
+    /**
+     * Returns the maximum absolute error of the 8-bit values.
+     * @return maximum error, 0 for lossless compression
+     */
+    std::uint32_t max_error() const;
+
+    /**
+     * Returns the number of bytes of the volume at its native bit depth.
+     * @return uncompressed bytes
+     */
+    std::size_t uncompressed_bytes() const;
+
+    /**
+     * Returns the number of bytes of all compressed bricks.
+     * @return compressed bytes
+     */
+    std::size_t compressed_bytes() const;
+
+    /**
+     * Returns the ratio between the uncompressed and compressed size.
+     * @return compression ratio
+     */
+    double compression_ratio() const;
+
+    /**
+     * Returns the number of bytes of the decompressed bricks in the cache.
+     * @return cached bytes
+     */
+    std::size_t cached_bytes() const;
+
+private:
+    using Brick = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+    glm::vec<3, std::size_t> brick_extends(std::size_t brick_index) const;
+    Brick brick(std::size_t brick_index) const;
+
+    mutable std::mutex m_mutex;
+    mutable LRUCache<std::size_t, Brick> m_cache;
+    std::vector<std::vector<std::uint8_t>> m_bricks;
+    TrackedAllocation m_compressed_memory;
+    std::vector<glm::vec2> m_component_ranges;
+    CompressionMode m_mode;
+    std::uint32_t m_max_error;
+    std::size_t m_size_x;
+    std::size_t m_size_y;
+    std::size_t m_size_z;
+    std::size_t m_components;
+    std::size_t m_brick_size;
+    std::size_t m_bricks_x;
+    std::size_t m_bricks_y;
+    float m_scale_x;
+    float m_scale_y;
+    float m_scale_z;
+};
@@ -0,0 +1,794 @@
+#include <dds_codec.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <memory_tracker.h>
+#include <task_scheduler.h>
+
+namespace {
+
+constexpr std::string_view dds_id { "DDS v3d\n" };
+constexpr std::string_view dds_id2 { "DDS v3e\n" };
+
+// Streams larger than this are deinterleaved in blocks (format version 2).
+constexpr std::size_t dds_interleave { std::size_t { 1 } << 24 };
+constexpr std::size_t dds_chunk_size { std::size_t { 1 } << 20 };
+constexpr std::uint32_t dds_rl { 7 };
+
+int dds_code(int bits)
+{
+    return bits > 1 ? bits - 1 : bits;
+}
+
+int dds_decode(int bits)
+{
+    return bits >= 1 ? bits + 1 : bits;
+}
+
+// Number of bits needed for the residuals in [-128, 127].
+std::array<int, 256> make_bits_lookup()
+{
+    std::array<int, 256> lookup {};
+    for (int i { -128 }; i < 128; i++) {
+        int bits { 0 };
+        if (i <= 0) {
+            while ((1 << bits) / 2 < -i) {
+                bits++;
+            }
+        } else {
+            while ((1 << bits) / 2 <= i) {
+                bits++;
+            }
+        }
+        lookup[i + 128] = dds_decode(dds_code(bits));
+    }
+    return lookup;
+}
+
+const std::array<int, 256> bits_lookup { make_bits_lookup() };
+
+// Most significant bit first writer, matching the bit order of the DDS coder.
+class BitWriter {
+public:
+    BitWriter()
+        : m_bytes {}
+        , m_buffer { 0 }
+        , m_bits { 0 }
+        , m_count { 0 }
+    {
+    }
+
+    void write(std::uint32_t value, std::uint32_t bits)
+    {
+        if (bits == 0) {
+            return;
+        }
+        this->m_buffer = (this->m_buffer << bits) | (value & ((std::uint64_t { 1 } << bits) - 1));
+        this->m_bits += bits;
+        this->m_count += bits;
+        while (this->m_bits >= 8) {
+            this->m_bits -= 8;
+            this->m_bytes.push_back(static_cast<unsigned char>(this->m_buffer >> this->m_bits));
+        }
+        this->m_buffer &= (std::uint64_t { 1 } << this->m_bits) - 1;
+    }
+
+    // Pads the last byte with zeros and returns the bytes and the number of valid bits.
+    std::pair<std::vector<unsigned char>, std::size_t> finish()
+    {
+        if (this->m_bits > 0) {
+            this->m_bytes.push_back(static_cast<unsigned char>(this->m_buffer << (8 - this->m_bits)));
+        }
+        return { std::move(this->m_bytes), this->m_count };
+    }
+
+private:
+    std::vector<unsigned char> m_bytes;
+    std::uint64_t m_buffer;
+    std::uint32_t m_bits;
+    std::size_t m_count;
+};
+
+// Appends bit sequences of arbitrary length to a file.
+class BitFileWriter {
+public:
+    BitFileWriter(std::ofstream& file)
+        : m_file { file }
+        , m_buffer {}
+        , m_partial { 0 }
+        , m_partial_bits { 0 }
+    {
+        this->m_buffer.reserve(dds_chunk_size);
+    }
+
+    void append(const std::vector<unsigned char>& bytes, std::size_t bits)
+    {
+        std::size_t full_bytes { bits / 8 };
+        if (this->m_partial_bits == 0) {
+            this->m_buffer.insert(this->m_buffer.end(), bytes.begin(), bytes.begin() + full_bytes);
+        } else {
+            for (std::size_t i { 0 }; i < full_bytes; ++i) {
+                this->m_buffer.push_back(static_cast<unsigned char>(this->m_partial | (bytes[i] >> this->m_partial_bits)));
+                this->m_partial = static_cast<unsigned char>(bytes[i] << (8 - this->m_partial_bits));
+            }
+        }
+
+        std::uint32_t rest { static_cast<std::uint32_t>(bits % 8) };
+        if (rest != 0) {
+            // The remaining bits are the high bits of the last byte.
+            unsigned char last { bytes[full_bytes] };
+            this->m_partial |= static_cast<unsigned char>(last >> this->m_partial_bits);
+            if (this->m_partial_bits + rest >= 8) {
+                this->m_buffer.push_back(this->m_partial);
+                this->m_partial = static_cast<unsigned char>(last << (8 - this->m_partial_bits));
+                this->m_partial_bits = this->m_partial_bits + rest - 8;
+            } else {
+                this->m_partial_bits += rest;
+            }
+            this->m_partial &= static_cast<unsigned char>(0xff << (8 - this->m_partial_bits));
+        }
+
+        if (this->m_buffer.size() >= dds_chunk_size) {
+            this->flush_buffer();
+        }
+    }
+
+    void finish()
+    {
+        if (this->m_partial_bits > 0) {
+            this->m_buffer.push_back(this->m_partial);
+            this->m_partial = 0;
+            this->m_partial_bits = 0;
+        }
+        this->flush_buffer();
+    }
+
+private:
+    void flush_buffer()
+    {
+        this->m_file.write(reinterpret_cast<const char*>(this->m_buffer.data()), static_cast<std::streamsize>(this->m_buffer.size()));
+        if (!this->m_file) {
+            throw std::runtime_error("could not write dds file");
+        }
+        this->m_buffer.clear();
+    }
+
+    std::ofstream& m_file;
+    std::vector<unsigned char> m_buffer;
+    unsigned char m_partial;
+    std::uint32_t m_partial_bits;
+};
+
+struct EncodedChunk {
+    std::vector<unsigned char> bytes;
+    std::size_t bits;
+};
+
+// Encodes the bytes [chunk, chunk + count) at the stream position `position`.
+// The `strip + 1` bytes before the chunk must be readable, if they are part
+// of the stream. The run grouping is the one of `DDS_encode` in volumeio, so
+// the encoded chunks can simply be concatenated.
+EncodedChunk encode_chunk(const unsigned char* chunk, std::size_t count, std::size_t position, std::size_t strip)
+{
+    auto residual = [&](std::size_t i) {
+        const unsigned char* ptr { chunk + i };
+        int previous { position + i == 0 ? 0 : ptr[-1] };
+        int act { *ptr - previous };
+        if (strip != 1 && position + i > strip) {
+            std::ptrdiff_t offset { static_cast<std::ptrdiff_t>(strip) };
+            act -= ptr[-offset] - ptr[-offset - 1];
+        }
+
+        while (act < -128) {
+            act += 256;
+        }
+        while (act > 127) {
+            act -= 256;
+        }
+        return act;
+    };
+
+    BitWriter writer {};
+    std::size_t emitted { 0 };
+    auto emit = [&](std::uint32_t run, int bits) {
+        writer.write(run, dds_rl);
+        writer.write(static_cast<std::uint32_t>(dds_code(bits)), 3);
+        for (std::uint32_t i { 0 }; i < run; ++i) {
+            writer.write(static_cast<std::uint32_t>(residual(emitted++) + (1 << bits) / 2), static_cast<std::uint32_t>(bits));
+        }
+    };
+
+    constexpr std::uint32_t max_run { 1u << dds_rl };
+    std::uint32_t cnt1 { 0 }, cnt2 { 0 };
+    int bits1 { 0 }, bits2 { 0 };
+    auto merge_or_emit = [&]() {
+        if (cnt1 + cnt2 < max_run
+            && (cnt1 + cnt2) * static_cast<std::uint32_t>(std::max(bits1, bits2))
+                < cnt1 * static_cast<std::uint32_t>(bits1) + cnt2 * static_cast<std::uint32_t>(bits2) + dds_rl + 3) {
+            cnt2 += cnt1;
+            bits2 = std::max(bits1, bits2);
+        } else {
+            if (cnt2 != 0) {
+                emit(cnt2, bits2);
+            }
+            cnt2 = cnt1;
+            bits2 = bits1;
+        }
+    };
+
+    for (std::size_t i { 0 }; i < count; ++i) {
+        int bits { bits_lookup[residual(i) + 128] };
+        if (cnt1 == 0) {
+            cnt1 = 1;
+            bits1 = bits;
+            continue;
+        }
+        if (cnt1 < max_run - 1 && bits == bits1) {
+            cnt1++;
+            continue;
+        }
+
+        merge_or_emit();
+        cnt1 = 1;
+        bits1 = bits;
+    }
+
+    if (cnt1 != 0) {
+        merge_or_emit();
+    }
+    if (cnt2 != 0) {
+        emit(cnt2, bits2);
+    }
+
+    auto [bytes, bit_count] = writer.finish();
+    return EncodedChunk { std::move(bytes), bit_count };
+}
+
+// Copies the stream range [start, start + count) out of the segments.
+void gather(std::span<const DDSSegment> segments, std::size_t start, std::size_t count, unsigned char* output)
+{
+    std::size_t segment_start { 0 };
+    for (const auto& segment : segments) {
+        std::size_t segment_end { segment_start + segment.size() };
+        if (segment_end > start && segment_start < start + count) {
+            std::size_t begin { std::max(start, segment_start) };
+            std::size_t end { std::min(start + count, segment_end) };
+            std::copy(segment.begin() + (begin - segment_start), segment.begin() + (end - segment_start), output + (begin - start));
+        }
+        segment_start = segment_end;
+    }
+}
+
+// Most significant bit first reader, refilled from a file in blocks.
+class BitFileReader {
+public:
+    BitFileReader(std::ifstream& file, std::size_t bytes_read, std::size_t bytes_total, const DDSProgress& progress)
+        : m_file { file }
+        , m_progress { progress }
+        , m_block(dds_chunk_size)
+        , m_block_position { 0 }
+        , m_block_size { 0 }
+        , m_buffer { 0 }
+        , m_bits { 0 }
+        , m_bytes_read { bytes_read }
+        , m_bytes_total { bytes_total }
+        , m_stopped { false }
+    {
+    }
+
+    // Bits after the end of the file are read as zeros, which terminates the stream.
+    std::uint32_t read(std::uint32_t bits)
+    {
+        while (this->m_bits < bits) {
+            if (this->m_block_position == this->m_block_size) {
+                this->refill();
+            }
+            unsigned char byte { 0 };
+            if (this->m_block_position < this->m_block_size) {
+                byte = this->m_block[this->m_block_position++];
+            }
+            this->m_buffer = (this->m_buffer << 8) | byte;
+            this->m_bits += 8;
+        }
+        this->m_bits -= bits;
+        return static_cast<std::uint32_t>(this->m_buffer >> this->m_bits) & ((std::uint32_t { 1 } << bits) - 1);
+    }
+
+    bool report(std::size_t bytes_decoded)
+    {
+        if (this->m_progress && !this->m_progress(this->m_bytes_read, this->m_bytes_total, bytes_decoded)) {
+            this->m_stopped = true;
+        }
+        return !this->m_stopped;
+    }
+
+    bool stopped() const
+    {
+        return this->m_stopped;
+    }
+
+private:
+    void refill()
+    {
+        this->m_block_position = 0;
+        this->m_block_size = 0;
+        if (this->m_file) {
+            this->m_file.read(reinterpret_cast<char*>(this->m_block.data()), static_cast<std::streamsize>(this->m_block.size()));
+            this->m_block_size = static_cast<std::size_t>(this->m_file.gcount());
+            this->m_bytes_read += this->m_block_size;
+        }
+    }
+
+    std::ifstream& m_file;
+    const DDSProgress& m_progress;
+    std::vector<unsigned char> m_block;
+    std::size_t m_block_position;
+    std::size_t m_block_size;
+    std::uint64_t m_buffer;
+    std::uint32_t m_bits;
+    std::size_t m_bytes_read;
+    std::size_t m_bytes_total;
+    bool m_stopped;
+};
+
+// Restores the interleaved order of a deinterleaved block.
+void interleave(const unsigned char* data, std::size_t count, std::size_t skip, unsigned char* output)
+{
+    const unsigned char* ptr { data };
+    for (std::size_t i { 0 }; i < skip; ++i) {
+        for (std::size_t j { i }; j < count; j += skip) {
+            output[j] = *ptr++;
+        }
+    }
+}
+
+// Maximum size of the text header of a PVM volume.
+constexpr std::size_t max_pvm_header_size { 4096 };
+
+// Parses the text header of a PVM volume. Returns the size of the header, or
+// zero if the header is not complete yet.
+std::size_t parse_pvm_header(std::string_view text, PVMInfo& info)
+{
+    std::size_t position { 0 };
+    auto next_line = [&](std::string& line) {
+        std::size_t end { text.find('\n', position) };
+        if (end == std::string_view::npos) {
+            if (text.size() >= max_pvm_header_size) {
+                throw std::runtime_error("invalid pvm header");
+            }
+            return false;
+        }
+        line = std::string { text.substr(position, end - position) };
+        position = end + 1;
+        return true;
+    };
+
+    std::string line {};
+    if (!next_line(line)) {
+        return 0;
+    }
+
+    bool has_scale { line == "PVM2" || line == "PVM3" };
+    if (line != "PVM" && !has_scale) {
+        throw std::runtime_error("not a pvm volume");
+    }
+
+    do {
+        if (!next_line(line)) {
+            return 0;
+        }
+    } while (!has_scale && line.starts_with('#'));
+    if (std::sscanf(line.c_str(), "%zu %zu %zu", &info.extends.x, &info.extends.y, &info.extends.z) != 3
+        || info.extends.x < 1 || info.extends.y < 1 || info.extends.z < 1) {
+        throw std::runtime_error("invalid pvm volume extends");
+    }
+
+    info.scale = glm::vec3 { 1.0f };
+    if (has_scale) {
+        if (!next_line(line)) {
+            return 0;
+        }
+        if (std::sscanf(line.c_str(), "%g %g %g", &info.scale.x, &info.scale.y, &info.scale.z) != 3
+            || info.scale.x <= 0.0f || info.scale.y <= 0.0f || info.scale.z <= 0.0f) {
+            throw std::runtime_error("invalid pvm voxel scale");
+        }
+    }
+
+    if (!next_line(line)) {
+        return 0;
+    }
+    if (std::sscanf(line.c_str(), "%zu", &info.components) != 1 || info.components < 1) {
+        throw std::runtime_error("invalid pvm volume components");
+    }
+    pvm_volume_bytes(info);
+
+    return position;
+}
+
+}
+
+void write_dds_file(const std::filesystem::path& path, std::span<const DDSSegment> segments,
+    std::size_t skip, std::size_t strip)
+{
+    std::size_t bytes { 0 };
+    for (const auto& segment : segments) {
+        bytes += segment.size();
+    }
+    if (bytes == 0) {
+        throw std::invalid_argument("empty dds stream");
+    }
+
+    if (skip < 1 || skip > 4) {
+        skip = 1;
+    }
+    if (strip < 1 || strip > 65536) {
+        strip = 1;
+    }
+
+    std::ofstream file { path, std::ios::binary | std::ios::trunc };
+    if (!file) {
+        throw std::runtime_error("could not create dds file");
+    }
+
+    // Version 1 deinterleaves the whole stream at once, version 2 in blocks.
+    bool blocked { bytes > dds_interleave };
+    std::string_view id { blocked ? dds_id2 : dds_id };
+    file.write(id.data(), static_cast<std::streamsize>(id.size()));
+
+    BitFileWriter output { file };
+    {
+        BitWriter header {};
+        header.write(static_cast<std::uint32_t>(skip - 1), 2);
+        header.write(static_cast<std::uint32_t>(strip - 1), 16);
+        auto [header_bytes, header_bits] = header.finish();
+        output.append(header_bytes, header_bits);
+    }
+
+    // Each block holds the strip + 1 bytes preceding it, which are needed for
+    // the prediction at its start.
+    std::size_t history { strip + 1 };
+    std::size_t block_size { blocked ? skip * dds_interleave : bytes };
+    std::vector<unsigned char> raw(skip > 1 ? std::min(block_size, bytes) : 0);
+    std::vector<unsigned char> block(history + std::min(block_size, bytes));
+
+    for (std::size_t block_start { 0 }; block_start < bytes; block_start += block_size) {
+        std::size_t count { std::min(block_size, bytes - block_start) };
+        if (block_start != 0) {
+            std::copy(block.end() - history, block.end(), block.begin());
+        }
+
+        unsigned char* data { block.data() + history };
+        if (skip > 1) {
+            gather(segments, block_start, count, raw.data());
+            unsigned char* ptr { data };
+            for (std::size_t i { 0 }; i < skip; ++i) {
+                for (std::size_t j { i }; j < count; j += skip) {
+                    *ptr++ = raw[j];
+                }
+            }
+        } else {
+            gather(segments, block_start, count, data);
+        }
+        if (count < block_size) {
+            block.resize(history + count);
+        }
+
+        // Each chunk is encoded by a task of the calling scheduler. Waiting
+        // for a task lets a worker encode chunks itself, so the writer may run
+        // on a worker as well.
+        std::size_t chunk_count { (count + dds_chunk_size - 1) / dds_chunk_size };
+        std::vector<EncodedChunk> chunks(chunk_count);
+        std::vector<TaskHandle> tasks {};
+        TaskScheduler& scheduler { TaskScheduler::current() };
+        for (std::size_t chunk { 0 }; chunk < chunk_count; ++chunk) {
+            tasks.push_back(scheduler.submit([&, chunk]() {
+                std::size_t offset { chunk * dds_chunk_size };
+                std::size_t chunk_bytes { std::min(dds_chunk_size, count - offset) };
+                chunks[chunk] = encode_chunk(data + offset, chunk_bytes, block_start + offset, strip);
+            }));
+        }
+
+        // Write the chunks in order, while the later ones are still encoded.
+        try {
+            for (std::size_t chunk { 0 }; chunk < chunk_count; ++chunk) {
+                tasks[chunk].get();
+                output.append(chunks[chunk].bytes, chunks[chunk].bits);
+                chunks[chunk] = EncodedChunk {};
+            }
+        } catch (...) {
+            // The remaining tasks reference the block, so they have to finish first.
+            for (auto& task : tasks) {
+                task.cancel();
+            }
+            for (const auto& task : tasks) {
+                task.wait();
+            }
+            throw;
+        }
+    }
+
+    output.finish();
+}
+
+void write_pvm_volume(const std::filesystem::path& path, const unsigned char* volume,
+    glm::vec<3, std::size_t> extends, std::size_t components, glm::vec3 scale,
+    const PVMMetadata* metadata)
+{
+    if (extends.x < 1 || extends.y < 1 || extends.z < 1 || components < 1) {
+        throw std::invalid_argument("invalid pvm volume extends");
+    }
+
+    std::array<char, 256> header {};
+    int header_size { 0 };
+    if (metadata == nullptr) {
+        if (scale == glm::vec3 { 1.0f }) {
+            header_size = std::snprintf(header.data(), header.size(), "PVM\n%zu %zu %zu\n%zu\n",
+                extends.x, extends.y, extends.z, components);
+        } else {
+            header_size = std::snprintf(header.data(), header.size(), "PVM2\n%zu %zu %zu\n%g %g %g\n%zu\n",
+                extends.x, extends.y, extends.z, scale.x, scale.y, scale.z, components);
+        }
+    } else {
+        header_size = std::snprintf(header.data(), header.size(), "PVM3\n%zu %zu %zu\n%g %g %g\n%zu\n",
+            extends.x, extends.y, extends.z, scale.x, scale.y, scale.z, components);
+    }
+    if (header_size < 0 || static_cast<std::size_t>(header_size) >= header.size()) {
+        throw std::runtime_error("could not format pvm header");
+    }
+
+    std::size_t volume_bytes { pvm_volume_bytes(PVMInfo { extends, components, scale }) };
+    std::vector<DDSSegment> segments {
+        DDSSegment { reinterpret_cast<const unsigned char*>(header.data()), static_cast<std::size_t>(header_size) },
+        DDSSegment { volume, volume_bytes },
+    };
+    if (metadata != nullptr) {
+        // The strings are stored including their terminating null character.
+        for (const std::string* string : { &metadata->description, &metadata->courtesy, &metadata->parameter, &metadata->comment }) {
+            segments.push_back(DDSSegment { reinterpret_cast<const unsigned char*>(string->c_str()), string->size() + 1 });
+        }
+    }
+
+    write_dds_file(path, segments, components, extends.x);
+}
+
+bool read_dds_file(const std::filesystem::path& path, const DDSSink& sink, const DDSProgress& progress)
+{
+    std::ifstream file { path, std::ios::binary | std::ios::ate };
+    if (!file) {
+        throw std::runtime_error("could not open dds file");
+    }
+    std::size_t bytes_total { static_cast<std::size_t>(file.tellg()) };
+    file.seekg(0);
+
+    std::array<char, dds_id.size()> id {};
+    file.read(id.data(), static_cast<std::streamsize>(id.size()));
+    std::string_view file_id { id.data(), static_cast<std::size_t>(file.gcount()) };
+    bool blocked { file_id == dds_id2 };
+
+    if (file_id != dds_id && !blocked) {
+        // Uncompressed stream.
+        file.clear();
+        file.seekg(0);
+        std::vector<unsigned char> block(dds_chunk_size);
+        std::size_t bytes_read { 0 };
+        while (file) {
+            file.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(block.size()));
+            std::size_t count { static_cast<std::size_t>(file.gcount()) };
+            bytes_read += count;
+            if (progress && !progress(bytes_read, bytes_total, bytes_read)) {
+                return false;
+            }
+            if (count != 0 && !sink(std::span<const unsigned char> { block.data(), count })) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    BitFileReader reader { file, id.size(), bytes_total, progress };
+    std::size_t skip { reader.read(2) + std::size_t { 1 } };
+    std::size_t strip { reader.read(16) + std::size_t { 1 } };
+
+    // The stream is decoded into blocks, which start with the strip + 1 bytes
+    // preceding them for the prediction. Version 2 streams are deinterleaved
+    // per block, version 1 streams at once, so they can only be passed on in
+    // pieces if they are not interleaved.
+    std::size_t history { strip + 1 };
+    std::size_t block_size { blocked ? skip * dds_interleave : dds_chunk_size };
+    bool growing { !blocked && skip > 1 };
+    std::vector<unsigned char> block(history + block_size);
+    std::vector<unsigned char> output(skip > 1 ? block_size : 0);
+    TrackedAllocation decoding_memory { MemoryTag::VolumeDecoding, block.size() + output.size() };
+    std::size_t position { history };
+    std::size_t decoded { 0 };
+
+    auto flush = [&]() {
+        std::size_t count { position - history };
+        if (count == 0) {
+            return true;
+        }
+
+        const unsigned char* data { block.data() + history };
+        if (skip > 1) {
+            output.resize(count);
+            interleave(data, count, skip, output.data());
+            data = output.data();
+        }
+        if (!reader.report(decoded) || !sink(std::span<const unsigned char> { data, count })) {
+            return false;
+        }
+
+        std::copy(block.begin() + static_cast<std::ptrdiff_t>(position - history), block.begin() + static_cast<std::ptrdiff_t>(position), block.begin());
+        position = history;
+        return true;
+    };
+
+    int act { 0 };
+    std::uint32_t run;
+    while ((run = reader.read(dds_rl)) != 0) {
+        std::uint32_t bits { static_cast<std::uint32_t>(dds_decode(static_cast<int>(reader.read(3)))) };
+        int offset { (1 << bits) / 2 };
+        for (std::uint32_t i { 0 }; i < run; ++i) {
+            act += static_cast<int>(reader.read(bits)) - offset;
+            if (strip != 1 && decoded > strip) {
+                act += block[position - strip] - block[position - strip - 1];
+            }
+            act &= 0xff;
+
+            block[position++] = static_cast<unsigned char>(act);
+            decoded++;
+
+            if (position == block.size()) {
+                if (growing) {
+                    block.resize(block.size() * 2);
+                    decoding_memory.resize(block.size() + output.size());
+                } else if (!flush()) {
+                    return false;
+                }
+            }
+        }
+        if (reader.stopped()) {
+            return false;
+        }
+    }
+
+    return flush();
+}
+
+bool read_pvm_slices(const std::filesystem::path& path, const std::function<bool(const PVMInfo& info)>& info_sink,
+    const PVMSliceSink& slice_sink, std::size_t z_begin, std::size_t z_end, const DDSProgress& progress)
+{
+    std::string header {};
+    std::vector<unsigned char> slice {};
+    PVMInfo info {};
+    std::size_t slice_size { 0 };
+    std::size_t slice_fill { 0 };
+    std::size_t z { 0 };
+    bool parsed { false };
+    bool finished { false };
+
+    auto sink = [&](std::span<const unsigned char> data) {
+        if (!parsed) {
+            // Only the start of the decoded block may belong to the header.
+            std::size_t previous { header.size() };
+            header.append(reinterpret_cast<const char*>(data.data()), std::min(data.size(), max_pvm_header_size - previous));
+            std::size_t header_size { parse_pvm_header(header, info) };
+            if (header_size == 0) {
+                return true;
+            }
+
+            z_end = std::min(z_end, info.extends.z);
+            if (z_begin >= z_end) {
+                throw std::out_of_range("requested slices out of range");
+            }
+            parsed = true;
+            slice_size = info.extends.x * info.extends.y * info.components;
+            slice.resize(slice_size);
+            if (!info_sink(info)) {
+                return false;
+            }
+            data = data.subspan(header_size - previous);
+        }
+
+        while (!data.empty()) {
+            std::size_t count { std::min(slice_size - slice_fill, data.size()) };
+            if (z >= z_begin) {
+                if (slice_fill == 0 && count == slice_size) {
+                    // Pass complete slices on without copying them.
+                    if (!slice_sink(z, data.first(slice_size))) {
+                        return false;
+                    }
+                } else {
+                    std::copy(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(count), slice.begin() + static_cast<std::ptrdiff_t>(slice_fill));
+                    if (slice_fill + count == slice_size && !slice_sink(z, slice)) {
+                        return false;
+                    }
+                }
+            }
+
+            data = data.subspan(count);
+            slice_fill += count;
+            if (slice_fill == slice_size) {
+                slice_fill = 0;
+                if (++z == z_end) {
+                    finished = true;
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    bool complete { read_dds_file(path, sink, progress) };
+    if (finished) {
+        return true;
+    }
+    if (complete) {
+        throw std::runtime_error(parsed ? "truncated pvm volume" : "invalid pvm header");
+    }
+    return false;
+}
+
+std::size_t pvm_volume_bytes(const PVMInfo& info)
+{
+    std::size_t bytes { info.components };
+    for (std::size_t extend : { info.extends.x, info.extends.y, info.extends.z }) {
+        if (extend != 0 && bytes > std::numeric_limits<std::size_t>::max() / extend) {
+            throw std::overflow_error("pvm volume exceeds the address space");
+        }
+        bytes *= extend;
+    }
+    return bytes;
+}
+
+bool read_pvm_volume(const std::filesystem::path& path, const PVMVolumeAllocator& allocate, const DDSProgress& progress)
+{
+    std::span<unsigned char> voxels {};
+    std::size_t slice_size { 0 };
+
+    auto info_sink = [&](const PVMInfo& info) {
+        std::size_t bytes { pvm_volume_bytes(info) };
+        voxels = allocate(info);
+        if (voxels.size() != bytes) {
+            throw std::invalid_argument("allocated memory does not match the pvm volume");
+        }
+        slice_size = info.extends.x * info.extends.y * info.components;
+        return true;
+    };
+
+    auto slice_sink = [&](std::size_t z, std::span<const unsigned char> slice) {
+        std::copy(slice.begin(), slice.end(), voxels.begin() + static_cast<std::ptrdiff_t>(z * slice_size));
+        return true;
+    };
+
+    return read_pvm_slices(path, info_sink, slice_sink, 0, std::numeric_limits<std::size_t>::max(), progress);
+}
+
+PVMRawVolume read_pvm_volume(const std::filesystem::path& path, const DDSProgress& progress)
+{
+    PVMRawVolume volume { PVMInfo {}, nullptr, TrackedAllocation { MemoryTag::VolumeData } };
+    auto allocate = [&](const PVMInfo& info) {
+        // Every byte is overwritten by the decoder, so the memory is not cleared first.
+        std::size_t bytes { pvm_volume_bytes(info) };
+        volume.info = info;
+        volume.voxels = std::make_unique_for_overwrite<unsigned char[]>(bytes);
+        volume.memory.resize(bytes);
+        return std::span { volume.voxels.get(), bytes };
+    };
+
+    if (!read_pvm_volume(path, allocate, progress)) {
+        throw std::runtime_error("volume load cancelled");
+    }
+    return volume;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <memory_tracker.h>
+
+/**
+ * Contiguous piece of a byte stream.
+ */
+using DDSSegment = std::span<const unsigned char>;
+
+/**
+ * Receives consecutive pieces of a decoded byte stream.
+ * The data is only valid during the call.
+ * @return whether decoding should continue
+ */
+using DDSSink = std::function<bool(std::span<const unsigned char> data)>;
+
+/**
+ * Receives the progress of a decode.
+ * @return whether decoding should continue
+ */
+using DDSProgress = std::function<bool(std::size_t bytes_read, std::size_t bytes_total, std::size_t bytes_decoded)>;
+
+/**
+ * Writes a byte stream as Differential Data Stream (DDS) file.
+ *
+ * The stream is the concatenation of the segments, which is never assembled
+ * in memory. It is compressed in chunks on the workers of the calling
+ * `TaskScheduler`, and each chunk is written as soon as it and its
+ * predecessors are finished. The file can be
+ * read by `readDDSfile` of volumeio.
+ *
+ * @param path path of the written file
+ * @param segments segments of the byte stream
+ * @param skip number of interleaved channels, e.g. the bytes of a voxel
+ * @param strip number of channels in a row, used for predicting from the previous row
+ */
+void write_dds_file(const std::filesystem::path& path, std::span<const DDSSegment> segments,
+    std::size_t skip = 1, std::size_t strip = 1);
+
+/**
+ * Optional strings stored after the voxels of a PVM volume.
+ */
+struct PVMMetadata {
+    std::string description;
+    std::string courtesy;
+    std::string parameter;
+    std::string comment;
+};
+
+/**
+ * Writes a volume as compressed PVM file.
+ *
+ * Equivalent to `writePVMvolume` of volumeio, but the header, the voxels and
+ * the metadata are passed to `write_dds_file` as separate segments, so the
+ * volume is not copied.
+ *
+ * @param path path of the written file
+ * @param volume voxels with interleaved components, x-fastest
+ * @param extends number of voxels along each axis
+ * @param components number of bytes per voxel
+ * @param scale size of a voxel along each axis
+ * @param metadata optional metadata strings
+ */
+void write_pvm_volume(const std::filesystem::path& path, const unsigned char* volume,
+    glm::vec<3, std::size_t> extends, std::size_t components, glm::vec3 scale = glm::vec3 { 1.0f },
+    const PVMMetadata* metadata = nullptr);
+
+/**
+ * Decodes a Differential Data Stream (DDS) file piece by piece.
+ *
+ * Unlike `readDDSfile` of volumeio, the decoded stream is not collected in
+ * memory. It is passed to the sink in pieces of at most a few MiB, in the
+ * order of the stream. Files without a DDS header are passed through
+ * unchanged, like `readPVMvolume` does.
+ *
+ * @param path path of the read file
+ * @param sink receiver of the decoded stream
+ * @param progress optional receiver of the progress
+ * @return whether the whole stream was decoded, false if a callback stopped it
+ */
+bool read_dds_file(const std::filesystem::path& path, const DDSSink& sink, const DDSProgress& progress = {});
+
+/**
+ * Header of a PVM volume.
+ */
+struct PVMInfo {
+    glm::vec<3, std::size_t> extends;
+    std::size_t components;
+    glm::vec3 scale;
+};
+
+/**
+ * Receives a z-slice of a PVM volume, with interleaved components, x-fastest.
+ * The data is only valid during the call.
+ * @return whether decoding should continue
+ */
+using PVMSliceSink = std::function<bool(std::size_t z, std::span<const unsigned char> slice)>;
+
+/**
+ * Decodes the z-slices [z_begin, z_end) of a PVM volume.
+ *
+ * The slices are passed to the sink as soon as they are decoded, so the whole
+ * volume is never materialized. Decoding stops after the last requested
+ * slice, and the slices before the first one are skipped without copying.
+ *
+ * @param path path of the read file
+ * @param info_sink receiver of the header, called before the first slice
+ * @param slice_sink receiver of the slices
+ * @param z_begin first requested slice
+ * @param z_end end of the requested slices, clamped to the depth of the volume
+ * @param progress optional receiver of the progress
+ * @return whether all requested slices were decoded, false if a callback stopped it
+ */
+bool read_pvm_slices(const std::filesystem::path& path, const std::function<bool(const PVMInfo& info)>& info_sink,
+    const PVMSliceSink& slice_sink, std::size_t z_begin = 0, std::size_t z_end = std::numeric_limits<std::size_t>::max(),
+    const DDSProgress& progress = {});
+
+/**
+ * Returns the number of bytes of the voxels of a PVM volume.
+ * Throws `std::overflow_error` if the size can not be addressed.
+ * @param info header of the volume
+ * @return size of the voxels in bytes
+ */
+std::size_t pvm_volume_bytes(const PVMInfo& info);
+
+/**
+ * Provides the memory a PVM volume is decoded into.
+ * @return memory of exactly `pvm_volume_bytes(info)` bytes
+ */
+using PVMVolumeAllocator = std::function<std::span<unsigned char>(const PVMInfo& info)>;
+
+/**
+ * Decodes all voxels of a PVM volume into memory provided by the caller.
+ *
+ * The file is read and decoded in pieces of a few MiB, which are copied to
+ * their place in the provided memory, so apart from it no full-size buffer
+ * is allocated.
+ *
+ * @param path path of the read file
+ * @param allocate provider of the memory, called once after the header is read
+ * @param progress optional receiver of the progress
+ * @return whether the volume was decoded, false if the progress callback stopped it
+ */
+bool read_pvm_volume(const std::filesystem::path& path, const PVMVolumeAllocator& allocate,
+    const DDSProgress& progress = {});
+
+/**
+ * Raw voxels of a PVM volume, with interleaved components, x-fastest.
+ */
+struct PVMRawVolume {
+    PVMInfo info;
+    std::unique_ptr<unsigned char[]> voxels;
+    TrackedAllocation memory;
+};
+
+/**
+ * Reads the raw voxels of a PVM volume.
+ *
+ * Replaces `readPVMvolume` of volumeio, which counts bytes in 32 bits and
+ * exits the process on errors. Sizes are only limited by the address
+ * space, errors are thrown as exceptions, and the voxels are the only
+ * full-size allocation.
+ *
+ * @param path path of the read file
+ * @param progress optional receiver of the progress, stopping it throws
+ * @return header and voxels of the volume
+ */
+PVMRawVolume read_pvm_volume(const std::filesystem::path& path, const DDSProgress& progress = {});
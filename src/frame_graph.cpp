@@ -0,0 +1,101 @@
+#include <frame_graph.h>
+
+#include <stdexcept>
+#include <utility>
+
+FrameGraph::FrameGraph()
+    : m_passes {}
+    , m_color_attachments { wgpu::RenderPassColorAttachment { wgpu::Default } }
+    , m_render_pass_desc { wgpu::Default }
+{
+    this->m_color_attachments[0].storeOp = wgpu::StoreOp::Store;
+    this->m_render_pass_desc.colorAttachmentCount = this->m_color_attachments.size();
+    this->m_render_pass_desc.depthStencilAttachment = nullptr;
+}
+
+void FrameGraph::add_render_pass(const char* name, const wgpu::TextureView& target, RenderFunction record,
+    std::optional<wgpu::Color> clear_color)
+{
+    if (!target) {
+        throw std::invalid_argument("render pass without a target");
+    }
+    this->m_passes.push_back(Pass { name, target, clear_color, std::move(record), nullptr });
+}
+
+void FrameGraph::add_encoder_pass(const char* name, EncoderFunction record)
+{
+    this->m_passes.push_back(Pass { name, nullptr, std::nullopt, nullptr, std::move(record) });
+}
+
+std::size_t FrameGraph::record(wgpu::CommandEncoder& encoder)
+{
+    // The passes of a failed frame are dropped as well, so they are not replayed next frame.
+    std::size_t render_passes { 0 };
+    try {
+        render_passes = this->record_passes(encoder);
+    } catch (...) {
+        this->m_color_attachments[0].view = nullptr;
+        this->m_passes.clear();
+        throw;
+    }
+
+    this->m_color_attachments[0].view = nullptr;
+    this->m_passes.clear();
+    return render_passes;
+}
+
+std::size_t FrameGraph::record_passes(wgpu::CommandEncoder& encoder)
+{
+    std::size_t render_passes { 0 };
+    std::size_t i { 0 };
+    while (i < this->m_passes.size()) {
+        Pass& first { this->m_passes[i] };
+        if (first.encode) {
+            first.encode(encoder);
+            i++;
+            continue;
+        }
+
+        // Find the run of render passes that can share the first one's render pass.
+        std::size_t end { i + 1 };
+        while (end < this->m_passes.size()) {
+            const Pass& pass { this->m_passes[end] };
+            if (pass.encode || pass.clear_color || static_cast<WGPUTextureView>(pass.target) != static_cast<WGPUTextureView>(first.target)) {
+                break;
+            }
+            end++;
+        }
+
+        auto& attachment = this->m_color_attachments[0];
+        attachment.view = first.target;
+        attachment.loadOp = first.clear_color ? wgpu::LoadOp::Clear : wgpu::LoadOp::Load;
+        attachment.clearValue = first.clear_color.value_or(wgpu::Color { 0.0, 0.0, 0.0, 1.0 });
+        this->m_render_pass_desc.label = first.name;
+        // Set on every use, the graph may have been moved since the last frame.
+        this->m_render_pass_desc.colorAttachments = this->m_color_attachments.data();
+
+        auto pass_encoder = encoder.beginRenderPass(this->m_render_pass_desc);
+        if (!pass_encoder) {
+            throw std::runtime_error("could not begin a render pass");
+        }
+        try {
+            for (; i < end; ++i) {
+                this->m_passes[i].render(pass_encoder);
+            }
+        } catch (...) {
+            // End the open pass, so the caller can still release the command encoder.
+            pass_encoder.end();
+            pass_encoder.release();
+            throw;
+        }
+        pass_encoder.end();
+        pass_encoder.release();
+        render_passes++;
+    }
+    return render_passes;
+}
+
+std::size_t FrameGraph::pass_count() const
+{
+    return this->m_passes.size();
+}
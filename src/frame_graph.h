@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+/**
+ * Ordered list of the passes of a frame.
+ *
+ * The passes are registered every frame and recorded at its end.
+ * Consecutive render passes drawing into the same color target are merged
+ * into a single render pass, so the target is loaded and stored only once,
+ * e.g. for the application draw and the Dear ImGui overlay. A pass that
+ * clears its target, or any encoder pass in between, starts a new render
+ * pass. The descriptors used for recording are kept between frames.
+ */
+class FrameGraph {
+public:
+    using RenderFunction = std::function<void(wgpu::RenderPassEncoder&)>;
+    using EncoderFunction = std::function<void(wgpu::CommandEncoder&)>;
+
+    FrameGraph();
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph(FrameGraph&&) = default;
+    ~FrameGraph() = default;
+
+    FrameGraph& operator=(const FrameGraph&) = delete;
+    FrameGraph& operator=(FrameGraph&&) = default;
+
+    /**
+     * Adds a pass drawing into a color target.
+     * @param name name of the pass, used as label of the render pass
+     * @param target color target
+     * @param record function recording the draw commands
+     * @param clear_color color the target is cleared with, or nothing to keep its content
+     */
+    void add_render_pass(const char* name, const wgpu::TextureView& target, RenderFunction record,
+        std::optional<wgpu::Color> clear_color = std::nullopt);
+
+    /**
+     * Adds a pass recording directly into the command encoder, e.g. compute passes or copies.
+     * @param name name of the pass
+     * @param record function recording the commands
+     */
+    void add_encoder_pass(const char* name, EncoderFunction record);
+
+    /**
+     * Records all passes of the frame and removes them.
+     * The passes are removed and an open render pass is ended even if recording throws.
+     * @param encoder command encoder of the frame
+     * @return number of render passes begun
+     */
+    std::size_t record(wgpu::CommandEncoder& encoder);
+
+    /**
+     * Returns the number of registered passes.
+     * @return number of passes
+     */
+    std::size_t pass_count() const;
+
+private:
+    struct Pass {
+        const char* name;
+        wgpu::TextureView target;
+        std::optional<wgpu::Color> clear_color;
+        RenderFunction render;
+        EncoderFunction encode;
+    };
+
+    std::size_t record_passes(wgpu::CommandEncoder& encoder);
+
+    std::vector<Pass> m_passes;
+    std::array<wgpu::RenderPassColorAttachment, 1> m_color_attachments;
+    wgpu::RenderPassDescriptor m_render_pass_desc;
+};
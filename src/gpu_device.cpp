@@ -0,0 +1,77 @@
+#include <gpu_device.h>
+
+#include <iostream>
+
+wgpu::Adapter request_adapter(wgpu::Instance& instance, wgpu::Surface& surface, bool software)
+{
+    wgpu::RequestAdapterOptions adapter_opts { wgpu::Default };
+    adapter_opts.compatibleSurface = surface;
+    adapter_opts.forceFallbackAdapter = software;
+    return instance.requestAdapter(adapter_opts);
+}
+
+wgpu::Device create_device(wgpu::Adapter& adapter, const char* label, const char* queue_label)
+{
+    // Default limits from https://www.w3.org/TR/webgpu/#limits
+    wgpu::RequiredLimits device_limits { wgpu::Default };
+    device_limits.limits.maxTextureDimension1D = 8192;
+    device_limits.limits.maxTextureDimension2D = 8192;
+    device_limits.limits.maxTextureDimension3D = 2048;
+    device_limits.limits.maxTextureArrayLayers = 256;
+    device_limits.limits.maxBindGroups = 4;
+    device_limits.limits.maxBindGroupsPlusVertexBuffers = 24;
+    device_limits.limits.maxBindingsPerBindGroup = 1000;
+    device_limits.limits.maxDynamicUniformBuffersPerPipelineLayout = 8;
+    device_limits.limits.maxDynamicStorageBuffersPerPipelineLayout = 4;
+    device_limits.limits.maxSampledTexturesPerShaderStage = 16;
+    device_limits.limits.maxSamplersPerShaderStage = 16;
+    device_limits.limits.maxStorageBuffersPerShaderStage = 8;
+    device_limits.limits.maxStorageTexturesPerShaderStage = 4;
+    device_limits.limits.maxUniformBuffersPerShaderStage = 12;
+    device_limits.limits.maxUniformBufferBindingSize = 64 << 10;
+    device_limits.limits.maxStorageBufferBindingSize = 128 << 20;
+    device_limits.limits.minUniformBufferOffsetAlignment = 256;
+    device_limits.limits.minStorageBufferOffsetAlignment = 256;
+    device_limits.limits.maxVertexBuffers = 8;
+    device_limits.limits.maxBufferSize = 256 << 20;
+    device_limits.limits.maxVertexAttributes = 16;
+    device_limits.limits.maxVertexBufferArrayStride = 2048;
+    device_limits.limits.maxInterStageShaderComponents = 60;
+    device_limits.limits.maxInterStageShaderVariables = 16;
+    device_limits.limits.maxColorAttachments = 8;
+    device_limits.limits.maxColorAttachmentBytesPerSample = 32;
+    device_limits.limits.maxComputeWorkgroupStorageSize = 16 << 10;
+    device_limits.limits.maxComputeInvocationsPerWorkgroup = 256;
+    device_limits.limits.maxComputeWorkgroupSizeX = 256;
+    device_limits.limits.maxComputeWorkgroupSizeY = 256;
+    device_limits.limits.maxComputeWorkgroupSizeZ = 64;
+    device_limits.limits.maxComputeWorkgroupsPerDimension = 65535;
+
+    auto on_device_error = [](WGPUErrorType type, const char* message, void*) {
+        std::cerr << "Uncaptured device error: type " << type;
+        if (message) {
+            std::cerr << " (" << message << ")";
+        }
+        std::cerr << std::endl;
+    };
+
+    wgpu::DeviceDescriptor device_desc { wgpu::Default };
+    device_desc.label = label;
+    device_desc.requiredLimits = &device_limits;
+    device_desc.defaultQueue.label = queue_label;
+    device_desc.uncapturedErrorCallbackInfo.callback = on_device_error;
+    return adapter.requestDevice(device_desc);
+}
+
+wgpu::Device create_headless_device(wgpu::Instance& instance, bool software)
+{
+    wgpu::Surface surface { nullptr };
+    auto adapter = request_adapter(instance, surface, software);
+    if (!adapter) {
+        return nullptr;
+    }
+
+    auto device = create_device(adapter, "Headless Device", "Default headless queue");
+    adapter.release();
+    return device;
+}
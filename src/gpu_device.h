@@ -0,0 +1,30 @@
+#pragma once
+
+#include <webgpu/webgpu.hpp>
+
+/**
+ * Requests an adapter.
+ * @param instance instance creating the adapter
+ * @param surface surface the adapter has to present to, or nullptr without a surface
+ * @param software request a software (fallback) adapter
+ * @return adapter, or nullptr if no adapter is available
+ */
+wgpu::Adapter request_adapter(wgpu::Instance& instance, wgpu::Surface& surface, bool software);
+
+/**
+ * Creates a device with the limits required by the application.
+ * Uncaptured device errors are written to `std::cerr`.
+ * @param adapter adapter creating the device
+ * @param label label of the device
+ * @param queue_label label of the default queue
+ * @return device, or nullptr if the limits are not supported
+ */
+wgpu::Device create_device(wgpu::Adapter& adapter, const char* label, const char* queue_label);
+
+/**
+ * Creates a device without a surface, e.g. for compute work or verification.
+ * @param instance instance creating the device
+ * @param software request a software (fallback) adapter
+ * @return device, or nullptr if no adapter is available
+ */
+wgpu::Device create_headless_device(wgpu::Instance& instance, bool software);
@@ -0,0 +1,630 @@
+#include <gpu_normalizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <webgpu/wgpu.h>
+
+namespace {
+
+constexpr std::uint32_t reduce_workgroup_size { 256 };
+constexpr std::uint32_t normalize_workgroup_size { 4 };
+constexpr std::uint32_t max_workgroups { 65535 };
+
+// Minimum/maximum of up to 4 components, as pairs of atomics.
+constexpr std::size_t range_words { 8 };
+
+constexpr const char* shader_params = R"(
+    struct Params {
+        extent: vec3<u32>,
+        components: u32,
+        bytes: u32,
+        z_offset: u32,
+        word_stride: u32,
+        padding: u32,
+    }
+)";
+
+// Each invocation reduces a strided set of 4-byte words. As the number of
+// components divides 4, byte i of every word belongs to component i % components.
+constexpr const char* reduce_shader = R"(
+    @group(0) @binding(0) var<storage, read> voxels: array<u32>;
+    @group(0) @binding(1) var<storage, read_write> ranges: array<atomic<u32>, 8>;
+    @group(0) @binding(2) var<uniform> params: Params;
+
+    var<workgroup> local_min: array<vec4<u32>, 256>;
+    var<workgroup> local_max: array<vec4<u32>, 256>;
+
+    @compute @workgroup_size(256)
+    fn reduce(@builtin(global_invocation_id) global_id: vec3<u32>,
+        @builtin(local_invocation_index) local_index: u32) {
+        var minimum = vec4<u32>(255u);
+        var maximum = vec4<u32>(0u);
+        let words = (params.bytes + 3u) / 4u;
+        for (var word = global_id.x; word < words; word += params.word_stride) {
+            let value = voxels[word];
+            for (var i = 0u; i < 4u; i++) {
+                if (word * 4u + i < params.bytes) {
+                    let byte = (value >> (8u * i)) & 0xffu;
+                    minimum[i] = min(minimum[i], byte);
+                    maximum[i] = max(maximum[i], byte);
+                }
+            }
+        }
+
+        local_min[local_index] = minimum;
+        local_max[local_index] = maximum;
+        workgroupBarrier();
+        for (var stride = 128u; stride > 0u; stride >>= 1u) {
+            if (local_index < stride) {
+                local_min[local_index] = min(local_min[local_index], local_min[local_index + stride]);
+                local_max[local_index] = max(local_max[local_index], local_max[local_index + stride]);
+            }
+            workgroupBarrier();
+        }
+
+        if (local_index == 0u) {
+            for (var i = 0u; i < 4u; i++) {
+                let component = i % params.components;
+                atomicMin(&ranges[2u * component], local_min[0][i]);
+                atomicMax(&ranges[2u * component + 1u], local_max[0][i]);
+            }
+        }
+    }
+)";
+
+// Same arithmetic as the normalization of `PVMVolume`. The components stay in
+// their stored (reversed) order, like in `VolumeTexture::upload`.
+constexpr const char* normalize_shader = R"(
+    @group(0) @binding(0) var<storage, read> voxels: array<u32>;
+    @group(0) @binding(1) var<storage, read> ranges: array<u32, 8>;
+    @group(0) @binding(2) var<uniform> params: Params;
+    @group(0) @binding(3) var volume: texture_storage_3d<{format}, write>;
+
+    fn voxel_byte(index: u32) -> f32 {
+        return f32((voxels[index / 4u] >> (8u * (index % 4u))) & 0xffu);
+    }
+
+    @compute @workgroup_size(4, 4, 4)
+    fn normalize(@builtin(global_invocation_id) id: vec3<u32>) {
+        if (any(id >= params.extent)) {
+            return;
+        }
+
+        let voxel = (id.x + id.y * params.extent.x + id.z * params.extent.x * params.extent.y) * params.components;
+        var value = vec4<f32>(0.0);
+        for (var i = 0u; i < params.components; i++) {
+            let minimum = f32(ranges[2u * i]);
+            let maximum = f32(ranges[2u * i + 1u]);
+            value[i] = (voxel_byte(voxel + i) - minimum) / (maximum - minimum);
+        }
+        textureStore(volume, vec3<u32>(id.x, id.y, id.z + params.z_offset), value);
+    }
+)";
+
+struct ShaderParams {
+    std::uint32_t extent[3];
+    std::uint32_t components;
+    std::uint32_t bytes;
+    std::uint32_t z_offset;
+    std::uint32_t word_stride;
+    std::uint32_t padding;
+};
+
+std::size_t pipeline_index(std::size_t components)
+{
+    switch (components) {
+    case 1:
+        return 0;
+    case 2:
+        return 1;
+    case 4:
+        return 2;
+    default:
+        throw std::invalid_argument("no texture format for the number of components");
+    }
+}
+
+std::size_t align_up(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+GPURawVolume::GPURawVolume()
+    : m_slabs {}
+    , m_ranges { nullptr }
+    , m_info {}
+    , m_memory { MemoryTag::GPUBuffers }
+{
+}
+
+GPURawVolume::GPURawVolume(GPURawVolume&& volume)
+    : m_slabs { std::move(volume.m_slabs) }
+    , m_ranges { std::exchange(volume.m_ranges, nullptr) }
+    , m_info { volume.m_info }
+    , m_memory { std::move(volume.m_memory) }
+{
+    volume.m_slabs.clear();
+}
+
+GPURawVolume::~GPURawVolume()
+{
+    this->release();
+}
+
+GPURawVolume& GPURawVolume::operator=(GPURawVolume&& volume)
+{
+    if (this != &volume) {
+        this->release();
+        this->m_slabs = std::move(volume.m_slabs);
+        this->m_ranges = std::exchange(volume.m_ranges, nullptr);
+        this->m_info = volume.m_info;
+        this->m_memory = std::move(volume.m_memory);
+        volume.m_slabs.clear();
+    }
+    return *this;
+}
+
+const PVMInfo& GPURawVolume::info() const
+{
+    return this->m_info;
+}
+
+std::size_t GPURawVolume::byte_size() const
+{
+    std::size_t bytes { 0 };
+    for (const auto& slab : this->m_slabs) {
+        bytes += slab.bytes;
+    }
+    return bytes;
+}
+
+void GPURawVolume::release()
+{
+    for (auto& slab : this->m_slabs) {
+        if (slab.voxels) {
+            slab.voxels.destroy();
+            slab.voxels.release();
+        }
+    }
+    this->m_slabs.clear();
+    this->m_memory.resize(0);
+
+    if (this->m_ranges) {
+        this->m_ranges.destroy();
+        this->m_ranges.release();
+        this->m_ranges = nullptr;
+    }
+}
+
+GPUVolumeNormalizer::GPUVolumeNormalizer(wgpu::Device& device)
+    : m_device { device }
+    , m_reduce_pipeline { nullptr }
+    , m_normalize_pipelines { nullptr, nullptr, nullptr }
+    , m_max_slab_bytes { 0 }
+    , m_texture_limits { VolumeDeviceLimits::query(device) }
+{
+    wgpu::SupportedLimits limits { wgpu::Default };
+    if (!this->m_device.getLimits(&limits)) {
+        throw std::runtime_error("could not query the device limits");
+    }
+    this->m_max_slab_bytes = static_cast<std::size_t>(std::min(limits.limits.maxStorageBufferBindingSize, limits.limits.maxBufferSize));
+    this->m_max_slab_bytes -= this->m_max_slab_bytes % 4;
+
+    this->m_reduce_pipeline = this->create_pipeline(std::string { shader_params } + reduce_shader, "reduce");
+
+    const auto formats = std::array { "r32float", "rg32float", "rgba32float" };
+    for (std::size_t i { 0 }; i < formats.size(); ++i) {
+        std::string code { normalize_shader };
+        std::string placeholder { "{format}" };
+        code.replace(code.find(placeholder), placeholder.size(), formats[i]);
+        this->m_normalize_pipelines[i] = this->create_pipeline(shader_params + code, "normalize");
+    }
+}
+
+GPUVolumeNormalizer::~GPUVolumeNormalizer()
+{
+    for (auto& pipeline : this->m_normalize_pipelines) {
+        if (pipeline) {
+            pipeline.release();
+        }
+    }
+
+    if (this->m_reduce_pipeline) {
+        this->m_reduce_pipeline.release();
+    }
+}
+
+GPURawVolume GPUVolumeNormalizer::upload(const std::filesystem::path& path, PVMLoadProgress* progress)
+{
+    GPURawVolume volume {};
+    std::size_t slice_size { 0 };
+    std::size_t slab_depth { 0 };
+    unsigned char* mapped { nullptr };
+
+    auto finish_slab = [&]() {
+        if (mapped) {
+            volume.m_slabs.back().voxels.unmap();
+            mapped = nullptr;
+        }
+    };
+
+    auto begin_slab = [&](std::size_t z) {
+        finish_slab();
+
+        GPURawVolume::Slab slab { nullptr, z, std::min(slab_depth, volume.m_info.extends.z - z), 0 };
+        slab.bytes = slab.depth * slice_size;
+
+        wgpu::BufferDescriptor desc { wgpu::Default };
+        desc.label = "Raw volume slab";
+        desc.usage = wgpu::BufferUsage::Storage;
+        desc.size = align_up(slab.bytes, 4);
+        desc.mappedAtCreation = true;
+        slab.voxels = this->m_device.createBuffer(desc);
+        if (!slab.voxels) {
+            throw std::runtime_error("could not create the raw volume buffer");
+        }
+        volume.m_slabs.push_back(slab);
+        volume.m_memory.resize(volume.m_memory.bytes() + desc.size);
+
+        mapped = static_cast<unsigned char*>(slab.voxels.getMappedRange(0, desc.size));
+        if (!mapped) {
+            throw std::runtime_error("could not map the raw volume buffer");
+        }
+        std::memset(mapped + slab.bytes, 0, desc.size - slab.bytes);
+    };
+
+    auto info_sink = [&](const PVMInfo& info) {
+        // Checked before any buffer is allocated, the normalized volume has to fit into a single texture.
+        if (!VolumeTexture::supported(info.components)) {
+            throw std::runtime_error("unsupported number of components");
+        }
+        if (!this->m_texture_limits.fits(info.extends, info.components)) {
+            throw std::runtime_error("volume exceeds the device limits, normalize it on the CPU instead");
+        }
+
+        volume.m_info = info;
+        slice_size = info.extends.x * info.extends.y * info.components;
+        if (slice_size > this->m_max_slab_bytes) {
+            throw std::runtime_error("volume slice exceeds the storage buffer limit");
+        }
+        slab_depth = this->m_max_slab_bytes / slice_size;
+
+        if (progress) {
+            progress->voxels_total = info.extends.x * info.extends.y * info.extends.z;
+            progress->voxels_normalized = 0;
+        }
+        return !(progress && progress->cancel_requested);
+    };
+
+    // The slices are decoded straight into the mapped slab buffers.
+    auto slice_sink = [&](std::size_t z, std::span<const unsigned char> slice) {
+        if (volume.m_slabs.empty() || z >= volume.m_slabs.back().z_offset + volume.m_slabs.back().depth) {
+            begin_slab(z);
+        }
+        const auto& slab = volume.m_slabs.back();
+        std::copy(slice.begin(), slice.end(), mapped + (z - slab.z_offset) * slice_size);
+
+        if (progress) {
+            progress->bytes_decoded += slice.size();
+        }
+        return !(progress && progress->cancel_requested);
+    };
+
+    auto report_progress = [&](std::size_t bytes_read, std::size_t bytes_total, std::size_t) {
+        if (progress) {
+            progress->bytes_total = bytes_total;
+            progress->bytes_read = bytes_read;
+        }
+        return !(progress && progress->cancel_requested);
+    };
+
+    bool complete { read_pvm_slices(path, info_sink, slice_sink, 0, std::numeric_limits<std::size_t>::max(), report_progress) };
+    finish_slab();
+    if (progress && progress->cancel_requested) {
+        throw std::runtime_error("volume load cancelled");
+    }
+    if (!complete) {
+        throw std::runtime_error("could not read pvm volume");
+    }
+    return volume;
+}
+
+std::unique_ptr<VolumeTexture> GPUVolumeNormalizer::normalize(GPURawVolume& volume)
+{
+    const PVMInfo& info { volume.m_info };
+    auto& normalize_pipeline = this->m_normalize_pipelines[pipeline_index(info.components)];
+    auto texture = std::make_unique<VolumeTexture>(this->m_device, info.extends, info.components);
+    auto queue = this->m_device.getQueue();
+
+    if (!volume.m_ranges) {
+        wgpu::BufferDescriptor desc { wgpu::Default };
+        desc.label = "Volume component ranges";
+        desc.usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst;
+        desc.size = range_words * sizeof(std::uint32_t);
+        volume.m_ranges = this->m_device.createBuffer(desc);
+        if (!volume.m_ranges) {
+            throw std::runtime_error("could not create the range buffer");
+        }
+    }
+    std::array<std::uint32_t, range_words> initial_ranges {};
+    for (std::size_t i { 0 }; i < range_words; i += 2) {
+        initial_ranges[i] = std::numeric_limits<std::uint32_t>::max();
+        initial_ranges[i + 1] = 0;
+    }
+    queue.writeBuffer(volume.m_ranges, 0, initial_ranges.data(), sizeof(initial_ranges));
+
+    std::vector<wgpu::Buffer> param_buffers {};
+    std::vector<wgpu::BindGroup> reduce_groups {};
+    std::vector<wgpu::BindGroup> normalize_groups {};
+    auto reduce_layout = this->m_reduce_pipeline.getBindGroupLayout(0);
+    auto normalize_layout = normalize_pipeline.getBindGroupLayout(0);
+    for (const auto& slab : volume.m_slabs) {
+        std::size_t words { align_up(slab.bytes, 4) / 4 };
+        std::uint32_t workgroups { static_cast<std::uint32_t>(std::min<std::size_t>(align_up(words, reduce_workgroup_size) / reduce_workgroup_size, max_workgroups)) };
+
+        ShaderParams params {};
+        params.extent[0] = static_cast<std::uint32_t>(info.extends.x);
+        params.extent[1] = static_cast<std::uint32_t>(info.extends.y);
+        params.extent[2] = static_cast<std::uint32_t>(slab.depth);
+        params.components = static_cast<std::uint32_t>(info.components);
+        params.bytes = static_cast<std::uint32_t>(slab.bytes);
+        params.z_offset = static_cast<std::uint32_t>(slab.z_offset);
+        params.word_stride = workgroups * reduce_workgroup_size;
+
+        wgpu::BufferDescriptor desc { wgpu::Default };
+        desc.label = "Volume normalization parameters";
+        desc.usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
+        desc.size = sizeof(ShaderParams);
+        auto param_buffer = this->m_device.createBuffer(desc);
+        queue.writeBuffer(param_buffer, 0, &params, sizeof(params));
+        param_buffers.push_back(param_buffer);
+
+        auto entries = std::array { wgpu::BindGroupEntry { wgpu::Default }, wgpu::BindGroupEntry { wgpu::Default },
+            wgpu::BindGroupEntry { wgpu::Default }, wgpu::BindGroupEntry { wgpu::Default } };
+        entries[0].binding = 0;
+        entries[0].buffer = slab.voxels;
+        entries[0].size = align_up(slab.bytes, 4);
+        entries[1].binding = 1;
+        entries[1].buffer = volume.m_ranges;
+        entries[1].size = range_words * sizeof(std::uint32_t);
+        entries[2].binding = 2;
+        entries[2].buffer = param_buffer;
+        entries[2].size = sizeof(ShaderParams);
+        entries[3].binding = 3;
+        entries[3].textureView = texture->view();
+
+        wgpu::BindGroupDescriptor group_desc { wgpu::Default };
+        group_desc.layout = reduce_layout;
+        group_desc.entryCount = 3;
+        group_desc.entries = entries.data();
+        reduce_groups.push_back(this->m_device.createBindGroup(group_desc));
+
+        group_desc.layout = normalize_layout;
+        group_desc.entryCount = entries.size();
+        normalize_groups.push_back(this->m_device.createBindGroup(group_desc));
+    }
+
+    // All slabs have to be reduced before any of them is normalized.
+    auto encoder = this->m_device.createCommandEncoder({ wgpu::Default });
+    auto pass = encoder.beginComputePass({ wgpu::Default });
+    pass.setPipeline(this->m_reduce_pipeline);
+    for (std::size_t i { 0 }; i < volume.m_slabs.size(); ++i) {
+        std::size_t words { align_up(volume.m_slabs[i].bytes, 4) / 4 };
+        std::uint32_t workgroups { static_cast<std::uint32_t>(std::min<std::size_t>(align_up(words, reduce_workgroup_size) / reduce_workgroup_size, max_workgroups)) };
+        pass.setBindGroup(0, reduce_groups[i], 0, nullptr);
+        pass.dispatchWorkgroups(workgroups, 1, 1);
+    }
+    pass.setPipeline(normalize_pipeline);
+    for (std::size_t i { 0 }; i < volume.m_slabs.size(); ++i) {
+        const auto& slab = volume.m_slabs[i];
+        pass.setBindGroup(0, normalize_groups[i], 0, nullptr);
+        pass.dispatchWorkgroups(
+            static_cast<std::uint32_t>(align_up(info.extends.x, normalize_workgroup_size) / normalize_workgroup_size),
+            static_cast<std::uint32_t>(align_up(info.extends.y, normalize_workgroup_size) / normalize_workgroup_size),
+            static_cast<std::uint32_t>(align_up(slab.depth, normalize_workgroup_size) / normalize_workgroup_size));
+    }
+    pass.end();
+
+    auto command_buffer = encoder.finish({ wgpu::Default });
+    queue.submit(command_buffer);
+
+    command_buffer.release();
+    pass.release();
+    encoder.release();
+    for (auto& group : normalize_groups) {
+        group.release();
+    }
+    for (auto& group : reduce_groups) {
+        group.release();
+    }
+    for (auto& buffer : param_buffers) {
+        buffer.release();
+    }
+    normalize_layout.release();
+    reduce_layout.release();
+    queue.release();
+
+    return texture;
+}
+
+std::vector<glm::vec2> GPUVolumeNormalizer::component_ranges(const GPURawVolume& volume)
+{
+    if (!volume.m_ranges) {
+        throw std::logic_error("volume was not normalized");
+    }
+
+    std::size_t size { range_words * sizeof(std::uint32_t) };
+    wgpu::BufferDescriptor desc { wgpu::Default };
+    desc.label = "Volume component ranges readback";
+    desc.usage = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst;
+    desc.size = size;
+    auto readback = this->m_device.createBuffer(desc);
+
+    auto queue = this->m_device.getQueue();
+    auto encoder = this->m_device.createCommandEncoder({ wgpu::Default });
+    encoder.copyBufferToBuffer(volume.m_ranges, 0, readback, 0, size);
+    auto command_buffer = encoder.finish({ wgpu::Default });
+    queue.submit(command_buffer);
+    command_buffer.release();
+    encoder.release();
+    queue.release();
+
+    this->wait_for_map(readback, size);
+    std::array<std::uint32_t, range_words> words {};
+    std::memcpy(words.data(), readback.getConstMappedRange(0, size), size);
+    readback.unmap();
+    readback.destroy();
+    readback.release();
+
+    // The ranges are indexed in stored order, which is the reverse of the component order.
+    std::size_t components { volume.m_info.components };
+    std::vector<glm::vec2> ranges(components);
+    for (std::size_t i { 0 }; i < components; ++i) {
+        std::size_t stored { components - 1 - i };
+        ranges[i] = glm::vec2 { static_cast<float>(words[2 * stored]), static_cast<float>(words[2 * stored + 1]) };
+    }
+    return ranges;
+}
+
+bool GPUVolumeNormalizer::verify(const std::filesystem::path& path, std::ostream& log, float tolerance)
+{
+    PVMVolume reference { path };
+    if (!VolumeTexture::supported(reference.components())) {
+        log << "Unsupported number of components: " << reference.components() << std::endl;
+        return false;
+    }
+
+    GPURawVolume volume { this->upload(path) };
+    auto texture = this->normalize(volume);
+    auto ranges = this->component_ranges(volume);
+
+    bool matches { true };
+    std::size_t components { reference.components() };
+    std::vector<bool> constant(components, false);
+    for (std::size_t i { 0 }; i < components; ++i) {
+        glm::vec2 expected { reference.component_range(i) };
+        if (ranges[i] != expected) {
+            log << "Component " << i << ": range [" << ranges[i].x << ", " << ranges[i].y
+                << "], expected [" << expected.x << ", " << expected.y << "]" << std::endl;
+            matches = false;
+        }
+        constant[components - 1 - i] = expected.x == expected.y;
+    }
+
+    // Read the texture back slice by slice; rows are padded to 256 bytes.
+    glm::vec<3, std::size_t> extends { reference.extends() };
+    std::size_t row_size { extends.x * components * sizeof(float) };
+    std::size_t row_pitch { align_up(row_size, 256) };
+    std::size_t slice_bytes { row_pitch * extends.y };
+
+    wgpu::BufferDescriptor desc { wgpu::Default };
+    desc.label = "Volume texture readback";
+    desc.usage = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst;
+    desc.size = slice_bytes;
+    auto readback = this->m_device.createBuffer(desc);
+    auto queue = this->m_device.getQueue();
+
+    float max_error { 0.0f };
+    std::size_t mismatches { 0 };
+    std::vector<float> row(extends.x * components);
+    for (std::size_t z { 0 }; z < extends.z; ++z) {
+        wgpu::ImageCopyTexture source { wgpu::Default };
+        source.texture = texture->texture();
+        source.mipLevel = 0;
+        source.origin.x = 0;
+        source.origin.y = 0;
+        source.origin.z = static_cast<std::uint32_t>(z);
+        source.aspect = wgpu::TextureAspect::All;
+
+        wgpu::ImageCopyBuffer destination { wgpu::Default };
+        destination.buffer = readback;
+        destination.layout.offset = 0;
+        destination.layout.bytesPerRow = static_cast<std::uint32_t>(row_pitch);
+        destination.layout.rowsPerImage = static_cast<std::uint32_t>(extends.y);
+
+        wgpu::Extent3D size { wgpu::Default };
+        size.width = static_cast<std::uint32_t>(extends.x);
+        size.height = static_cast<std::uint32_t>(extends.y);
+        size.depthOrArrayLayers = 1;
+
+        auto encoder = this->m_device.createCommandEncoder({ wgpu::Default });
+        encoder.copyTextureToBuffer(source, destination, size);
+        auto command_buffer = encoder.finish({ wgpu::Default });
+        queue.submit(command_buffer);
+        command_buffer.release();
+        encoder.release();
+
+        this->wait_for_map(readback, slice_bytes);
+        const auto* mapped = static_cast<const unsigned char*>(readback.getConstMappedRange(0, slice_bytes));
+        const float* expected { reference.data() + z * extends.x * extends.y * components };
+        for (std::size_t y { 0 }; y < extends.y; ++y) {
+            std::memcpy(row.data(), mapped + y * row_pitch, row_size);
+            for (std::size_t i { 0 }; i < row.size(); ++i) {
+                if (constant[i % components]) {
+                    continue;
+                }
+                float error { std::abs(row[i] - expected[y * row.size() + i]) };
+                max_error = std::max(max_error, error);
+                if (!(error <= tolerance)) {
+                    mismatches++;
+                }
+            }
+        }
+        readback.unmap();
+    }
+
+    readback.destroy();
+    readback.release();
+    queue.release();
+
+    log << "Compared " << extends.x * extends.y * extends.z << " voxels: " << mismatches
+        << " mismatches, max error " << max_error << std::endl;
+    return matches && mismatches == 0;
+}
+
+wgpu::ComputePipeline GPUVolumeNormalizer::create_pipeline(const std::string& code, const char* entry_point)
+{
+    wgpu::ShaderModuleWGSLDescriptor wgsl_module_desc { wgpu::Default };
+    wgsl_module_desc.code = code.c_str();
+    wgpu::ShaderModuleDescriptor module_desc { wgpu::Default };
+    module_desc.nextInChain = reinterpret_cast<wgpu::ChainedStruct*>(&wgsl_module_desc);
+    auto shader_module = this->m_device.createShaderModule(module_desc);
+    if (!shader_module) {
+        throw std::runtime_error("could not create the normalization shader module");
+    }
+
+    wgpu::ComputePipelineDescriptor pipeline_desc { wgpu::Default };
+    pipeline_desc.layout = nullptr;
+    pipeline_desc.compute.module = shader_module;
+    pipeline_desc.compute.entryPoint = entry_point;
+    auto pipeline = this->m_device.createComputePipeline(pipeline_desc);
+    shader_module.release();
+    if (!pipeline) {
+        throw std::runtime_error("could not create the normalization pipeline");
+    }
+    return pipeline;
+}
+
+void GPUVolumeNormalizer::wait_for_map(wgpu::Buffer& buffer, std::size_t size)
+{
+    bool done { false };
+    bool mapped { false };
+    auto callback = buffer.mapAsync(wgpu::MapMode::Read, 0, size, [&](wgpu::BufferMapAsyncStatus status) {
+        done = true;
+        mapped = status == wgpu::BufferMapAsyncStatus::Success;
+    });
+    while (!done) {
+        wgpuDevicePoll(this->m_device, true, nullptr);
+    }
+    if (!mapped) {
+        throw std::runtime_error("could not map the readback buffer");
+    }
+}
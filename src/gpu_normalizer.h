@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <dds_codec.h>
+#include <memory_tracker.h>
+#include <pvm_volume.h>
+#include <volume_fit.h>
+#include <volume_texture.h>
+
+/**
+ * Raw 8-bit voxels of a PVM volume, resident in GPU storage buffers.
+ *
+ * The volume is split into slabs of whole z-slices, so that each slab fits
+ * into a single storage buffer binding.
+ */
+class GPURawVolume {
+public:
+    GPURawVolume();
+    GPURawVolume(const GPURawVolume&) = delete;
+    GPURawVolume(GPURawVolume&&);
+    ~GPURawVolume();
+
+    GPURawVolume& operator=(const GPURawVolume&) = delete;
+    GPURawVolume& operator=(GPURawVolume&&);
+
+    /**
+     * Returns the header of the volume.
+     * @return volume header
+     */
+    const PVMInfo& info() const;
+
+    /**
+     * Returns the number of bytes of the raw voxels.
+     * @return raw bytes
+     */
+    std::size_t byte_size() const;
+
+private:
+    friend class GPUVolumeNormalizer;
+
+    struct Slab {
+        wgpu::Buffer voxels;
+        std::size_t z_offset;
+        std::size_t depth;
+        std::size_t bytes;
+    };
+
+    void release();
+
+    std::vector<Slab> m_slabs;
+    wgpu::Buffer m_ranges;
+    PVMInfo m_info;
+    TrackedAllocation m_memory;
+};
+
+/**
+ * GPU implementation of the normalization done by `PVMVolume`.
+ *
+ * The raw voxels are uploaded without widening them to floats. A compute
+ * shader reduces the minimum/maximum of every component, first within each
+ * workgroup and then across workgroups with atomics, and a second one writes
+ * the normalized values directly into a `VolumeTexture`. `PVMVolume` remains
+ * the reference implementation, see `verify`.
+ */
+class GPUVolumeNormalizer {
+public:
+    GPUVolumeNormalizer(wgpu::Device& device);
+    GPUVolumeNormalizer(const GPUVolumeNormalizer&) = delete;
+    GPUVolumeNormalizer(GPUVolumeNormalizer&&) = delete;
+    ~GPUVolumeNormalizer();
+
+    GPUVolumeNormalizer& operator=(const GPUVolumeNormalizer&) = delete;
+    GPUVolumeNormalizer& operator=(GPUVolumeNormalizer&&) = delete;
+
+    /**
+     * Streams the raw voxels of a PVM volume into GPU buffers.
+     * The slices are decoded directly into mapped buffers, so the volume is
+     * never held in host memory. Volumes not fitting into a single texture
+     * are rejected before any buffer is allocated. May be called from a
+     * worker thread.
+     * @param path path to the volume
+     * @param progress optional progress counters, updated while loading
+     * @return uploaded volume
+     */
+    GPURawVolume upload(const std::filesystem::path& path, PVMLoadProgress* progress = nullptr);
+
+    /**
+     * Enqueues the reduction and normalization of an uploaded volume.
+     * @param volume uploaded volume, its components must be supported by `VolumeTexture`
+     * @return texture receiving the normalized volume
+     */
+    std::unique_ptr<VolumeTexture> normalize(GPURawVolume& volume);
+
+    /**
+     * Reads the value ranges computed by `normalize` back to the host.
+     * Blocks until the GPU finished the reduction.
+     * @param volume normalized volume
+     * @return minimum (x) and maximum (y) value of each component
+     */
+    std::vector<glm::vec2> component_ranges(const GPURawVolume& volume);
+
+    /**
+     * Compares the GPU path with the `PVMVolume` reference.
+     * Components whose values are all equal are skipped, as their normalized
+     * values are undefined.
+     * @param path path to the volume
+     * @param log stream receiving the result
+     * @param tolerance maximum absolute difference of the normalized values
+     * @return both paths produce the same volume
+     */
+    bool verify(const std::filesystem::path& path, std::ostream& log, float tolerance = 1e-5f);
+
+private:
+    wgpu::ComputePipeline create_pipeline(const std::string& code, const char* entry_point);
+    void wait_for_map(wgpu::Buffer& buffer, std::size_t size);
+
+    wgpu::Device m_device;
+    wgpu::ComputePipeline m_reduce_pipeline;
+    std::array<wgpu::ComputePipeline, 3> m_normalize_pipelines;
+    std::size_t m_max_slab_bytes;
+    VolumeDeviceLimits m_texture_limits;
+};
+
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * Least recently used cache bounded by a byte budget.
+ *
+ * Every entry carries its size in bytes. Inserting an entry evicts the least
+ * recently used entries until the cache fits into its budget again; the newest
+ * entry is always kept, even if it alone exceeds the budget. The cache is not
+ * synchronized.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LRUCache {
+public:
+    /**
+     * Creates an empty cache.
+     * @param budget maximum number of bytes held by the cache
+     */
+    LRUCache(std::size_t budget)
+        : m_entries {}
+        , m_index {}
+        , m_budget { budget }
+        , m_size { 0 }
+    {
+    }
+
+    /**
+     * Looks up an entry and marks it as most recently used.
+     * @param key key of the entry
+     * @return pointer to the value, or nullptr if not present
+     */
+    Value* find(const Key& key)
+    {
+        auto it = this->m_index.find(key);
+        if (it == this->m_index.end()) {
+            return nullptr;
+        }
+        this->m_entries.splice(this->m_entries.begin(), this->m_entries, it->second);
+        return &it->second->value;
+    }
+
+    /**
+     * Checks if an entry is present without touching its recency.
+     * @param key key of the entry
+     * @return entry is present
+     */
+    bool contains(const Key& key) const
+    {
+        return this->m_index.contains(key);
+    }
+
+    /**
+     * Inserts or replaces an entry and evicts entries exceeding the budget.
+     * @param key key of the entry
+     * @param value value of the entry
+     * @param size size of the entry in bytes
+     */
+    void insert(const Key& key, Value value, std::size_t size)
+    {
+        this->erase(key);
+        this->m_entries.push_front(Entry { key, std::move(value), size });
+        this->m_index.emplace(key, this->m_entries.begin());
+        this->m_size += size;
+        this->evict();
+    }
+
+    /**
+     * Removes an entry.
+     * @param key key of the entry
+     * @return entry was present
+     */
+    bool erase(const Key& key)
+    {
+        auto it = this->m_index.find(key);
+        if (it == this->m_index.end()) {
+            return false;
+        }
+        this->m_size -= it->second->size;
+        this->m_entries.erase(it->second);
+        this->m_index.erase(it);
+        return true;
+    }
+
+    /**
+     * Removes all entries.
+     */
+    void clear()
+    {
+        this->m_entries.clear();
+        this->m_index.clear();
+        this->m_size = 0;
+    }
+
+    /**
+     * Changes the budget and evicts entries exceeding it.
+     * @param budget maximum number of bytes held by the cache
+     */
+    void set_budget(std::size_t budget)
+    {
+        this->m_budget = budget;
+        this->evict();
+    }
+
+    /**
+     * Evicts the least recently used entries, e.g. under memory pressure.
+     * The budget is kept.
+     * @param bytes minimum number of bytes to free
+     * @return number of bytes freed
+     */
+    std::size_t shrink(std::size_t bytes)
+    {
+        std::size_t freed { 0 };
+        while (freed < bytes && !this->m_entries.empty()) {
+            const Entry& entry { this->m_entries.back() };
+            freed += entry.size;
+            this->m_size -= entry.size;
+            this->m_index.erase(entry.key);
+            this->m_entries.pop_back();
+        }
+        return freed;
+    }
+
+    /**
+     * Returns the maximum number of bytes held by the cache.
+     * @return budget in bytes
+     */
+    std::size_t budget() const
+    {
+        return this->m_budget;
+    }
+
+    /**
+     * Returns the number of bytes currently held by the cache.
+     * @return size in bytes
+     */
+    std::size_t size() const
+    {
+        return this->m_size;
+    }
+
+    /**
+     * Returns the number of entries.
+     * @return number of entries
+     */
+    std::size_t entry_count() const
+    {
+        return this->m_entries.size();
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        std::size_t size;
+    };
+
+    void evict()
+    {
+        while (this->m_size > this->m_budget && this->m_entries.size() > 1) {
+            const Entry& entry { this->m_entries.back() };
+            this->m_size -= entry.size;
+            this->m_index.erase(entry.key);
+            this->m_entries.pop_back();
+        }
+    }
+
+    std::list<Entry> m_entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> m_index;
+    std::size_t m_budget;
+    std::size_t m_size;
+};
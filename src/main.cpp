@@ -1,9 +1,15 @@
 #include <iostream>
+#include <span>
 
 #include <application.h>
+#include <command_line.h>
 
-int main()
+int main(int argc, char** argv)
 {
+    if (auto exit_code = run_command_line_mode(std::span { argv + 1, static_cast<std::size_t>(argc - 1) })) {
+        return *exit_code;
+    }
+
     Application app {};
     app.run();
     return 0;
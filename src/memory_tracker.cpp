@@ -0,0 +1,260 @@
+#include <memory_tracker.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr std::size_t tag_count { static_cast<std::size_t>(MemoryTag::Count) };
+
+}
+
+const char* memory_tag_name(MemoryTag tag)
+{
+    switch (tag) {
+    case MemoryTag::VolumeData:
+        return "volume_data";
+    case MemoryTag::VolumeDecoding:
+        return "volume_decoding";
+    case MemoryTag::BrickCache:
+        return "brick_cache";
+    case MemoryTag::CompressedVolumes:
+        return "compressed_volumes";
+    case MemoryTag::Slices:
+        return "slices";
+    case MemoryTag::Streamlines:
+        return "streamlines";
+    case MemoryTag::GPUTextures:
+        return "gpu_textures";
+    case MemoryTag::GPUBuffers:
+        return "gpu_buffers";
+    default:
+        throw std::invalid_argument("invalid memory tag");
+    }
+}
+
+bool is_gpu_memory_tag(MemoryTag tag)
+{
+    return tag == MemoryTag::GPUTextures || tag == MemoryTag::GPUBuffers;
+}
+
+MemoryTracker::MemoryTracker()
+    : m_counters {}
+    , m_budget_mutex {}
+    , m_budgets {}
+    , m_next_budget_id { 0 }
+{
+}
+
+MemoryTracker& MemoryTracker::instance()
+{
+    static MemoryTracker tracker {};
+    return tracker;
+}
+
+void MemoryTracker::allocate(MemoryTag tag, std::size_t bytes)
+{
+    Counter& counter { this->m_counters.at(static_cast<std::size_t>(tag)) };
+    std::size_t current { counter.current.fetch_add(bytes, std::memory_order_relaxed) + bytes };
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+
+    std::size_t peak { counter.peak.load(std::memory_order_relaxed) };
+    while (peak < current && !counter.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryTracker::release(MemoryTag tag, std::size_t bytes)
+{
+    Counter& counter { this->m_counters.at(static_cast<std::size_t>(tag)) };
+    counter.current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryTagStats MemoryTracker::stats(MemoryTag tag) const
+{
+    const Counter& counter { this->m_counters.at(static_cast<std::size_t>(tag)) };
+    MemoryTagStats stats {
+        tag,
+        counter.current.load(std::memory_order_relaxed),
+        counter.peak.load(std::memory_order_relaxed),
+        counter.allocations.load(std::memory_order_relaxed),
+        0,
+    };
+
+    // The smallest budget of the tag is reported.
+    std::scoped_lock lock { this->m_budget_mutex };
+    for (const Budget& budget : this->m_budgets) {
+        if (budget.tag == tag && (stats.budget_bytes == 0 || budget.bytes < stats.budget_bytes)) {
+            stats.budget_bytes = budget.bytes;
+        }
+    }
+    return stats;
+}
+
+std::vector<MemoryTagStats> MemoryTracker::snapshot() const
+{
+    std::vector<MemoryTagStats> snapshot {};
+    snapshot.reserve(tag_count);
+    for (std::size_t i { 0 }; i < tag_count; ++i) {
+        snapshot.push_back(this->stats(static_cast<MemoryTag>(i)));
+    }
+    return snapshot;
+}
+
+std::size_t MemoryTracker::total_bytes(bool gpu) const
+{
+    std::size_t total { 0 };
+    for (std::size_t i { 0 }; i < tag_count; ++i) {
+        if (is_gpu_memory_tag(static_cast<MemoryTag>(i)) == gpu) {
+            total += this->m_counters[i].current.load(std::memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+void MemoryTracker::reset_peaks()
+{
+    for (Counter& counter : this->m_counters) {
+        counter.peak.store(counter.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+std::size_t MemoryTracker::add_budget(MemoryTag tag, std::size_t bytes, BudgetCallback callback)
+{
+    if (static_cast<std::size_t>(tag) >= tag_count) {
+        throw std::invalid_argument("invalid memory tag");
+    }
+
+    std::scoped_lock lock { this->m_budget_mutex };
+    std::size_t id { this->m_next_budget_id++ };
+    this->m_budgets.push_back(Budget { id, tag, bytes, std::move(callback) });
+    return id;
+}
+
+void MemoryTracker::remove_budget(std::size_t id)
+{
+    std::scoped_lock lock { this->m_budget_mutex };
+    std::erase_if(this->m_budgets, [&](const Budget& budget) { return budget.id == id; });
+}
+
+std::size_t MemoryTracker::check_budgets()
+{
+    std::vector<Budget> exceeded {};
+    {
+        std::scoped_lock lock { this->m_budget_mutex };
+        for (const Budget& budget : this->m_budgets) {
+            if (this->m_counters[static_cast<std::size_t>(budget.tag)].current.load(std::memory_order_relaxed) > budget.bytes) {
+                exceeded.push_back(budget);
+            }
+        }
+    }
+
+    // Callbacks may release memory or change the budgets.
+    for (const Budget& budget : exceeded) {
+        std::size_t current { this->m_counters[static_cast<std::size_t>(budget.tag)].current.load(std::memory_order_relaxed) };
+        if (budget.callback) {
+            budget.callback(budget.tag, current, budget.bytes);
+        }
+    }
+    return exceeded.size();
+}
+
+void MemoryTracker::write_csv(std::ostream& stream) const
+{
+    stream << "tag,device,current_bytes,peak_bytes,allocations,budget_bytes\n";
+    for (const MemoryTagStats& stats : this->snapshot()) {
+        stream << memory_tag_name(stats.tag) << ',' << (is_gpu_memory_tag(stats.tag) ? "gpu" : "cpu") << ','
+               << stats.current_bytes << ',' << stats.peak_bytes << ',' << stats.allocations << ','
+               << stats.budget_bytes << '\n';
+    }
+}
+
+void MemoryTracker::write_json(std::ostream& stream) const
+{
+    stream << "{\n  \"cpu_bytes\": " << this->total_bytes(false) << ",\n  \"gpu_bytes\": " << this->total_bytes(true)
+           << ",\n  \"tags\": [";
+    auto snapshot = this->snapshot();
+    for (std::size_t i { 0 }; i < snapshot.size(); ++i) {
+        const MemoryTagStats& stats { snapshot[i] };
+        stream << (i == 0 ? "\n" : ",\n") << "    { \"tag\": \"" << memory_tag_name(stats.tag) << "\", \"device\": \""
+               << (is_gpu_memory_tag(stats.tag) ? "gpu" : "cpu") << "\", \"current_bytes\": " << stats.current_bytes
+               << ", \"peak_bytes\": " << stats.peak_bytes << ", \"allocations\": " << stats.allocations
+               << ", \"budget_bytes\": " << stats.budget_bytes << " }";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+TrackedAllocation::TrackedAllocation(MemoryTag tag)
+    : m_tag { tag }
+    , m_bytes { 0 }
+{
+}
+
+TrackedAllocation::TrackedAllocation(MemoryTag tag, std::size_t bytes)
+    : m_tag { tag }
+    , m_bytes { bytes }
+{
+    if (this->m_bytes != 0) {
+        MemoryTracker::instance().allocate(this->m_tag, this->m_bytes);
+    }
+}
+
+TrackedAllocation::TrackedAllocation(const TrackedAllocation& allocation)
+    : TrackedAllocation { allocation.m_tag, allocation.m_bytes }
+{
+}
+
+TrackedAllocation::TrackedAllocation(TrackedAllocation&& allocation) noexcept
+    : m_tag { allocation.m_tag }
+    , m_bytes { std::exchange(allocation.m_bytes, 0) }
+{
+}
+
+TrackedAllocation::~TrackedAllocation()
+{
+    if (this->m_bytes != 0) {
+        MemoryTracker::instance().release(this->m_tag, this->m_bytes);
+    }
+}
+
+TrackedAllocation& TrackedAllocation::operator=(const TrackedAllocation& allocation)
+{
+    if (this != &allocation) {
+        if (this->m_bytes != 0) {
+            MemoryTracker::instance().release(this->m_tag, this->m_bytes);
+        }
+        this->m_tag = allocation.m_tag;
+        this->m_bytes = 0;
+        this->resize(allocation.m_bytes);
+    }
+    return *this;
+}
+
+TrackedAllocation& TrackedAllocation::operator=(TrackedAllocation&& allocation) noexcept
+{
+    if (this != &allocation) {
+        if (this->m_bytes != 0) {
+            MemoryTracker::instance().release(this->m_tag, this->m_bytes);
+        }
+        this->m_tag = allocation.m_tag;
+        this->m_bytes = std::exchange(allocation.m_bytes, 0);
+    }
+    return *this;
+}
+
+void TrackedAllocation::resize(std::size_t bytes)
+{
+    MemoryTracker& tracker { MemoryTracker::instance() };
+    if (this->m_bytes != 0) {
+        tracker.release(this->m_tag, this->m_bytes);
+    }
+    this->m_bytes = bytes;
+    if (this->m_bytes != 0) {
+        tracker.allocate(this->m_tag, this->m_bytes);
+    }
+}
+
+std::size_t TrackedAllocation::bytes() const
+{
+    return this->m_bytes;
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+ * Subsystems whose memory is accounted.
+ */
+enum class MemoryTag : std::size_t {
+    VolumeData,
+    VolumeDecoding,
+    BrickCache,
+    CompressedVolumes,
+    Slices,
+    Streamlines,
+    GPUTextures,
+    GPUBuffers,
+    Count,
+};
+
+/**
+ * Returns the name of a tag, as used in the dumps.
+ * @param tag memory tag
+ * @return tag name
+ */
+const char* memory_tag_name(MemoryTag tag);
+
+/**
+ * Checks if a tag accounts GPU memory.
+ * GPU sizes are estimates of the resident data, without driver overhead.
+ * @param tag memory tag
+ * @return tag accounts GPU memory
+ */
+bool is_gpu_memory_tag(MemoryTag tag);
+
+/**
+ * Counters of a single tag.
+ */
+struct MemoryTagStats {
+    MemoryTag tag;
+    std::size_t current_bytes;
+    std::size_t peak_bytes;
+    std::size_t allocations;
+    std::size_t budget_bytes;
+};
+
+/**
+ * Process-wide memory accounting, tagged by subsystem.
+ *
+ * Subsystems report their large allocations, usually through a
+ * `TrackedAllocation` member, and the tracker keeps the current and peak
+ * bytes of each tag. The counters are atomic, so allocations can be reported
+ * from any thread without locking.
+ *
+ * Budgets may be registered per tag. Exceeded budgets are not reported from
+ * within the allocating code, which may hold locks of the cache that should
+ * evict; instead `check_budgets()` invokes their callbacks, e.g. once per
+ * frame on the main thread.
+ */
+class MemoryTracker {
+public:
+    using BudgetCallback = std::function<void(MemoryTag tag, std::size_t current_bytes, std::size_t budget_bytes)>;
+
+    MemoryTracker();
+    MemoryTracker(const MemoryTracker&) = delete;
+    MemoryTracker(MemoryTracker&&) = delete;
+    ~MemoryTracker() = default;
+
+    MemoryTracker& operator=(const MemoryTracker&) = delete;
+    MemoryTracker& operator=(MemoryTracker&&) = delete;
+
+    /**
+     * Returns the tracker of the process.
+     * @return tracker
+     */
+    static MemoryTracker& instance();
+
+    /**
+     * Accounts an allocation.
+     * @param tag tag of the allocating subsystem
+     * @param bytes allocated bytes
+     */
+    void allocate(MemoryTag tag, std::size_t bytes);
+
+    /**
+     * Accounts a release of previously allocated memory.
+     * @param tag tag of the allocating subsystem
+     * @param bytes released bytes
+     */
+    void release(MemoryTag tag, std::size_t bytes);
+
+    /**
+     * Returns the counters of a tag.
+     * @param tag memory tag
+     * @return counters
+     */
+    MemoryTagStats stats(MemoryTag tag) const;
+
+    /**
+     * Returns the counters of all tags.
+     * @return counters, in tag order
+     */
+    std::vector<MemoryTagStats> snapshot() const;
+
+    /**
+     * Returns the bytes currently accounted to the CPU or the GPU.
+     * @param gpu sum the GPU instead of the CPU tags
+     * @return accounted bytes
+     */
+    std::size_t total_bytes(bool gpu) const;
+
+    /**
+     * Sets the peak of each tag to its current value.
+     */
+    void reset_peaks();
+
+    /**
+     * Registers a budget for a tag.
+     * @param tag memory tag
+     * @param bytes maximum number of bytes
+     * @param callback function invoked by `check_budgets()` while the budget is exceeded
+     * @return id of the budget
+     */
+    std::size_t add_budget(MemoryTag tag, std::size_t bytes, BudgetCallback callback);
+
+    /**
+     * Removes a budget.
+     * @param id id of the budget
+     */
+    void remove_budget(std::size_t id);
+
+    /**
+     * Invokes the callbacks of all exceeded budgets.
+     * The callbacks are called without holding any lock of the tracker.
+     * @return number of invoked callbacks
+     */
+    std::size_t check_budgets();
+
+    /**
+     * Writes the counters as CSV, with a header line.
+     * @param stream output stream
+     */
+    void write_csv(std::ostream& stream) const;
+
+    /**
+     * Writes the counters as JSON object.
+     * @param stream output stream
+     */
+    void write_json(std::ostream& stream) const;
+
+private:
+    struct Counter {
+        std::atomic<std::size_t> current { 0 };
+        std::atomic<std::size_t> peak { 0 };
+        std::atomic<std::size_t> allocations { 0 };
+    };
+
+    struct Budget {
+        std::size_t id;
+        MemoryTag tag;
+        std::size_t bytes;
+        BudgetCallback callback;
+    };
+
+    std::array<Counter, static_cast<std::size_t>(MemoryTag::Count)> m_counters;
+    mutable std::mutex m_budget_mutex;
+    std::vector<Budget> m_budgets;
+    std::size_t m_next_budget_id;
+};
+
+/**
+ * Allocation accounted by the memory tracker for its lifetime.
+ *
+ * Objects owning large buffers keep one of these next to the buffer and
+ * resize it with the buffer. Copies account the same size again, like the
+ * copied buffer.
+ */
+class TrackedAllocation {
+public:
+    /**
+     * Creates an empty allocation.
+     * @param tag tag of the allocating subsystem
+     */
+    TrackedAllocation(MemoryTag tag);
+
+    /**
+     * Accounts an allocation.
+     * @param tag tag of the allocating subsystem
+     * @param bytes allocated bytes
+     */
+    TrackedAllocation(MemoryTag tag, std::size_t bytes);
+    TrackedAllocation(const TrackedAllocation&);
+    TrackedAllocation(TrackedAllocation&&) noexcept;
+    ~TrackedAllocation();
+
+    TrackedAllocation& operator=(const TrackedAllocation&);
+    TrackedAllocation& operator=(TrackedAllocation&&) noexcept;
+
+    /**
+     * Changes the accounted size.
+     * @param bytes new size in bytes
+     */
+    void resize(std::size_t bytes);
+
+    /**
+     * Returns the accounted size.
+     * @return size in bytes
+     */
+    std::size_t bytes() const;
+
+private:
+    MemoryTag m_tag;
+    std::size_t m_bytes;
+};
+
+/**
+ * Creates a shared object whose memory is accounted until the last owner releases it.
+ * @param tag tag of the allocating subsystem
+ * @param bytes accounted bytes
+ * @param value object to share
+ * @return shared object
+ */
+template <typename T>
+std::shared_ptr<T> make_tracked_shared(MemoryTag tag, std::size_t bytes, T value)
+{
+    struct Tracked {
+        T value;
+        TrackedAllocation allocation;
+    };
+    auto tracked = std::make_shared<Tracked>(Tracked { std::move(value), TrackedAllocation { tag, bytes } });
+    return std::shared_ptr<T> { tracked, &tracked->value };
+}
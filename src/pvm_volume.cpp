@@ -1,14 +1,157 @@
 #include <pvm_volume.h>
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <limits>
+#include <mutex>
+#include <span>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
-#include <volumeio.h>
+#include <dds_codec.h>
+#include <task_scheduler.h>
+#include <volume_layout.h>
 
-PVMVolume::PVMVolume(const std::filesystem::path& volume_path)
+namespace {
+
+void check_cancelled(const PVMLoadProgress* progress)
+{
+    if (progress && progress->cancel_requested) {
+        throw std::runtime_error("volume load cancelled");
+    }
+}
+
+// Bounded queue of cropped slices between the decoding and the converting thread.
+class SliceQueue {
+public:
+    SliceQueue(std::size_t capacity)
+        : m_slices {}
+        , m_mutex {}
+        , m_condition {}
+        , m_capacity { capacity }
+        , m_closed { false }
+    {
+    }
+
+    // Returns false if the queue was closed, e.g. by a failed consumer.
+    bool push(std::vector<unsigned char> slice)
+    {
+        std::unique_lock lock { this->m_mutex };
+        this->m_condition.wait(lock, [&]() { return this->m_closed || this->m_slices.size() < this->m_capacity; });
+        if (this->m_closed) {
+            return false;
+        }
+        this->m_slices.push_back(std::move(slice));
+        this->m_condition.notify_all();
+        return true;
+    }
+
+    bool pop(std::vector<unsigned char>& slice)
+    {
+        std::unique_lock lock { this->m_mutex };
+        this->m_condition.wait(lock, [&]() { return this->m_closed || !this->m_slices.empty(); });
+        if (this->m_slices.empty()) {
+            return false;
+        }
+        slice = std::move(this->m_slices.front());
+        this->m_slices.pop_front();
+        this->m_condition.notify_all();
+        return true;
+    }
+
+    void close()
+    {
+        std::scoped_lock lock { this->m_mutex };
+        this->m_closed = true;
+        this->m_condition.notify_all();
+    }
+
+private:
+    std::deque<std::vector<unsigned char>> m_slices;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::size_t m_capacity;
+    bool m_closed;
+};
+
+// Source voxels overlapping each target voxel along one axis, with the
+// fraction of the target voxel they cover.
+struct AxisFilter {
+    std::vector<std::size_t> first_source;
+    std::vector<std::size_t> weight_offsets;
+    std::vector<float> weights;
+};
+
+AxisFilter box_filter(std::size_t source_size, std::size_t target_size)
+{
+    AxisFilter filter {};
+    double ratio { static_cast<double>(source_size) / static_cast<double>(target_size) };
+    filter.weight_offsets.push_back(0);
+    for (std::size_t target { 0 }; target < target_size; ++target) {
+        double begin { static_cast<double>(target) * ratio };
+        double end { static_cast<double>(target + 1) * ratio };
+        auto first = static_cast<std::size_t>(begin);
+        auto last = std::min(static_cast<std::size_t>(std::ceil(end)), source_size);
+
+        filter.first_source.push_back(first);
+        for (std::size_t source { first }; source < last; ++source) {
+            double overlap { std::min(static_cast<double>(source + 1), end) - std::max(static_cast<double>(source), begin) };
+            filter.weights.push_back(static_cast<float>(std::max(overlap, 0.0) / ratio));
+        }
+        filter.weight_offsets.push_back(filter.weights.size());
+    }
+    return filter;
+}
+
+// Filters an array of shape [outer][source][inner] into one of shape [outer][target][inner].
+// The rows are filtered in blocks of about as many values as a normalization
+// slab on the workers of the calling scheduler.
+void filter_axis(const float* input, float* output, std::size_t outer, std::size_t inner, std::size_t source_size,
+    const AxisFilter& filter)
+{
+    std::size_t target_size { filter.first_source.size() };
+    glm::vec<3, std::size_t> rows { 1, outer * target_size, 1 };
+    glm::vec<3, std::size_t> block { 1, std::max<std::size_t>(normalization_slab_voxels / std::max<std::size_t>(inner, 1), 1), 1 };
+    TaskScheduler::current().parallel_for(rows, block, [&](const PVMRegion& rows_block) {
+        for (std::size_t row { rows_block.offset.y }; row < rows_block.offset.y + rows_block.extends.y; ++row) {
+            std::size_t outer_index { row / target_size };
+            std::size_t target { row % target_size };
+            float* destination { output + row * inner };
+            std::fill_n(destination, inner, 0.0f);
+
+            std::size_t source { outer_index * source_size + filter.first_source[target] };
+            for (std::size_t w { filter.weight_offsets[target] }; w < filter.weight_offsets[target + 1]; ++w, ++source) {
+                float weight { filter.weights[w] };
+                const float* values { input + source * inner };
+                for (std::size_t i { 0 }; i < inner; ++i) {
+                    destination[i] += weight * values[i];
+                }
+            }
+        }
+    });
+}
+
+}
+
+PVMVolume::PVMVolume(const std::filesystem::path& volume_path, PVMLoadProgress* progress)
+    : PVMVolume(volume_path,
+          PVMRegion {
+              glm::vec<3, std::size_t> { 0 },
+              glm::vec<3, std::size_t> { std::numeric_limits<std::size_t>::max() },
+          },
+          progress)
+{
+}
+
+PVMVolume::PVMVolume(const std::filesystem::path& volume_path, const PVMRegion& region, PVMLoadProgress* progress)
     : m_component_ranges {}
     , m_data {}
+    , m_data_memory { MemoryTag::VolumeData }
     , m_name { volume_path.string() }
     , m_size_x { 0 }
     , m_size_y { 0 }
@@ -18,69 +161,223 @@ PVMVolume::PVMVolume(const std::filesystem::path& volume_path)
     , m_scale_y { 0.0f }
     , m_scale_z { 0.0f }
 {
-#ifdef _MSC_VER
-    const char* c_volume_path = this->m_name.c_str();
-#else
-    const char* c_volume_path = volume_path.c_str();
-#endif
+    // The slices are decoded on this thread, while a second thread converts
+    // them to floats and finds the minimum/maximum of all components. Only the
+    // normalization has to wait for the whole volume. The converter is
+    // declared last, so it is joined before the locals it uses are destroyed,
+    // also when decoding throws.
+    SliceQueue queue { 8 };
+    std::exception_ptr converter_error {};
+    std::size_t source_size_x { 0 };
+    std::jthread converter {};
+
+    auto convert = [&]() {
+        try {
+            glm::vec<3, std::size_t> slice_extends { this->m_size_x, this->m_size_y, 1 };
+            std::span<glm::vec2> ranges { this->m_component_ranges.get(), this->m_components };
+            float* output { this->m_data.get() };
+            std::vector<unsigned char> slice {};
+            while (queue.pop(slice)) {
+                VolumeView<const unsigned char> slice_view { slice.data(), slice_extends, this->m_components };
+                visit_components(slice_view, [&](auto view) { accumulate_voxel_ranges(view, ranges); });
+                output = std::copy(slice.begin(), slice.end(), output);
+            }
+        } catch (...) {
+            // Closing the queue stops the decoder, which would block on the full queue otherwise.
+            converter_error = std::current_exception();
+            queue.close();
+        }
+    };
 
-    auto deleter = [](unsigned char* ptr) {
-        if (ptr) {
-            std::free(ptr);
+    auto info_sink = [&](const PVMInfo& info) {
+        if (region.offset.x >= info.extends.x || region.offset.y >= info.extends.y || region.offset.z >= info.extends.z) {
+            throw std::out_of_range("region out of range");
         }
+
+        glm::vec<3, std::size_t> extends { glm::min(region.extends, info.extends - region.offset) };
+        this->m_size_x = extends.x;
+        this->m_size_y = extends.y;
+        this->m_size_z = extends.z;
+        this->m_components = info.components;
+        this->m_scale_x = info.scale.x;
+        this->m_scale_y = info.scale.y;
+        this->m_scale_z = info.scale.z;
+        source_size_x = info.extends.x;
+
+        size_t data_size { this->m_size_x * this->m_size_y * this->m_size_z * this->m_components };
+        this->m_component_ranges.reset(new glm::vec2[this->m_components]);
+        this->m_data.reset(new float[data_size]);
+        this->m_data_memory.resize(data_size * sizeof(float));
+
+        for (std::size_t i { 0 }; i < this->m_components; ++i) {
+            static_assert(std::numeric_limits<float>::is_iec559, "IEEE 754 required");
+            glm::vec2& component { this->m_component_ranges[i] };
+            component.x = std::numeric_limits<float>::infinity();
+            component.y = -std::numeric_limits<float>::infinity();
+        }
+
+        if (progress) {
+            progress->voxels_total = this->m_size_x * this->m_size_y * this->m_size_z;
+            progress->voxels_normalized = 0;
+        }
+
+        converter = std::jthread { convert };
+        return !(progress && progress->cancel_requested);
+    };
+
+    auto slice_sink = [&](std::size_t, std::span<const unsigned char> slice) {
+        // Keep only the rows and columns inside the region.
+        std::size_t row_size { this->m_size_x * this->m_components };
+        std::vector<unsigned char> cropped(row_size * this->m_size_y);
+        for (std::size_t y { 0 }; y < this->m_size_y; ++y) {
+            auto row = slice.subspan(((region.offset.y + y) * source_size_x + region.offset.x) * this->m_components, row_size);
+            std::copy(row.begin(), row.end(), cropped.begin() + static_cast<std::ptrdiff_t>(y * row_size));
+        }
+        if (!queue.push(std::move(cropped))) {
+            return false;
+        }
+        if (progress) {
+            progress->bytes_decoded += slice.size();
+        }
+        return !(progress && progress->cancel_requested);
     };
 
-    unsigned int width, height, depth, components;
-    std::unique_ptr<unsigned char[], void (*)(unsigned char*)> data {
-        readPVMvolume(c_volume_path, &width, &height,
-            &depth, &components, &this->m_scale_x, &this->m_scale_y, &this->m_scale_z),
-        deleter
+    auto report_progress = [&](std::size_t bytes_read, std::size_t bytes_total, std::size_t) {
+        if (progress) {
+            progress->bytes_total = bytes_total;
+            progress->bytes_read = bytes_read;
+        }
+        return !(progress && progress->cancel_requested);
     };
-    if (!data) {
+
+    bool complete { false };
+    try {
+        complete = read_pvm_slices(volume_path, info_sink, slice_sink, region.offset.z,
+            region.offset.z + std::min(region.extends.z, std::numeric_limits<std::size_t>::max() - region.offset.z), report_progress);
+    } catch (...) {
+        queue.close();
+        throw;
+    }
+    queue.close();
+    if (converter.joinable()) {
+        converter.join();
+    }
+    if (converter_error) {
+        std::rethrow_exception(converter_error);
+    }
+    check_cancelled(progress);
+    if (!complete) {
         throw std::runtime_error("could not read pvm volume");
     }
+    if (progress) {
+        progress->bytes_read = progress->bytes_total.load();
+    }
 
-    this->m_size_x = static_cast<std::size_t>(width);
-    this->m_size_y = static_cast<std::size_t>(height);
-    this->m_size_z = static_cast<std::size_t>(depth);
-    this->m_components = static_cast<std::size_t>(components);
-
-    size_t data_size { this->m_size_x * this->m_size_y * this->m_size_z * this->m_components };
-    this->m_component_ranges.reset(new glm::vec2[this->m_components]);
-    this->m_data.reset(new float[data_size]);
+    // Normalize the values in z-slabs on the workers of the calling
+    // scheduler. Slabs starting after a cancellation are skipped.
+    std::size_t slice_voxels { this->m_size_x * this->m_size_y };
+    std::size_t slice_size { slice_voxels * this->m_components };
+    std::size_t slab_depth { std::max<std::size_t>(normalization_slab_voxels / std::max<std::size_t>(slice_voxels, 1), 1) };
+    std::span<const glm::vec2> ranges { this->m_component_ranges.get(), this->m_components };
+    TaskScheduler::current().parallel_for(this->extends(), z_slabs(this->extends(), slab_depth), [&](const PVMRegion& slab) {
+        if (progress && progress->cancel_requested) {
+            return;
+        }
+        VolumeView<float> slab_view { this->m_data.get() + slab.offset.z * slice_size, slab.extends, this->m_components };
+        visit_components(slab_view, [&](auto view) { normalize_voxels(view, ranges, view); });
+        if (progress) {
+            progress->voxels_normalized += slab.extends.z * slice_voxels;
+        }
+    });
+    check_cancelled(progress);
+}
 
-    for (std::size_t i { 0 }; i < this->m_components; ++i) {
-        static_assert(std::numeric_limits<float>::is_iec559, "IEEE 754 required");
-        glm::vec2& component { this->m_component_ranges[i] };
-        component.x = std::numeric_limits<float>::infinity();
-        component.y = -std::numeric_limits<float>::infinity();
+PVMVolume::PVMVolume(const PVMVolume& volume, glm::vec<3, std::size_t> extends)
+    : m_component_ranges { new glm::vec2[volume.m_components] }
+    , m_data {}
+    , m_data_memory { MemoryTag::VolumeData }
+    , m_name { volume.m_name }
+    , m_size_x { extends.x }
+    , m_size_y { extends.y }
+    , m_size_z { extends.z }
+    , m_components { volume.m_components }
+    , m_scale_x { volume.m_scale_x }
+    , m_scale_y { volume.m_scale_y }
+    , m_scale_z { volume.m_scale_z }
+{
+    if (extends.x == 0 || extends.y == 0 || extends.z == 0) {
+        throw std::invalid_argument("resampled volume must not be empty");
     }
 
-    // Find the minimum/maximum of all components.
-    for (std::size_t i { 0 }; i < data_size; ++i) {
-        float value { static_cast<float>(data[i]) };
-        std::size_t component_idx { this->m_components - (i % this->m_components) - 1 };
-        glm::vec2& component { this->m_component_ranges[component_idx] };
-        component.x = std::min({ component.x, value });
-        component.y = std::max({ component.y, value });
+    std::copy_n(volume.m_component_ranges.get(), volume.m_components, this->m_component_ranges.get());
+    this->m_scale_x *= static_cast<float>(volume.m_size_x) / static_cast<float>(extends.x);
+    this->m_scale_y *= static_cast<float>(volume.m_size_y) / static_cast<float>(extends.y);
+    this->m_scale_z *= static_cast<float>(volume.m_size_z) / static_cast<float>(extends.z);
+
+    // Filter the most reduced axes first, so the intermediate volumes stay small.
+    std::array<std::size_t, 3> sizes { volume.m_size_x, volume.m_size_y, volume.m_size_z };
+    std::array<std::size_t, 3> axes { 0, 1, 2 };
+    std::sort(axes.begin(), axes.end(), [&](std::size_t a, std::size_t b) {
+        return static_cast<double>(extends[a]) / static_cast<double>(sizes[a])
+            < static_cast<double>(extends[b]) / static_cast<double>(sizes[b]);
+    });
+
+    std::size_t data_size { extends.x * extends.y * extends.z * this->m_components };
+    this->m_data_memory.resize(data_size * sizeof(float));
+    std::unique_ptr<float[]> current {};
+    const float* input { volume.m_data.get() };
+    for (std::size_t axis : axes) {
+        if (sizes[axis] == extends[axis]) {
+            continue;
+        }
+
+        std::size_t inner { this->m_components };
+        for (std::size_t a { 0 }; a < axis; ++a) {
+            inner *= sizes[a];
+        }
+        std::size_t outer { 1 };
+        for (std::size_t a { axis + 1 }; a < 3; ++a) {
+            outer *= sizes[a];
+        }
+
+        std::unique_ptr<float[]> filtered { new float[outer * extends[axis] * inner] };
+        filter_axis(input, filtered.get(), outer, inner, sizes[axis], box_filter(sizes[axis], extends[axis]));
+        sizes[axis] = extends[axis];
+        current = std::move(filtered);
+        input = current.get();
     }
 
-    // Normalize the values.
-    for (std::size_t i { 0 }; i < data_size; ++i) {
-        float value { static_cast<float>(data[i]) };
-        std::size_t component_idx { this->m_components - (i % this->m_components) - 1 };
-        glm::vec2& component { this->m_component_ranges[component_idx] };
-        float min = component.x;
-        float max = component.y;
+    if (current) {
+        this->m_data = std::move(current);
+    } else {
+        this->m_data.reset(new float[data_size]);
+        std::copy_n(volume.m_data.get(), data_size, this->m_data.get());
+    }
+}
 
-        float normalized = (value - min) / (max - min);
-        this->m_data[i] = normalized;
+PVMVolume::PVMVolume(const PlanarVolume& volume)
+    : m_component_ranges { new glm::vec2[volume.components()] }
+    , m_data { new float[volume.voxel_count() * volume.components()] }
+    , m_data_memory { MemoryTag::VolumeData, volume.voxel_count() * volume.components() * sizeof(float) }
+    , m_name {}
+    , m_size_x { volume.extends().x }
+    , m_size_y { volume.extends().y }
+    , m_size_z { volume.extends().z }
+    , m_components { volume.components() }
+    , m_scale_x { volume.scale().x }
+    , m_scale_y { volume.scale().y }
+    , m_scale_z { volume.scale().z }
+{
+    for (std::size_t c { 0 }; c < this->m_components; ++c) {
+        this->m_component_ranges[c] = volume.component_range(c);
     }
+    volume.interleave(std::span { this->m_data.get(), volume.voxel_count() * this->m_components });
 }
 
 PVMVolume::PVMVolume(const PVMVolume& volume)
     : m_component_ranges { new glm::vec2[volume.m_components] }
     , m_data { new float[volume.m_size_x * volume.m_size_y * volume.m_size_z * volume.m_components] }
+    , m_data_memory { MemoryTag::VolumeData, volume.byte_size() }
     , m_name { volume.m_name }
     , m_size_x { volume.m_size_x }
     , m_size_y { volume.m_size_y }
@@ -107,6 +404,7 @@ PVMVolume& PVMVolume::operator=(const PVMVolume& volume)
         size_t current_size { this->m_size_x * this->m_size_y * this->m_size_z * this->m_components };
         if (current_size != data_size) {
             this->m_data.reset(new float[data_size]);
+            this->m_data_memory.resize(data_size * sizeof(float));
         }
         std::copy_n(volume.m_data.get(), data_size, this->m_data.get());
 
@@ -236,3 +534,26 @@ float PVMVolume::voxel_normalized(std::size_t x, std::size_t y, std::size_t z, s
     std::size_t component_index { voxel_index + (this->m_components - 1 - component) };
     return this->m_data[component_index];
 }
+
+glm::vec2 PVMVolume::component_range(std::size_t component) const
+{
+    if (component >= this->m_components) {
+        throw std::out_of_range("component index out of range");
+    }
+    return this->m_component_ranges[component];
+}
+
+const float* PVMVolume::data() const
+{
+    return this->m_data.get();
+}
+
+VolumeView<const float> PVMVolume::view() const
+{
+    return VolumeView<const float> { this->m_data.get(), this->extends(), this->m_components };
+}
+
+std::size_t PVMVolume::byte_size() const
+{
+    return this->m_size_x * this->m_size_y * this->m_size_z * this->m_components * sizeof(float);
+}
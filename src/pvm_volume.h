@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <filesystem>
 #include <memory>
@@ -9,12 +10,74 @@
 #include <glm/glm.hpp>
 #pragma warning(pop)
 
+#include <memory_tracker.h>
+#include <volume_view.h>
+
+/**
+ * Progress counters of a volume load.
+ *
+ * The counters are updated by the loading thread and may be read from any
+ * other thread. Setting `cancel_requested` aborts the load at the next
+ * checkpoint.
+ */
+struct PVMLoadProgress {
+    std::atomic<std::size_t> bytes_total { 0 };
+    std::atomic<std::size_t> bytes_read { 0 };
+    std::atomic<std::size_t> bytes_decoded { 0 };
+    std::atomic<std::size_t> voxels_total { 0 };
+    std::atomic<std::size_t> voxels_normalized { 0 };
+    std::atomic<bool> cancel_requested { false };
+};
+
+/**
+ * Axis-aligned box of voxels.
+ */
+struct PVMRegion {
+    glm::vec<3, std::size_t> offset;
+    glm::vec<3, std::size_t> extends;
+};
+
+class PlanarVolume;
+
 /**
  * Simple helper class for loading and handling PVM volumes.
  */
 class PVMVolume {
 public:
-    PVMVolume(const std::filesystem::path& volume_path);
+    /**
+     * Loads a PVM volume from disk.
+     * @param volume_path path to the volume
+     * @param progress optional progress counters, updated while loading
+     */
+    PVMVolume(const std::filesystem::path& volume_path, PVMLoadProgress* progress = nullptr);
+
+    /**
+     * Loads a region of a PVM volume from disk.
+     * Only the voxels inside the region are kept, and decoding stops after
+     * its last slice. The value ranges are the ones of the region.
+     * @param volume_path path to the volume
+     * @param region region to load, clamped to the volume
+     * @param progress optional progress counters, updated while loading
+     */
+    PVMVolume(const std::filesystem::path& volume_path, const PVMRegion& region, PVMLoadProgress* progress = nullptr);
+
+    /**
+     * Resamples a volume to different extends.
+     * Each new voxel is the average of the source voxels it overlaps, weighted
+     * by the overlap. The axes are filtered one after another on the workers
+     * of the calling `TaskScheduler`. The voxels keep covering the same
+     * physical box, so the scale of each axis grows with its reduction, and
+     * the value ranges are kept.
+     * @param volume resampled volume
+     * @param extends number of voxels in each direction, each at least 1
+     */
+    PVMVolume(const PVMVolume& volume, glm::vec<3, std::size_t> extends);
+
+    /**
+     * Converts a volume with the planar layout into the interleaved one.
+     * @param volume converted volume
+     */
+    explicit PVMVolume(const PlanarVolume& volume);
     PVMVolume(const PVMVolume&);
     PVMVolume(PVMVolume&&) noexcept = default;
     ~PVMVolume() noexcept = default;
@@ -153,9 +216,37 @@ public:
      */
     float voxel_normalized(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const;
 
+    /**
+     * Returns the range of the non-normalized values of a component.
+     * @param component voxel component
+     * @return minimum (x) and maximum (y) value
+     */
+    glm::vec2 component_range(std::size_t component) const;
+
+    /**
+     * Returns the normalized voxel data.
+     * The components of each voxel are stored interleaved and in reversed order.
+     * @return voxel data
+     */
+    const float* data() const;
+
+    /**
+     * Returns a view of the normalized voxel data.
+     * Pass it to `visit_components` for kernels specialized for the component count.
+     * @return view of the voxel data
+     */
+    VolumeView<const float> view() const;
+
+    /**
+     * Returns the size of the normalized voxel data in bytes.
+     * @return data size
+     */
+    std::size_t byte_size() const;
+
 private:
     std::unique_ptr<glm::vec2[]> m_component_ranges;
     std::unique_ptr<float[]> m_data;
+    TrackedAllocation m_data_memory;
     std::string m_name;
     std::size_t m_size_x;
     std::size_t m_size_y;
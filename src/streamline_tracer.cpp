@@ -0,0 +1,284 @@
+#include <streamline_tracer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <random>
+#include <stdexcept>
+
+#include <task_scheduler.h>
+
+namespace {
+
+// Number of seeds traced by each task. The line lengths vary a lot, so the
+// batches are small enough for idle workers to steal the remaining ones.
+constexpr std::size_t seeds_per_task { 16 };
+
+struct Polyline {
+    std::vector<glm::vec3> positions;
+    std::vector<float> speeds;
+};
+
+// Normalized direction of the field, or nothing at critical points and outside of the volume.
+std::optional<glm::vec3> direction(const VectorFieldSampler& sampler, glm::vec3 position, float sign, float min_speed)
+{
+    if (!sampler.contains(position)) {
+        return std::nullopt;
+    }
+    glm::vec3 vector { sampler.sample(position) };
+    float speed { glm::length(vector) };
+    if (!(speed > min_speed)) {
+        return std::nullopt;
+    }
+    return vector * (sign / speed);
+}
+
+std::optional<glm::vec3> rk4_step(const VectorFieldSampler& sampler, glm::vec3 position, float step, float sign, float min_speed)
+{
+    auto k1 = direction(sampler, position, sign, min_speed);
+    if (!k1) {
+        return std::nullopt;
+    }
+    auto k2 = direction(sampler, position + *k1 * (0.5f * step), sign, min_speed);
+    if (!k2) {
+        return std::nullopt;
+    }
+    auto k3 = direction(sampler, position + *k2 * (0.5f * step), sign, min_speed);
+    if (!k3) {
+        return std::nullopt;
+    }
+    auto k4 = direction(sampler, position + *k3 * step, sign, min_speed);
+    if (!k4) {
+        return std::nullopt;
+    }
+    return position + (*k1 + 2.0f * *k2 + 2.0f * *k3 + *k4) * (step / 6.0f);
+}
+
+// Integrates in one direction, appending the points after the seed.
+void integrate(const VectorFieldSampler& sampler, glm::vec3 seed, float sign, const StreamlineParameters& parameters,
+    std::size_t max_points, Polyline& line)
+{
+    glm::vec3 position { seed };
+    float step { std::clamp(parameters.initial_step, parameters.min_step, parameters.max_step) };
+    float length { 0.0f };
+
+    while (line.positions.size() < max_points && length < parameters.max_length) {
+        auto full = rk4_step(sampler, position, step, sign, parameters.min_speed);
+        auto half = rk4_step(sampler, position, 0.5f * step, sign, parameters.min_speed);
+        std::optional<glm::vec3> next {};
+        if (half) {
+            next = rk4_step(sampler, *half, 0.5f * step, sign, parameters.min_speed);
+        }
+
+        if (!full || !next) {
+            // The step left the volume or hit a critical point, retry closer to it.
+            if (step <= parameters.min_step) {
+                return;
+            }
+            step = std::max(0.5f * step, parameters.min_step);
+            continue;
+        }
+
+        // The local error of RK4 is of fifth order, the difference of both
+        // estimates is 15 times the error of the two half steps.
+        float error { glm::length(*next - *full) / 15.0f };
+        if (error > parameters.tolerance && step > parameters.min_step) {
+            float factor { std::max(0.9f * std::pow(parameters.tolerance / error, 0.2f), 0.2f) };
+            step = std::max(step * factor, parameters.min_step);
+            continue;
+        }
+
+        length += glm::length(*next - position);
+        position = *next;
+        line.positions.push_back(position);
+        line.speeds.push_back(glm::length(sampler.sample(position)));
+
+        float factor { error > 0.0f ? std::min(0.9f * std::pow(parameters.tolerance / error, 0.2f), 4.0f) : 4.0f };
+        step = std::clamp(step * factor, parameters.min_step, parameters.max_step);
+    }
+}
+
+Polyline trace_line(const VectorFieldSampler& sampler, glm::vec3 seed, const StreamlineParameters& parameters)
+{
+    Polyline line {};
+    if (!sampler.contains(seed)) {
+        line.positions.push_back(seed);
+        line.speeds.push_back(0.0f);
+        return line;
+    }
+
+    std::size_t max_points { std::max<std::size_t>(parameters.max_points, 1) };
+    if (parameters.direction != StreamlineDirection::Forward) {
+        integrate(sampler, seed, -1.0f, parameters, max_points - 1, line);
+        std::reverse(line.positions.begin(), line.positions.end());
+        std::reverse(line.speeds.begin(), line.speeds.end());
+    }
+    line.positions.push_back(seed);
+    line.speeds.push_back(glm::length(sampler.sample(seed)));
+    if (parameters.direction != StreamlineDirection::Backward) {
+        integrate(sampler, seed, 1.0f, parameters, max_points, line);
+    }
+    return line;
+}
+
+}
+
+VectorFieldSampler::VectorFieldSampler(const PVMVolume& volume, float offset)
+    : m_vectors(volume.size_x() * volume.size_y() * volume.size_z())
+    , m_vectors_memory { MemoryTag::Streamlines, volume.size_x() * volume.size_y() * volume.size_z() * sizeof(glm::vec3) }
+    , m_extends { volume.extends() }
+    , m_scale { volume.scale() }
+{
+    if (!volume.is_vector_field()) {
+        throw std::invalid_argument("streamlines require a vector field");
+    }
+
+    std::size_t components { volume.components() };
+    std::size_t vector_components { std::min<std::size_t>(components, 3) };
+    const float* data { volume.data() };
+    for (std::size_t c { 0 }; c < vector_components; ++c) {
+        // Components with a constant value are stored as NaN.
+        glm::vec2 range { volume.component_range(c) };
+        float extent { range.y - range.x };
+        std::size_t channel { components - 1 - c };
+        for (std::size_t i { 0 }; i < this->m_vectors.size(); ++i) {
+            float normalized { data[i * components + channel] };
+            float value { extent != 0.0f ? range.x + normalized * extent : range.x };
+            this->m_vectors[i][static_cast<int>(c)] = value - offset;
+        }
+    }
+}
+
+bool VectorFieldSampler::contains(glm::vec3 position) const
+{
+    glm::vec3 bounds { this->bounds() };
+    return position.x >= 0.0f && position.y >= 0.0f && position.z >= 0.0f
+        && position.x <= bounds.x && position.y <= bounds.y && position.z <= bounds.z;
+}
+
+glm::vec3 VectorFieldSampler::sample(glm::vec3 position) const
+{
+    // Voxel i covers [i * scale, (i + 1) * scale), so its center lies at (i + 0.5) * scale.
+    glm::vec3 coordinates { position / this->m_scale - 0.5f };
+    glm::vec<3, std::size_t> cell {};
+    glm::vec<3, std::size_t> next {};
+    glm::vec3 weights {};
+    for (int i { 0 }; i < 3; ++i) {
+        float clamped { std::clamp(coordinates[i], 0.0f, static_cast<float>(this->m_extends[i] - 1)) };
+        float floor { std::floor(clamped) };
+        cell[i] = static_cast<std::size_t>(floor);
+        next[i] = std::min(cell[i] + 1, this->m_extends[i] - 1);
+        weights[i] = clamped - floor;
+    }
+
+    std::size_t row { this->m_extends.x };
+    std::size_t slice { this->m_extends.x * this->m_extends.y };
+    auto at = [&](std::size_t x, std::size_t y, std::size_t z) { return this->m_vectors[x + y * row + z * slice]; };
+    glm::vec3 c00 { glm::mix(at(cell.x, cell.y, cell.z), at(next.x, cell.y, cell.z), weights.x) };
+    glm::vec3 c10 { glm::mix(at(cell.x, next.y, cell.z), at(next.x, next.y, cell.z), weights.x) };
+    glm::vec3 c01 { glm::mix(at(cell.x, cell.y, next.z), at(next.x, cell.y, next.z), weights.x) };
+    glm::vec3 c11 { glm::mix(at(cell.x, next.y, next.z), at(next.x, next.y, next.z), weights.x) };
+    return glm::mix(glm::mix(c00, c10, weights.y), glm::mix(c01, c11, weights.y), weights.z);
+}
+
+glm::vec3 VectorFieldSampler::bounds() const
+{
+    return glm::vec3 { this->m_extends } * this->m_scale;
+}
+
+std::size_t StreamlineBuffers::line_count() const
+{
+    return this->line_offsets.empty() ? 0 : this->line_offsets.size() - 1;
+}
+
+std::size_t StreamlineBuffers::point_count() const
+{
+    return this->position_x.size();
+}
+
+StreamlineTracer::StreamlineTracer(const PVMVolume& volume, float offset)
+    : m_sampler { volume, offset }
+{
+}
+
+StreamlineBuffers StreamlineTracer::trace(std::span<const glm::vec3> seeds, const StreamlineParameters& parameters) const
+{
+    if (!(parameters.min_step > 0.0f) || parameters.max_step < parameters.min_step || !(parameters.tolerance > 0.0f)) {
+        throw std::invalid_argument("invalid streamline step parameters");
+    }
+
+    std::vector<Polyline> lines(seeds.size());
+    glm::vec<3, std::size_t> extends { seeds.size(), 1, 1 };
+    TaskScheduler::current().parallel_for(extends, glm::vec<3, std::size_t> { seeds_per_task, 1, 1 }, [&](const PVMRegion& batch) {
+        for (std::size_t seed { batch.offset.x }; seed < batch.offset.x + batch.extends.x; ++seed) {
+            lines[seed] = trace_line(this->m_sampler, seeds[seed], parameters);
+        }
+    });
+
+    // Concatenate the lines in seed order.
+    StreamlineBuffers buffers {};
+    buffers.line_offsets.reserve(lines.size() + 1);
+    buffers.line_offsets.push_back(0);
+    std::size_t point_count { 0 };
+    for (const Polyline& line : lines) {
+        point_count += line.positions.size();
+        if (point_count > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::overflow_error("streamlines exceed 2^32 points");
+        }
+        buffers.line_offsets.push_back(static_cast<std::uint32_t>(point_count));
+    }
+
+    buffers.position_x.reserve(point_count);
+    buffers.position_y.reserve(point_count);
+    buffers.position_z.reserve(point_count);
+    buffers.speed.reserve(point_count);
+    for (const Polyline& line : lines) {
+        for (glm::vec3 position : line.positions) {
+            buffers.position_x.push_back(position.x);
+            buffers.position_y.push_back(position.y);
+            buffers.position_z.push_back(position.z);
+        }
+        buffers.speed.insert(buffers.speed.end(), line.speeds.begin(), line.speeds.end());
+    }
+    return buffers;
+}
+
+std::vector<glm::vec3> StreamlineTracer::grid_seeds(glm::vec<3, std::size_t> counts) const
+{
+    glm::vec3 bounds { this->m_sampler.bounds() };
+    std::vector<glm::vec3> seeds {};
+    seeds.reserve(counts.x * counts.y * counts.z);
+    for (std::size_t z { 0 }; z < counts.z; ++z) {
+        for (std::size_t y { 0 }; y < counts.y; ++y) {
+            for (std::size_t x { 0 }; x < counts.x; ++x) {
+                glm::vec3 cell { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) };
+                seeds.push_back((cell + 0.5f) / glm::vec3 { counts } * bounds);
+            }
+        }
+    }
+    return seeds;
+}
+
+std::vector<glm::vec3> StreamlineTracer::random_seeds(std::size_t count, std::uint32_t seed) const
+{
+    // The distributions of the standard library differ between
+    // implementations, so the conversion to floats is done by hand.
+    std::mt19937 generator { seed };
+    auto uniform = [&]() { return static_cast<float>(generator() >> 8) * (1.0f / 16777216.0f); };
+
+    glm::vec3 bounds { this->m_sampler.bounds() };
+    std::vector<glm::vec3> seeds(count);
+    for (glm::vec3& position : seeds) {
+        float x { uniform() };
+        float y { uniform() };
+        float z { uniform() };
+        position = glm::vec3 { x, y, z } * bounds;
+    }
+    return seeds;
+}
+
+const VectorFieldSampler& StreamlineTracer::sampler() const
+{
+    return this->m_sampler;
+}
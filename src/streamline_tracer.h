@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <memory_tracker.h>
+#include <pvm_volume.h>
+
+/**
+ * Trilinear sampler of the vectors of a vector-field volume.
+ *
+ * The first three components are interpreted as the x, y and z coordinates
+ * of a vector, missing ones are zero. The vectors are mapped back to their
+ * original value ranges and stored interleaved, so a sample fetches 8
+ * contiguous vectors. Positions are physical, like `voxel_position_center`.
+ */
+class VectorFieldSampler {
+public:
+    /**
+     * Creates a sampler for a volume.
+     * @param volume vector field with at least two components
+     * @param offset value subtracted from each component, e.g. 127.5 for signed vectors stored as bytes
+     */
+    VectorFieldSampler(const PVMVolume& volume, float offset = 0.0f);
+    VectorFieldSampler(const VectorFieldSampler&) = default;
+    VectorFieldSampler(VectorFieldSampler&&) noexcept = default;
+    ~VectorFieldSampler() = default;
+
+    VectorFieldSampler& operator=(const VectorFieldSampler&) = default;
+    VectorFieldSampler& operator=(VectorFieldSampler&&) noexcept = default;
+
+    /**
+     * Checks if a position lies inside of the volume.
+     * @param position physical position
+     * @return position is inside
+     */
+    bool contains(glm::vec3 position) const;
+
+    /**
+     * Interpolates the vector at a position.
+     * Positions between the outermost voxel centers and the volume border
+     * take the value of the border voxels.
+     * @param position physical position inside of the volume
+     * @return interpolated vector
+     */
+    glm::vec3 sample(glm::vec3 position) const;
+
+    /**
+     * Returns the physical size of the volume.
+     * @return size of the volume
+     */
+    glm::vec3 bounds() const;
+
+private:
+    std::vector<glm::vec3> m_vectors;
+    TrackedAllocation m_vectors_memory;
+    glm::vec<3, std::size_t> m_extends;
+    glm::vec3 m_scale;
+};
+
+/**
+ * Directions in which streamlines are traced from their seeds.
+ */
+enum class StreamlineDirection {
+    Forward,
+    Backward,
+    Both,
+};
+
+/**
+ * Parameters of the streamline integration.
+ *
+ * Streamlines are parametrized by arc length, so all steps and lengths are
+ * physical distances.
+ */
+struct StreamlineParameters {
+    StreamlineDirection direction { StreamlineDirection::Both };
+    float initial_step { 0.5f };
+    float min_step { 0.01f };
+    float max_step { 2.0f };
+    float tolerance { 1e-3f };
+    float max_length { 1e4f };
+    float min_speed { 1e-6f };
+    std::size_t max_points { 2048 };
+};
+
+/**
+ * Traced streamlines, stored as structure of arrays for the upload into
+ * vertex or storage buffers.
+ *
+ * The points of line `i` are `line_offsets[i]` to `line_offsets[i + 1] - 1`.
+ * Line `i` belongs to seed `i`, and runs from its backward to its forward end.
+ * The offsets are 32-bit like GPU indices, so all lines together are limited
+ * to 2^32 - 1 points.
+ */
+struct StreamlineBuffers {
+    std::vector<float> position_x;
+    std::vector<float> position_y;
+    std::vector<float> position_z;
+    std::vector<float> speed;
+    std::vector<std::uint32_t> line_offsets;
+
+    /**
+     * Returns the number of lines.
+     * @return line count
+     */
+    std::size_t line_count() const;
+
+    /**
+     * Returns the number of points of all lines.
+     * @return point count
+     */
+    std::size_t point_count() const;
+};
+
+/**
+ * Traces streamlines through a vector field on multiple threads.
+ *
+ * Each streamline is integrated with the classic Runge-Kutta method of
+ * fourth order. The step size is adapted by step doubling, comparing a full
+ * step with two half steps. Since the lengths of the lines vary a lot, the
+ * seeds are traced in small batches on the workers of the calling
+ * `TaskScheduler`, whose idle workers steal the batches of busy ones. Each
+ * line only depends on its seed, so the result does not depend on the
+ * thread count or scheduling.
+ */
+class StreamlineTracer {
+public:
+    /**
+     * Creates a tracer for a volume.
+     * @param volume vector field with at least two components
+     * @param offset value subtracted from each component, e.g. 127.5 for signed vectors stored as bytes
+     */
+    StreamlineTracer(const PVMVolume& volume, float offset = 0.0f);
+    StreamlineTracer(const StreamlineTracer&) = default;
+    StreamlineTracer(StreamlineTracer&&) noexcept = default;
+    ~StreamlineTracer() = default;
+
+    StreamlineTracer& operator=(const StreamlineTracer&) = default;
+    StreamlineTracer& operator=(StreamlineTracer&&) noexcept = default;
+
+    /**
+     * Traces a streamline from each seed.
+     * Seeds outside of the volume produce lines with a single point.
+     * Throws `std::overflow_error` if the lines exceed the 32-bit offsets.
+     * @param seeds physical seed positions
+     * @param parameters integration parameters
+     * @return traced lines
+     */
+    StreamlineBuffers trace(std::span<const glm::vec3> seeds, const StreamlineParameters& parameters) const;
+
+    /**
+     * Places seeds on a regular grid covering the volume.
+     * @param counts number of seeds along each axis
+     * @return seed positions
+     */
+    std::vector<glm::vec3> grid_seeds(glm::vec<3, std::size_t> counts) const;
+
+    /**
+     * Places uniformly distributed random seeds inside of the volume.
+     * @param count number of seeds
+     * @param seed seed of the random number generator
+     * @return seed positions
+     */
+    std::vector<glm::vec3> random_seeds(std::size_t count, std::uint32_t seed = 0) const;
+
+    const VectorFieldSampler& sampler() const;
+
+private:
+    VectorFieldSampler m_sampler;
+};
@@ -0,0 +1,392 @@
+#include <task_scheduler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+namespace {
+
+thread_local TaskScheduler* current_scheduler { nullptr };
+thread_local std::size_t current_worker { 0 };
+
+bool is_done(TaskStatus status)
+{
+    return status == TaskStatus::Finished || status == TaskStatus::Failed || status == TaskStatus::Cancelled;
+}
+
+}
+
+struct TaskHandle::State {
+    TaskScheduler* scheduler;
+    std::function<void()> function;
+    std::shared_ptr<std::atomic<bool>> cancel_requested;
+    std::atomic<TaskStatus> status { TaskStatus::Waiting };
+    std::atomic<std::size_t> pending_dependencies { 1 };
+    mutable std::mutex mutex;
+    mutable std::condition_variable condition;
+    std::vector<std::shared_ptr<State>> dependents;
+    std::exception_ptr error;
+    std::exception_ptr dependency_error;
+    bool dependency_cancelled { false };
+};
+
+TaskHandle::TaskHandle(std::shared_ptr<State> state)
+    : m_state { std::move(state) }
+{
+}
+
+bool TaskHandle::valid() const
+{
+    return this->m_state != nullptr;
+}
+
+TaskStatus TaskHandle::status() const
+{
+    if (!this->m_state) {
+        return TaskStatus::Failed;
+    }
+    return this->m_state->status;
+}
+
+bool TaskHandle::done() const
+{
+    return is_done(this->status());
+}
+
+void TaskHandle::cancel()
+{
+    if (this->m_state) {
+        *this->m_state->cancel_requested = true;
+    }
+}
+
+void TaskHandle::wait() const
+{
+    if (!this->m_state) {
+        return;
+    }
+
+    // A waiting worker keeps running tasks, otherwise a task waiting for the
+    // tasks it spawned could occupy the last free worker.
+    TaskScheduler* scheduler { this->m_state->scheduler };
+    if (current_scheduler == scheduler) {
+        while (!this->done()) {
+            if (!scheduler->run_one(current_worker)) {
+                std::unique_lock lock { this->m_state->mutex };
+                this->m_state->condition.wait_for(lock, std::chrono::milliseconds { 1 }, [this]() { return this->done(); });
+            }
+        }
+        return;
+    }
+
+    std::unique_lock lock { this->m_state->mutex };
+    this->m_state->condition.wait(lock, [this]() { return this->done(); });
+}
+
+void TaskHandle::get() const
+{
+    if (!this->m_state) {
+        throw std::runtime_error("invalid task handle");
+    }
+
+    this->wait();
+    std::scoped_lock lock { this->m_state->mutex };
+    if (this->m_state->error) {
+        std::rethrow_exception(this->m_state->error);
+    }
+    if (this->m_state->status == TaskStatus::Cancelled) {
+        throw std::runtime_error("task cancelled");
+    }
+}
+
+glm::vec<3, std::size_t> z_slabs(glm::vec<3, std::size_t> extends, std::size_t depth)
+{
+    return glm::vec<3, std::size_t> { std::max<std::size_t>(extends.x, 1), std::max<std::size_t>(extends.y, 1),
+        std::max<std::size_t>(depth, 1) };
+}
+
+glm::vec<3, std::size_t> bricks(std::size_t size)
+{
+    return glm::vec<3, std::size_t> { std::max<std::size_t>(size, 1) };
+}
+
+TaskScheduler::TaskScheduler(std::size_t thread_count)
+    : m_queues {}
+    , m_threads {}
+    , m_queued { 0 }
+    , m_next_queue { 0 }
+    , m_mutex {}
+    , m_condition {}
+    , m_stop { false }
+{
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (std::size_t i { 0 }; i < thread_count; ++i) {
+        this->m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (std::size_t i { 0 }; i < thread_count; ++i) {
+        this->m_threads.emplace_back([this, i]() { this->work(i); });
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::scoped_lock lock { this->m_mutex };
+        this->m_stop = true;
+    }
+    this->m_condition.notify_all();
+
+    for (auto& thread : this->m_threads) {
+        thread.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::shared()
+{
+    static TaskScheduler scheduler {};
+    return scheduler;
+}
+
+TaskScheduler& TaskScheduler::current()
+{
+    return current_scheduler ? *current_scheduler : TaskScheduler::shared();
+}
+
+TaskHandle TaskScheduler::submit(std::function<void()> function, std::span<const TaskHandle> dependencies)
+{
+    return this->create(std::move(function), std::make_shared<std::atomic<bool>>(false), dependencies);
+}
+
+TaskHandle TaskScheduler::parallel_for_async(glm::vec<3, std::size_t> extends, glm::vec<3, std::size_t> block,
+    std::function<void(const PVMRegion& block)> function, std::span<const TaskHandle> dependencies)
+{
+    if (block.x == 0 || block.y == 0 || block.z == 0) {
+        throw std::invalid_argument("parallel_for requires non-empty blocks");
+    }
+
+    // All blocks share the cancellation flag of the returned handle.
+    auto cancel_requested = std::make_shared<std::atomic<bool>>(false);
+    auto body = std::make_shared<const std::function<void(const PVMRegion&)>>(std::move(function));
+    std::vector<TaskHandle> blocks {};
+    glm::vec<3, std::size_t> offset { 0 };
+    for (offset.z = 0; offset.z < extends.z; offset.z += block.z) {
+        for (offset.y = 0; offset.y < extends.y; offset.y += block.y) {
+            for (offset.x = 0; offset.x < extends.x; offset.x += block.x) {
+                PVMRegion region { offset, glm::min(block, extends - offset) };
+                blocks.push_back(this->create(
+                    [body, cancel_requested, region]() {
+                        try {
+                            (*body)(region);
+                        } catch (...) {
+                            *cancel_requested = true;
+                            throw;
+                        }
+                    },
+                    cancel_requested, dependencies));
+            }
+        }
+    }
+
+    if (blocks.empty()) {
+        return this->create([]() {}, cancel_requested, dependencies);
+    }
+    return this->create([]() {}, cancel_requested, blocks);
+}
+
+void TaskScheduler::parallel_for(glm::vec<3, std::size_t> extends, glm::vec<3, std::size_t> block,
+    const std::function<void(const PVMRegion& block)>& function)
+{
+    this->parallel_for_async(extends, block, function).get();
+}
+
+std::size_t TaskScheduler::thread_count() const
+{
+    return this->m_threads.size();
+}
+
+TaskHandle TaskScheduler::create(std::function<void()> function, std::shared_ptr<std::atomic<bool>> cancel_requested,
+    std::span<const TaskHandle> dependencies)
+{
+    auto state = std::make_shared<TaskHandle::State>();
+    state->scheduler = this;
+    state->function = std::move(function);
+    state->cancel_requested = std::move(cancel_requested);
+
+    // The extra pending dependency keeps the task from starting before all
+    // dependencies are registered.
+    std::size_t pending { 1 };
+    for (const TaskHandle& dependency : dependencies) {
+        pending += dependency.valid() ? 1 : 0;
+    }
+    state->pending_dependencies = pending;
+
+    for (const TaskHandle& dependency : dependencies) {
+        if (!dependency.valid()) {
+            continue;
+        }
+
+        TaskHandle::State& dependency_state { *dependency.m_state };
+        std::unique_lock lock { dependency_state.mutex };
+        TaskStatus status { dependency_state.status };
+        if (!is_done(status)) {
+            dependency_state.dependents.push_back(state);
+            continue;
+        }
+
+        std::exception_ptr error { dependency_state.error };
+        lock.unlock();
+        {
+            std::scoped_lock state_lock { state->mutex };
+            if (error && !state->dependency_error) {
+                state->dependency_error = error;
+            }
+            state->dependency_cancelled = state->dependency_cancelled || status == TaskStatus::Cancelled;
+        }
+        this->release(state);
+    }
+    this->release(state);
+    return TaskHandle { std::move(state) };
+}
+
+void TaskScheduler::release(const std::shared_ptr<TaskHandle::State>& state)
+{
+    if (state->pending_dependencies.fetch_sub(1) != 1) {
+        return;
+    }
+
+    std::exception_ptr error {};
+    bool cancelled {};
+    {
+        std::scoped_lock lock { state->mutex };
+        error = state->dependency_error;
+        cancelled = state->dependency_cancelled;
+    }
+
+    if (error) {
+        this->complete(state, TaskStatus::Failed, error);
+    } else if (cancelled || *state->cancel_requested) {
+        this->complete(state, TaskStatus::Cancelled, nullptr);
+    } else {
+        this->enqueue(state);
+    }
+}
+
+void TaskScheduler::enqueue(std::shared_ptr<TaskHandle::State> state)
+{
+    // Workers keep spawned tasks local, other threads spread them over all queues.
+    std::size_t queue { current_scheduler == this ? current_worker : this->m_next_queue++ % this->m_queues.size() };
+    state->status = TaskStatus::Queued;
+    {
+        std::scoped_lock lock { this->m_mutex };
+        ++this->m_queued;
+    }
+    {
+        WorkerQueue& worker_queue { *this->m_queues[queue] };
+        std::scoped_lock lock { worker_queue.mutex };
+        worker_queue.tasks.push_back(std::move(state));
+    }
+    this->m_condition.notify_one();
+}
+
+void TaskScheduler::complete(const std::shared_ptr<TaskHandle::State>& state, TaskStatus status, std::exception_ptr error)
+{
+    // The function is destroyed after the lock is released, its captures may be arbitrary.
+    std::function<void()> function {};
+    std::vector<std::shared_ptr<TaskHandle::State>> dependents {};
+    {
+        std::scoped_lock lock { state->mutex };
+        function = std::move(state->function);
+        state->error = error;
+        state->status = status;
+        dependents = std::move(state->dependents);
+    }
+    state->condition.notify_all();
+
+    for (const auto& dependent : dependents) {
+        {
+            std::scoped_lock lock { dependent->mutex };
+            if (error && !dependent->dependency_error) {
+                dependent->dependency_error = error;
+            }
+            dependent->dependency_cancelled = dependent->dependency_cancelled || status == TaskStatus::Cancelled;
+        }
+        this->release(dependent);
+    }
+}
+
+std::shared_ptr<TaskHandle::State> TaskScheduler::take(std::size_t worker)
+{
+    // The own queue is used as a stack, so a worker continues with the tasks
+    // it spawned last while their data is still in its cache.
+    {
+        WorkerQueue& own { *this->m_queues[worker] };
+        std::scoped_lock lock { own.mutex };
+        if (!own.tasks.empty()) {
+            auto state = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --this->m_queued;
+            return state;
+        }
+    }
+
+    // Steal the oldest task of the other workers, starting with the next one.
+    for (std::size_t offset { 1 }; offset < this->m_queues.size(); ++offset) {
+        WorkerQueue& victim { *this->m_queues[(worker + offset) % this->m_queues.size()] };
+        std::scoped_lock lock { victim.mutex };
+        if (!victim.tasks.empty()) {
+            auto state = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --this->m_queued;
+            return state;
+        }
+    }
+    return nullptr;
+}
+
+void TaskScheduler::run(const std::shared_ptr<TaskHandle::State>& state)
+{
+    if (*state->cancel_requested) {
+        this->complete(state, TaskStatus::Cancelled, nullptr);
+        return;
+    }
+
+    state->status = TaskStatus::Running;
+    std::exception_ptr error {};
+    try {
+        state->function();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    this->complete(state, error ? TaskStatus::Failed : TaskStatus::Finished, error);
+}
+
+bool TaskScheduler::run_one(std::size_t worker)
+{
+    auto state = this->take(worker);
+    if (!state) {
+        return false;
+    }
+    this->run(state);
+    return true;
+}
+
+void TaskScheduler::work(std::size_t worker)
+{
+    current_scheduler = this;
+    current_worker = worker;
+    while (true) {
+        if (this->run_one(worker)) {
+            continue;
+        }
+
+        std::unique_lock lock { this->m_mutex };
+        this->m_condition.wait(lock, [this]() { return this->m_stop || this->m_queued != 0; });
+        if (this->m_stop && this->m_queued == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <pvm_volume.h>
+
+/**
+ * State of a scheduled task.
+ */
+enum class TaskStatus {
+    Waiting,
+    Queued,
+    Running,
+    Finished,
+    Failed,
+    Cancelled,
+};
+
+class TaskScheduler;
+
+/**
+ * Handle to a task of a `TaskScheduler`.
+ *
+ * The handle is cheap to copy and may be polled every frame. Cancelling a
+ * task keeps it from starting, a running task is finished. Tasks depending
+ * on a cancelled task are cancelled as well, tasks depending on a failed
+ * task fail with its error.
+ */
+class TaskHandle {
+public:
+    TaskHandle() = default;
+    TaskHandle(const TaskHandle&) = default;
+    TaskHandle(TaskHandle&&) noexcept = default;
+    ~TaskHandle() noexcept = default;
+
+    TaskHandle& operator=(const TaskHandle&) = default;
+    TaskHandle& operator=(TaskHandle&&) noexcept = default;
+
+    /**
+     * Checks if the handle refers to a task.
+     * @return handle refers to a task
+     */
+    bool valid() const;
+
+    /**
+     * Returns the current state of the task.
+     * @return task state
+     */
+    TaskStatus status() const;
+
+    /**
+     * Checks if the task has finished, failed or was cancelled.
+     * @return task is done
+     */
+    bool done() const;
+
+    /**
+     * Requests the cancellation of the task.
+     */
+    void cancel();
+
+    /**
+     * Blocks until the task is done.
+     * Workers of the scheduler run other tasks while waiting, so tasks may
+     * wait for the tasks they spawn.
+     */
+    void wait() const;
+
+    /**
+     * Waits for the task and rethrows its error.
+     * Throws `std::runtime_error` if the task was cancelled.
+     */
+    void get() const;
+
+private:
+    friend class TaskScheduler;
+    struct State;
+
+    explicit TaskHandle(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> m_state;
+};
+
+/**
+ * Number of voxels normalized by each task of a volume load.
+ */
+constexpr std::size_t normalization_slab_voxels { std::size_t { 1 } << 18 };
+
+/**
+ * Returns the block size splitting a volume into z-slabs.
+ * @param extends extends of the volume
+ * @param depth number of slices of each slab
+ * @return block size for `TaskScheduler::parallel_for`
+ */
+glm::vec<3, std::size_t> z_slabs(glm::vec<3, std::size_t> extends, std::size_t depth = 1);
+
+/**
+ * Returns the block size splitting a volume into cubic bricks.
+ * @param size number of voxels along each edge of a brick
+ * @return block size for `TaskScheduler::parallel_for`
+ */
+glm::vec<3, std::size_t> bricks(std::size_t size);
+
+/**
+ * Work-stealing pool of worker threads shared by the volume processing.
+ *
+ * Each worker owns a queue. Tasks spawned by a worker are pushed to its own
+ * queue and taken back in reverse order, while idle workers steal the oldest
+ * tasks of the other queues. Tasks submitted from other threads are spread
+ * over the queues. Tasks may depend on other tasks and only start once all
+ * of them have finished.
+ */
+class TaskScheduler {
+public:
+    /**
+     * Starts the worker threads.
+     * @param thread_count number of workers, 0 uses the hardware concurrency
+     */
+    TaskScheduler(std::size_t thread_count = 0);
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler(TaskScheduler&&) = delete;
+
+    /**
+     * Runs the remaining tasks and stops the workers.
+     */
+    ~TaskScheduler();
+
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(TaskScheduler&&) = delete;
+
+    /**
+     * Returns the scheduler used by the application, with one worker per hardware thread.
+     * @return shared scheduler
+     */
+    static TaskScheduler& shared();
+
+    /**
+     * Returns the scheduler running the calling thread, so that nested work
+     * stays on the same workers.
+     * @return scheduler of the calling worker, or the shared scheduler
+     */
+    static TaskScheduler& current();
+
+    /**
+     * Enqueues a task.
+     * @param function work of the task
+     * @param dependencies tasks that have to finish before the task starts
+     * @return handle to the task
+     */
+    TaskHandle submit(std::function<void()> function, std::span<const TaskHandle> dependencies = {});
+
+    /**
+     * Enqueues a task and returns a future for its result.
+     * Errors of the function are stored in the future.
+     * @param function work of the task
+     * @return future of the result
+     */
+    template <typename Function>
+    std::future<std::invoke_result_t<Function&>> async(Function function)
+    {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Function&>()>>(std::move(function));
+        auto future = task->get_future();
+        this->submit([task]() { (*task)(); });
+        return future;
+    }
+
+    /**
+     * Enqueues a function for each block of a volume.
+     *
+     * The volume is split into blocks of the given size, the blocks at the
+     * upper borders are cropped. Each block is a separate task, so idle
+     * workers steal blocks from busy ones. Cancelling the returned handle
+     * cancels all blocks that did not start yet, and a failing block cancels
+     * the remaining ones.
+     * @param extends extends of the volume
+     * @param block size of each block, e.g. `z_slabs(extends)` or `bricks(32)`
+     * @param function work of each block
+     * @param dependencies tasks that have to finish before the first block starts
+     * @return handle to the completion of all blocks
+     */
+    TaskHandle parallel_for_async(glm::vec<3, std::size_t> extends, glm::vec<3, std::size_t> block,
+        std::function<void(const PVMRegion& block)> function, std::span<const TaskHandle> dependencies = {});
+
+    /**
+     * Calls a function for each block of a volume and waits for all of them.
+     * See `parallel_for_async`; rethrows the first error of a block.
+     * @param extends extends of the volume
+     * @param block size of each block
+     * @param function work of each block
+     */
+    void parallel_for(glm::vec<3, std::size_t> extends, glm::vec<3, std::size_t> block,
+        const std::function<void(const PVMRegion& block)>& function);
+
+    /**
+     * Returns the number of worker threads.
+     * @return number of workers
+     */
+    std::size_t thread_count() const;
+
+private:
+    friend class TaskHandle;
+
+    struct WorkerQueue {
+        std::deque<std::shared_ptr<TaskHandle::State>> tasks;
+        std::mutex mutex;
+    };
+
+    TaskHandle create(std::function<void()> function, std::shared_ptr<std::atomic<bool>> cancel_requested,
+        std::span<const TaskHandle> dependencies);
+    void release(const std::shared_ptr<TaskHandle::State>& state);
+    void enqueue(std::shared_ptr<TaskHandle::State> state);
+    void complete(const std::shared_ptr<TaskHandle::State>& state, TaskStatus status, std::exception_ptr error);
+    std::shared_ptr<TaskHandle::State> take(std::size_t worker);
+    void run(const std::shared_ptr<TaskHandle::State>& state);
+    bool run_one(std::size_t worker);
+    void work(std::size_t worker);
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<std::size_t> m_queued;
+    std::atomic<std::size_t> m_next_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop;
+};
@@ -0,0 +1,198 @@
+#include <volume_fit.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+VolumeDeviceLimits VolumeDeviceLimits::query(wgpu::Device& device)
+{
+    wgpu::SupportedLimits supported {};
+    if (!device.getLimits(&supported)) {
+        throw std::runtime_error("could not query the device limits");
+    }
+
+    return VolumeDeviceLimits {
+        static_cast<std::size_t>(supported.limits.maxTextureDimension3D),
+        static_cast<std::size_t>(supported.limits.maxBufferSize),
+    };
+}
+
+bool VolumeDeviceLimits::fits(glm::vec<3, std::size_t> extends, std::size_t components) const
+{
+    for (int i { 0 }; i < 3; ++i) {
+        if (extends[i] == 0 || extends[i] > this->max_texture_dimension) {
+            return false;
+        }
+    }
+    return extends.x * extends.y * extends.z * components * sizeof(float) <= this->max_texture_bytes;
+}
+
+glm::vec<3, std::size_t> fit_resolution(glm::vec<3, std::size_t> extends, glm::vec3 scale, std::size_t components,
+    const VolumeDeviceLimits& limits)
+{
+    if (limits.fits(extends, components)) {
+        return extends;
+    }
+
+    glm::dvec3 physical_size {};
+    for (int i { 0 }; i < 3; ++i) {
+        double spacing { scale[i] > 0.0f ? static_cast<double>(scale[i]) : 1.0 };
+        physical_size[i] = static_cast<double>(extends[i]) * spacing;
+    }
+
+    // Number of voxels along each axis when sampling it with a spacing.
+    auto extends_at = [&](double spacing) {
+        glm::vec<3, std::size_t> resampled {};
+        for (int i { 0 }; i < 3; ++i) {
+            auto count = static_cast<std::size_t>(std::ceil(physical_size[i] / spacing - 1e-9));
+            resampled[i] = std::clamp<std::size_t>(count, 1, std::min(extends[i], limits.max_texture_dimension));
+        }
+        return resampled;
+    };
+
+    // The number of voxels only shrinks with a growing spacing, so the
+    // smallest fitting spacing is found by bisection.
+    double low { std::min({ physical_size.x / static_cast<double>(extends.x), physical_size.y / static_cast<double>(extends.y),
+        physical_size.z / static_cast<double>(extends.z) }) };
+    double high { std::max({ physical_size.x, physical_size.y, physical_size.z }) };
+    if (!limits.fits(extends_at(high), components)) {
+        throw std::runtime_error("volume does not fit the device at any resolution");
+    }
+    for (int i { 0 }; i < 64; ++i) {
+        double spacing { 0.5 * (low + high) };
+        if (limits.fits(extends_at(spacing), components)) {
+            high = spacing;
+        } else {
+            low = spacing;
+        }
+    }
+    return extends_at(high);
+}
+
+std::vector<PVMRegion> split_regions(glm::vec<3, std::size_t> extends, std::size_t components,
+    const VolumeDeviceLimits& limits, std::size_t overlap)
+{
+    if (extends.x == 0 || extends.y == 0 || extends.z == 0) {
+        throw std::invalid_argument("cannot split an empty volume");
+    }
+
+    // Number of voxels owned by each region, and the extends of a region including the overlap.
+    glm::vec<3, std::size_t> core { extends };
+    auto region_extends = [&]() {
+        glm::vec<3, std::size_t> region {};
+        for (int i { 0 }; i < 3; ++i) {
+            region[i] = core[i] == extends[i] ? extends[i] : std::min(core[i] + overlap, extends[i]);
+        }
+        return region;
+    };
+
+    // Halve the longest region axis until a region fits.
+    while (!limits.fits(region_extends(), components)) {
+        glm::vec<3, std::size_t> region { region_extends() };
+        int axis { 0 };
+        for (int i { 1 }; i < 3; ++i) {
+            if (region[i] > region[axis]) {
+                axis = i;
+            }
+        }
+        if (core[axis] == 1) {
+            throw std::runtime_error("volume cannot be split to fit the device");
+        }
+        core[axis] = (core[axis] + 1) / 2;
+    }
+
+    glm::vec<3, std::size_t> counts {};
+    for (int i { 0 }; i < 3; ++i) {
+        counts[i] = (extends[i] + core[i] - 1) / core[i];
+    }
+
+    std::vector<PVMRegion> regions {};
+    regions.reserve(counts.x * counts.y * counts.z);
+    for (std::size_t z { 0 }; z < counts.z; ++z) {
+        for (std::size_t y { 0 }; y < counts.y; ++y) {
+            for (std::size_t x { 0 }; x < counts.x; ++x) {
+                glm::vec<3, std::size_t> offset { x * core.x, y * core.y, z * core.z };
+                glm::vec<3, std::size_t> size { glm::min(region_extends(), extends - offset) };
+                regions.push_back(PVMRegion { offset, size });
+            }
+        }
+    }
+    return regions;
+}
+
+std::shared_ptr<const PVMVolume> FittedVolume::texture_volume() const
+{
+    if (this->resampled) {
+        return this->resampled;
+    }
+    return this->regions.empty() ? this->original : nullptr;
+}
+
+FittedVolume fit_volume(std::shared_ptr<const PVMVolume> volume, const VolumeDeviceLimits& limits,
+    VolumeFitMode mode)
+{
+    if (!volume) {
+        throw std::invalid_argument("no volume to fit");
+    }
+
+    FittedVolume fitted { std::move(volume), nullptr, {} };
+    const PVMVolume& original { *fitted.original };
+    if (limits.fits(original.extends(), original.components())) {
+        return fitted;
+    }
+
+    switch (mode) {
+    case VolumeFitMode::Resample: {
+        auto extends = fit_resolution(original.extends(), original.scale(), original.components(), limits);
+        fitted.resampled = std::make_shared<const PVMVolume>(original, extends);
+        break;
+    }
+    case VolumeFitMode::Split:
+        fitted.regions = split_regions(original.extends(), original.components(), limits);
+        break;
+    }
+    return fitted;
+}
+
+VolumeBrickTextures::VolumeBrickTextures(wgpu::Device& device, const PVMVolume& volume, const std::vector<PVMRegion>& regions)
+    : m_regions { regions }
+    , m_textures {}
+{
+    auto queue = device.getQueue();
+    try {
+        for (const PVMRegion& region : this->m_regions) {
+            auto texture = std::make_unique<VolumeTexture>(device, region.extends, volume.components());
+            texture->upload(queue, volume, region.offset);
+            this->m_textures.push_back(std::move(texture));
+        }
+    } catch (...) {
+        queue.release();
+        throw;
+    }
+    queue.release();
+}
+
+std::size_t VolumeBrickTextures::size() const
+{
+    return this->m_textures.size();
+}
+
+const PVMRegion& VolumeBrickTextures::region(std::size_t index) const
+{
+    return this->m_regions.at(index);
+}
+
+VolumeTexture& VolumeBrickTextures::texture(std::size_t index)
+{
+    return *this->m_textures.at(index);
+}
+
+std::size_t VolumeBrickTextures::byte_size() const
+{
+    std::size_t size { 0 };
+    for (const auto& texture : this->m_textures) {
+        size += texture->byte_size();
+    }
+    return size;
+}
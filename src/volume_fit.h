@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <pvm_volume.h>
+#include <volume_texture.h>
+
+/**
+ * Limits of a device constraining the volume textures it can hold.
+ */
+struct VolumeDeviceLimits {
+    std::size_t max_texture_dimension;
+    std::size_t max_texture_bytes;
+
+    /**
+     * Queries the limits negotiated for a device.
+     * Volume uploads and read backs are staged through buffers, so a single
+     * texture may not exceed the maximum buffer size.
+     * @param device queried device
+     * @return limits of the device
+     */
+    static VolumeDeviceLimits query(wgpu::Device& device);
+
+    /**
+     * Checks if a volume fits into a single texture.
+     * @param extends number of voxels in each direction
+     * @param components number of components of each voxel
+     * @return volume fits
+     */
+    bool fits(glm::vec<3, std::size_t> extends, std::size_t components) const;
+};
+
+/**
+ * Ways of handling volumes exceeding the device limits.
+ */
+enum class VolumeFitMode {
+    Resample,
+    Split,
+};
+
+/**
+ * Finds the highest resolution of a volume fitting into a single texture.
+ *
+ * All axes are reduced to a common voxel spacing, so axes sampled finer than
+ * others lose resolution first and the resampled voxels become more
+ * isotropic. Axes coarser than the common spacing are kept.
+ * @param extends number of voxels in each direction
+ * @param scale size of a voxel
+ * @param components number of components of each voxel
+ * @param limits limits of the device
+ * @return extends of the resampled volume, or `extends` if it already fits
+ */
+glm::vec<3, std::size_t> fit_resolution(glm::vec<3, std::size_t> extends, glm::vec3 scale, std::size_t components,
+    const VolumeDeviceLimits& limits);
+
+/**
+ * Splits a volume into regions fitting into single textures.
+ *
+ * The longest region axis is halved until a region fits, so the regions stay
+ * close to cubes. Neighboring regions overlap, so that filtering at their borders matches the
+ * one of the whole volume.
+ * @param extends number of voxels in each direction
+ * @param components number of components of each voxel
+ * @param limits limits of the device
+ * @param overlap number of voxels shared by neighboring regions
+ * @return regions in x-fastest order
+ */
+std::vector<PVMRegion> split_regions(glm::vec<3, std::size_t> extends, std::size_t components,
+    const VolumeDeviceLimits& limits, std::size_t overlap = 1);
+
+/**
+ * Volume prepared for a device.
+ *
+ * The original volume is always kept for the analysis on the CPU. If it does
+ * not fit into a single texture, either a resampled copy or a list of regions
+ * for separate textures is provided for the GPU.
+ */
+struct FittedVolume {
+    std::shared_ptr<const PVMVolume> original;
+    std::shared_ptr<const PVMVolume> resampled;
+    std::vector<PVMRegion> regions;
+
+    /**
+     * Returns the volume to upload into a single texture.
+     * @return resampled volume, the original if it fits, or nullptr if it was split
+     */
+    std::shared_ptr<const PVMVolume> texture_volume() const;
+};
+
+/**
+ * Prepares a volume for a device.
+ * @param volume loaded volume
+ * @param limits limits of the device
+ * @param mode handling of volumes exceeding the limits
+ * @return prepared volume
+ */
+FittedVolume fit_volume(std::shared_ptr<const PVMVolume> volume, const VolumeDeviceLimits& limits,
+    VolumeFitMode mode);
+
+/**
+ * Textures holding the regions of a split volume.
+ */
+class VolumeBrickTextures {
+public:
+    /**
+     * Creates and uploads a texture for each region.
+     * @param device device owning the textures
+     * @param volume split volume
+     * @param regions regions of the volume
+     */
+    VolumeBrickTextures(wgpu::Device& device, const PVMVolume& volume, const std::vector<PVMRegion>& regions);
+    VolumeBrickTextures(const VolumeBrickTextures&) = delete;
+    VolumeBrickTextures(VolumeBrickTextures&&) = default;
+    ~VolumeBrickTextures() = default;
+
+    VolumeBrickTextures& operator=(const VolumeBrickTextures&) = delete;
+    VolumeBrickTextures& operator=(VolumeBrickTextures&&) = default;
+
+    /**
+     * Returns the number of textures.
+     * @return texture count
+     */
+    std::size_t size() const;
+
+    /**
+     * Returns the region of the volume held by a texture.
+     * @param index index of the texture
+     * @return region of the texture
+     */
+    const PVMRegion& region(std::size_t index) const;
+
+    /**
+     * Returns a texture.
+     * @param index index of the texture
+     * @return texture
+     */
+    VolumeTexture& texture(std::size_t index);
+
+    /**
+     * Returns the size of all textures in bytes.
+     * @return texture size
+     */
+    std::size_t byte_size() const;
+
+private:
+    std::vector<PVMRegion> m_regions;
+    std::vector<std::unique_ptr<VolumeTexture>> m_textures;
+};
@@ -0,0 +1,407 @@
+#include <volume_layout.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+#include <dds_codec.h>
+#include <task_scheduler.h>
+
+namespace {
+
+// Copies with a fixed number of components, so the inner loop is unrolled and
+// every voxel is read and written in a single pass.
+template <std::size_t Components>
+void deinterleave_fixed(const float* interleaved, std::size_t voxels, float* planes, std::size_t plane_stride)
+{
+    for (std::size_t i { 0 }; i < voxels; ++i) {
+        for (std::size_t c { 0 }; c < Components; ++c) {
+            planes[c * plane_stride + i] = interleaved[i * Components + (Components - 1 - c)];
+        }
+    }
+}
+
+template <std::size_t Components>
+void interleave_fixed(const float* planes, std::size_t plane_stride, std::size_t voxels, float* interleaved)
+{
+    for (std::size_t i { 0 }; i < voxels; ++i) {
+        for (std::size_t c { 0 }; c < Components; ++c) {
+            interleaved[i * Components + (Components - 1 - c)] = planes[c * plane_stride + i];
+        }
+    }
+}
+
+void check_component(std::size_t component, std::size_t components)
+{
+    if (component >= components) {
+        throw std::out_of_range("component index out of range");
+    }
+}
+
+}
+
+void deinterleave_components(std::span<const float> interleaved, std::size_t components, float* planes,
+    std::size_t plane_stride)
+{
+    if (components == 0) {
+        return;
+    }
+
+    std::size_t voxels { interleaved.size() / components };
+    switch (components) {
+    case 1:
+        std::copy_n(interleaved.data(), voxels, planes);
+        break;
+    case 2:
+        deinterleave_fixed<2>(interleaved.data(), voxels, planes, plane_stride);
+        break;
+    case 3:
+        deinterleave_fixed<3>(interleaved.data(), voxels, planes, plane_stride);
+        break;
+    case 4:
+        deinterleave_fixed<4>(interleaved.data(), voxels, planes, plane_stride);
+        break;
+    default:
+        for (std::size_t c { 0 }; c < components; ++c) {
+            float* plane { planes + c * plane_stride };
+            const float* source { interleaved.data() + (components - 1 - c) };
+            for (std::size_t i { 0 }; i < voxels; ++i) {
+                plane[i] = source[i * components];
+            }
+        }
+        break;
+    }
+}
+
+void interleave_components(const float* planes, std::size_t plane_stride, std::size_t components,
+    std::span<float> interleaved)
+{
+    if (components == 0) {
+        return;
+    }
+
+    std::size_t voxels { interleaved.size() / components };
+    switch (components) {
+    case 1:
+        std::copy_n(planes, voxels, interleaved.data());
+        break;
+    case 2:
+        interleave_fixed<2>(planes, plane_stride, voxels, interleaved.data());
+        break;
+    case 3:
+        interleave_fixed<3>(planes, plane_stride, voxels, interleaved.data());
+        break;
+    case 4:
+        interleave_fixed<4>(planes, plane_stride, voxels, interleaved.data());
+        break;
+    default:
+        for (std::size_t c { 0 }; c < components; ++c) {
+            const float* plane { planes + c * plane_stride };
+            float* destination { interleaved.data() + (components - 1 - c) };
+            for (std::size_t i { 0 }; i < voxels; ++i) {
+                destination[i * components] = plane[i];
+            }
+        }
+        break;
+    }
+}
+
+PlanarVolume::PlanarVolume(const std::filesystem::path& volume_path, PVMLoadProgress* progress)
+    : m_data { nullptr }
+    , m_data_memory { MemoryTag::VolumeData }
+    , m_component_ranges {}
+    , m_extends { 0 }
+    , m_scale { 0.0f }
+    , m_components { 0 }
+    , m_plane_stride { 0 }
+{
+    auto cancelled = [&]() { return progress && progress->cancel_requested; };
+
+    auto info_sink = [&](const PVMInfo& info) {
+        this->m_extends = info.extends;
+        this->m_scale = info.scale;
+        this->m_components = info.components;
+        this->allocate();
+
+        static_assert(std::numeric_limits<float>::is_iec559, "IEEE 754 required");
+        this->m_component_ranges.assign(this->m_components,
+            glm::vec2 { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() });
+
+        if (progress) {
+            progress->voxels_total = this->voxel_count();
+            progress->voxels_normalized = 0;
+        }
+        return !cancelled();
+    };
+
+    // The bytes of each decoded slice are distributed over the planes right
+    // away, so the interleaved volume is never materialized.
+    auto slice_sink = [&](std::size_t z, std::span<const unsigned char> slice) {
+        std::size_t slice_voxels { this->m_extends.x * this->m_extends.y };
+        for (std::size_t c { 0 }; c < this->m_components; ++c) {
+            float* plane { this->m_data.get() + c * this->m_plane_stride + z * slice_voxels };
+            const unsigned char* source { slice.data() + (this->m_components - 1 - c) };
+            glm::vec2 range { this->m_component_ranges[c] };
+            for (std::size_t i { 0 }; i < slice_voxels; ++i) {
+                float value { static_cast<float>(source[i * this->m_components]) };
+                range.x = std::min(range.x, value);
+                range.y = std::max(range.y, value);
+                plane[i] = value;
+            }
+            this->m_component_ranges[c] = range;
+        }
+        if (progress) {
+            progress->bytes_decoded += slice.size();
+        }
+        return !cancelled();
+    };
+
+    auto report_progress = [&](std::size_t bytes_read, std::size_t bytes_total, std::size_t) {
+        if (progress) {
+            progress->bytes_total = bytes_total;
+            progress->bytes_read = bytes_read;
+        }
+        return !cancelled();
+    };
+
+    bool complete { read_pvm_slices(volume_path, info_sink, slice_sink, 0, std::numeric_limits<std::size_t>::max(), report_progress) };
+    if (cancelled()) {
+        throw std::runtime_error("volume load cancelled");
+    }
+    if (!complete) {
+        throw std::runtime_error("could not read pvm volume");
+    }
+    if (progress) {
+        progress->bytes_read = progress->bytes_total.load();
+    }
+
+    // Normalize the planes in z-slabs on the workers of the calling scheduler.
+    std::size_t slice_voxels { this->m_extends.x * this->m_extends.y };
+    std::size_t slab_depth { std::max<std::size_t>(normalization_slab_voxels / std::max<std::size_t>(slice_voxels, 1), 1) };
+    TaskScheduler::current().parallel_for(this->m_extends, z_slabs(this->m_extends, slab_depth), [&](const PVMRegion& slab) {
+        if (cancelled()) {
+            return;
+        }
+        std::size_t slab_voxels { slab.extends.z * slice_voxels };
+        for (std::size_t c { 0 }; c < this->m_components; ++c) {
+            float* plane { this->m_data.get() + c * this->m_plane_stride + slab.offset.z * slice_voxels };
+            float min { this->m_component_ranges[c].x };
+            float max { this->m_component_ranges[c].y };
+            for (std::size_t i { 0 }; i < slab_voxels; ++i) {
+                plane[i] = (plane[i] - min) / (max - min);
+            }
+        }
+        if (progress) {
+            progress->voxels_normalized += slab_voxels;
+        }
+    });
+    if (cancelled()) {
+        throw std::runtime_error("volume load cancelled");
+    }
+}
+
+PlanarVolume::PlanarVolume(const PVMVolume& volume)
+    : m_data { nullptr }
+    , m_data_memory { MemoryTag::VolumeData }
+    , m_component_ranges {}
+    , m_extends { volume.extends() }
+    , m_scale { volume.scale() }
+    , m_components { volume.components() }
+    , m_plane_stride { 0 }
+{
+    this->allocate();
+    for (std::size_t c { 0 }; c < this->m_components; ++c) {
+        this->m_component_ranges.push_back(volume.component_range(c));
+    }
+    deinterleave_components(std::span { volume.data(), this->voxel_count() * this->m_components }, this->m_components,
+        this->m_data.get(), this->m_plane_stride);
+}
+
+PlanarVolume::PlanarVolume(const PlanarVolume& volume)
+    : m_data { nullptr }
+    , m_data_memory { MemoryTag::VolumeData }
+    , m_component_ranges { volume.m_component_ranges }
+    , m_extends { volume.m_extends }
+    , m_scale { volume.m_scale }
+    , m_components { volume.m_components }
+    , m_plane_stride { 0 }
+{
+    this->allocate();
+    std::copy_n(volume.m_data.get(), this->m_plane_stride * this->m_components, this->m_data.get());
+}
+
+PlanarVolume& PlanarVolume::operator=(const PlanarVolume& volume)
+{
+    if (this != &volume) {
+        PlanarVolume copy { volume };
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+void PlanarVolume::AlignedDelete::operator()(float* data) const
+{
+    ::operator delete[](data, std::align_val_t { PlanarVolume::plane_alignment });
+}
+
+void PlanarVolume::allocate()
+{
+    // Each plane is padded to the alignment, and the padding is zeroed so that
+    // vectorized loops may read past the last voxel.
+    constexpr std::size_t alignment_floats { plane_alignment / sizeof(float) };
+    std::size_t voxels { this->voxel_count() };
+    this->m_plane_stride = (voxels + alignment_floats - 1) / alignment_floats * alignment_floats;
+
+    std::size_t bytes { this->m_plane_stride * this->m_components * sizeof(float) };
+    this->m_data.reset(static_cast<float*>(::operator new[](bytes, std::align_val_t { plane_alignment })));
+    this->m_data_memory.resize(bytes);
+    for (std::size_t c { 0 }; c < this->m_components; ++c) {
+        std::fill(this->m_data.get() + c * this->m_plane_stride + voxels,
+            this->m_data.get() + (c + 1) * this->m_plane_stride, 0.0f);
+    }
+}
+
+std::size_t PlanarVolume::components() const
+{
+    return this->m_components;
+}
+
+glm::vec<3, std::size_t> PlanarVolume::extends() const
+{
+    return this->m_extends;
+}
+
+glm::vec3 PlanarVolume::scale() const
+{
+    return this->m_scale;
+}
+
+std::size_t PlanarVolume::voxel_count() const
+{
+    return this->m_extends.x * this->m_extends.y * this->m_extends.z;
+}
+
+glm::vec2 PlanarVolume::component_range(std::size_t component) const
+{
+    check_component(component, this->m_components);
+    return this->m_component_ranges[component];
+}
+
+std::span<const float> PlanarVolume::plane(std::size_t component) const
+{
+    check_component(component, this->m_components);
+    return std::span { this->m_data.get() + component * this->m_plane_stride, this->voxel_count() };
+}
+
+float PlanarVolume::voxel_normalized(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const
+{
+    if (x >= this->m_extends.x) {
+        throw std::out_of_range("x coordinate out of range");
+    }
+    if (y >= this->m_extends.y) {
+        throw std::out_of_range("y coordinate out of range");
+    }
+    if (z >= this->m_extends.z) {
+        throw std::out_of_range("z coordinate out of range");
+    }
+    return this->plane(component)[x + y * this->m_extends.x + z * this->m_extends.x * this->m_extends.y];
+}
+
+void PlanarVolume::interleave(std::span<float> interleaved) const
+{
+    if (interleaved.size() != this->voxel_count() * this->m_components) {
+        throw std::invalid_argument("output size does not match the volume");
+    }
+    interleave_components(this->m_data.get(), this->m_plane_stride, this->m_components, interleaved);
+}
+
+std::size_t PlanarVolume::byte_size() const
+{
+    return this->m_plane_stride * this->m_components * sizeof(float);
+}
+
+std::vector<float> component_magnitude(const PVMVolume& volume)
+{
+    std::size_t components { volume.components() };
+    std::size_t voxels { volume.size_x() * volume.size_y() * volume.size_z() };
+    std::vector<glm::vec2> ranges {};
+    for (std::size_t c { 0 }; c < components; ++c) {
+        ranges.push_back(volume.component_range(c));
+    }
+
+    std::vector<float> magnitudes(voxels);
+    const float* data { volume.data() };
+    for (std::size_t i { 0 }; i < voxels; ++i) {
+        float sum { 0.0f };
+        for (std::size_t c { 0 }; c < components; ++c) {
+            float value { ranges[c].x + data[i * components + (components - 1 - c)] * (ranges[c].y - ranges[c].x) };
+            sum += value * value;
+        }
+        magnitudes[i] = std::sqrt(sum);
+    }
+    return magnitudes;
+}
+
+std::vector<float> component_magnitude(const PlanarVolume& volume)
+{
+    // The squares are accumulated plane by plane, so every pass streams
+    // through contiguous memory. The last pass also takes the root.
+    std::size_t components { volume.components() };
+    std::vector<float> magnitudes(volume.voxel_count(), 0.0f);
+    float* output { magnitudes.data() };
+    for (std::size_t c { 0 }; c < components; ++c) {
+        glm::vec2 range { volume.component_range(c) };
+        float offset { range.x };
+        float extent { range.y - range.x };
+        const float* plane { volume.plane(c).data() };
+        if (c + 1 < components) {
+            for (std::size_t i { 0 }; i < magnitudes.size(); ++i) {
+                float value { offset + plane[i] * extent };
+                output[i] += value * value;
+            }
+        } else {
+            for (std::size_t i { 0 }; i < magnitudes.size(); ++i) {
+                float value { offset + plane[i] * extent };
+                output[i] = std::sqrt(output[i] + value * value);
+            }
+        }
+    }
+    return magnitudes;
+}
+
+std::vector<std::size_t> component_histogram(const PVMVolume& volume, std::size_t component, std::size_t bins)
+{
+    return visit_components(volume.view(), [&](auto view) { return voxel_histogram(view, component, bins); });
+}
+
+std::vector<std::size_t> component_histogram(const PlanarVolume& volume, std::size_t component, std::size_t bins)
+{
+    VolumeView<const float, 1> plane { volume.plane(component).data(), volume.extends() };
+    return voxel_histogram(plane, 0, bins);
+}
+
+void extract_component(const PVMVolume& volume, std::size_t component, std::span<float> output)
+{
+    std::size_t components { volume.components() };
+    check_component(component, components);
+    std::size_t voxels { volume.size_x() * volume.size_y() * volume.size_z() };
+    if (output.size() != voxels) {
+        throw std::invalid_argument("output size does not match the volume");
+    }
+
+    const float* data { volume.data() + (components - 1 - component) };
+    for (std::size_t i { 0 }; i < voxels; ++i) {
+        output[i] = data[i * components];
+    }
+}
+
+void extract_component(const PlanarVolume& volume, std::size_t component, std::span<float> output)
+{
+    std::span<const float> plane { volume.plane(component) };
+    if (output.size() != plane.size()) {
+        throw std::invalid_argument("output size does not match the volume");
+    }
+    std::copy(plane.begin(), plane.end(), output.begin());
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <memory_tracker.h>
+#include <pvm_volume.h>
+
+/**
+ * Copies interleaved voxel data into separate component planes.
+ * @param interleaved normalized data with the layout of `PVMVolume::data()`
+ * @param components number of components of each voxel
+ * @param planes start of the first plane, plane `c` starts at `planes + c * plane_stride`
+ * @param plane_stride distance between the starts of consecutive planes, at least the number of voxels
+ */
+void deinterleave_components(std::span<const float> interleaved, std::size_t components, float* planes,
+    std::size_t plane_stride);
+
+/**
+ * Copies separate component planes into interleaved voxel data.
+ * @param planes start of the first plane, plane `c` starts at `planes + c * plane_stride`
+ * @param plane_stride distance between the starts of consecutive planes, at least the number of voxels
+ * @param components number of components of each voxel
+ * @param interleaved output with the layout of `PVMVolume::data()`
+ */
+void interleave_components(const float* planes, std::size_t plane_stride, std::size_t components,
+    std::span<float> interleaved);
+
+/**
+ * Normalized volume with a planar layout.
+ *
+ * Each component is stored in its own contiguous plane, so operations on a
+ * single component read consecutive memory and vectorize, and a component
+ * can be uploaded as a texture without gathering it first. The planes are
+ * aligned to `plane_alignment` bytes. Voxels, value ranges and scales match
+ * the ones of `PVMVolume`.
+ */
+class PlanarVolume {
+public:
+    static constexpr std::size_t plane_alignment { 64 };
+
+    /**
+     * Loads a PVM volume from disk, directly into the planar layout.
+     * @param volume_path path to the volume
+     * @param progress optional progress counters, updated while loading
+     */
+    PlanarVolume(const std::filesystem::path& volume_path, PVMLoadProgress* progress = nullptr);
+
+    /**
+     * Converts an interleaved volume.
+     * @param volume converted volume
+     */
+    explicit PlanarVolume(const PVMVolume& volume);
+    PlanarVolume(const PlanarVolume&);
+    PlanarVolume(PlanarVolume&&) noexcept = default;
+    ~PlanarVolume() = default;
+
+    PlanarVolume& operator=(const PlanarVolume&);
+    PlanarVolume& operator=(PlanarVolume&&) noexcept = default;
+
+    /**
+     * Returns the number of components for each voxel.
+     * @return components for each voxel
+     */
+    std::size_t components() const;
+
+    /**
+     * Returns the extends (size_x, size_y, size_z) of the volume.
+     * @return volume extends
+     */
+    glm::vec<3, std::size_t> extends() const;
+
+    /**
+     * Returns the size of a voxel.
+     * @return voxel size
+     */
+    glm::vec3 scale() const;
+
+    /**
+     * Returns the number of voxels of the volume.
+     * @return voxel count
+     */
+    std::size_t voxel_count() const;
+
+    /**
+     * Returns the range of the non-normalized values of a component.
+     * @param component voxel component
+     * @return minimum (x) and maximum (y) value
+     */
+    glm::vec2 component_range(std::size_t component) const;
+
+    /**
+     * Returns the normalized values of a component, in x-fastest order.
+     * @param component voxel component
+     * @return plane of the component
+     */
+    std::span<const float> plane(std::size_t component) const;
+
+    /**
+     * Returns the normalized voxel value
+     * @param x x grid position
+     * @param y y grid position
+     * @param z z grid position
+     * @param component voxel component
+     * @return normalized voxel value
+     */
+    float voxel_normalized(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const;
+
+    /**
+     * Copies the voxels into the interleaved layout of `PVMVolume::data()`.
+     * @param interleaved output of `voxel_count() * components()` values
+     */
+    void interleave(std::span<float> interleaved) const;
+
+    /**
+     * Returns the size of the planes in bytes, including their padding.
+     * @return data size
+     */
+    std::size_t byte_size() const;
+
+private:
+    struct AlignedDelete {
+        void operator()(float* data) const;
+    };
+
+    void allocate();
+
+    std::unique_ptr<float[], AlignedDelete> m_data;
+    TrackedAllocation m_data_memory;
+    std::vector<glm::vec2> m_component_ranges;
+    glm::vec<3, std::size_t> m_extends;
+    glm::vec3 m_scale;
+    std::size_t m_components;
+    std::size_t m_plane_stride;
+};
+
+/**
+ * Computes the length of the vector formed by the non-normalized components of each voxel.
+ * @param volume volume with the interleaved layout
+ * @return length of each voxel, in x-fastest order
+ */
+std::vector<float> component_magnitude(const PVMVolume& volume);
+
+/**
+ * Computes the length of the vector formed by the non-normalized components of each voxel.
+ * @param volume volume with the planar layout
+ * @return length of each voxel, in x-fastest order
+ */
+std::vector<float> component_magnitude(const PlanarVolume& volume);
+
+/**
+ * Counts the normalized values of a component in equally sized bins covering [0, 1].
+ * @param volume volume with the interleaved layout
+ * @param component voxel component
+ * @param bins number of bins, at least 1
+ * @return number of values in each bin
+ */
+std::vector<std::size_t> component_histogram(const PVMVolume& volume, std::size_t component, std::size_t bins);
+
+/**
+ * Counts the normalized values of a component in equally sized bins covering [0, 1].
+ * @param volume volume with the planar layout
+ * @param component voxel component
+ * @param bins number of bins, at least 1
+ * @return number of values in each bin
+ */
+std::vector<std::size_t> component_histogram(const PlanarVolume& volume, std::size_t component, std::size_t bins);
+
+/**
+ * Copies the normalized values of a component into a contiguous array, e.g. for uploading it as texture.
+ * @param volume volume with the interleaved layout
+ * @param component voxel component
+ * @param output output of one value per voxel
+ */
+void extract_component(const PVMVolume& volume, std::size_t component, std::span<float> output);
+
+/**
+ * Copies the normalized values of a component into a contiguous array, e.g. for uploading it as texture.
+ * @param volume volume with the planar layout
+ * @param component voxel component
+ * @param output output of one value per voxel
+ */
+void extract_component(const PlanarVolume& volume, std::size_t component, std::span<float> output);
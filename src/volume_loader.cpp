@@ -0,0 +1,154 @@
+#include <volume_loader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+struct VolumeLoadHandle::State {
+    std::filesystem::path path;
+    PVMLoadProgress progress;
+    std::atomic<VolumeLoadStatus> status { VolumeLoadStatus::Queued };
+    mutable std::mutex mutex;
+    mutable std::condition_variable condition;
+    std::unique_ptr<PVMVolume> volume;
+    std::string error;
+};
+
+VolumeLoadHandle::VolumeLoadHandle(std::shared_ptr<State> state)
+    : m_state { std::move(state) }
+{
+}
+
+bool VolumeLoadHandle::valid() const
+{
+    return this->m_state != nullptr;
+}
+
+VolumeLoadStatus VolumeLoadHandle::status() const
+{
+    if (!this->m_state) {
+        return VolumeLoadStatus::Failed;
+    }
+    return this->m_state->status;
+}
+
+bool VolumeLoadHandle::done() const
+{
+    switch (this->status()) {
+    case VolumeLoadStatus::Finished:
+    case VolumeLoadStatus::Failed:
+    case VolumeLoadStatus::Cancelled:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void VolumeLoadHandle::cancel()
+{
+    if (this->m_state) {
+        this->m_state->progress.cancel_requested = true;
+    }
+}
+
+void VolumeLoadHandle::wait() const
+{
+    if (!this->m_state) {
+        return;
+    }
+
+    std::unique_lock lock { this->m_state->mutex };
+    this->m_state->condition.wait(lock, [this]() { return this->done(); });
+}
+
+const std::filesystem::path& VolumeLoadHandle::path() const
+{
+    return this->m_state->path;
+}
+
+const PVMLoadProgress& VolumeLoadHandle::progress() const
+{
+    return this->m_state->progress;
+}
+
+std::string VolumeLoadHandle::error() const
+{
+    if (!this->m_state) {
+        return "invalid volume load handle";
+    }
+
+    std::scoped_lock lock { this->m_state->mutex };
+    return this->m_state->error;
+}
+
+std::unique_ptr<PVMVolume> VolumeLoadHandle::take()
+{
+    if (!this->m_state || this->status() != VolumeLoadStatus::Finished) {
+        return nullptr;
+    }
+
+    std::scoped_lock lock { this->m_state->mutex };
+    return std::move(this->m_state->volume);
+}
+
+VolumeLoader::VolumeLoader(TaskScheduler& scheduler)
+    : m_scheduler { scheduler }
+    , m_loads {}
+    , m_mutex {}
+{
+}
+
+VolumeLoader::~VolumeLoader()
+{
+    std::scoped_lock lock { this->m_mutex };
+    for (auto& load : this->m_loads) {
+        load.first->progress.cancel_requested = true;
+    }
+    for (const auto& load : this->m_loads) {
+        load.second.wait();
+    }
+}
+
+VolumeLoadHandle VolumeLoader::load(const std::filesystem::path& volume_path)
+{
+    auto state = std::make_shared<VolumeLoadHandle::State>();
+    state->path = volume_path;
+
+    // A cancelled load still runs, so that its status becomes `Cancelled`.
+    TaskHandle task { this->m_scheduler.submit([state]() {
+        VolumeLoadStatus status { VolumeLoadStatus::Cancelled };
+        std::unique_ptr<PVMVolume> volume {};
+        std::string error {};
+        if (!state->progress.cancel_requested) {
+            state->status = VolumeLoadStatus::Loading;
+            try {
+                volume = std::make_unique<PVMVolume>(state->path, &state->progress);
+                status = VolumeLoadStatus::Finished;
+            } catch (const std::exception& e) {
+                error = e.what();
+                status = state->progress.cancel_requested ? VolumeLoadStatus::Cancelled : VolumeLoadStatus::Failed;
+            }
+        }
+
+        {
+            std::scoped_lock lock { state->mutex };
+            state->volume = std::move(volume);
+            state->error = std::move(error);
+            state->status = status;
+        }
+        state->condition.notify_all();
+    }) };
+
+    {
+        std::scoped_lock lock { this->m_mutex };
+        std::erase_if(this->m_loads, [](const auto& load) { return load.second.done(); });
+        this->m_loads.emplace_back(state, std::move(task));
+    }
+    return VolumeLoadHandle { std::move(state) };
+}
+
+std::size_t VolumeLoader::thread_count() const
+{
+    return this->m_scheduler.thread_count();
+}
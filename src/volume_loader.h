@@ -0,0 +1,146 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pvm_volume.h>
+#include <task_scheduler.h>
+
+/**
+ * State of an asynchronous volume load.
+ */
+enum class VolumeLoadStatus {
+    Queued,
+    Loading,
+    Finished,
+    Failed,
+    Cancelled,
+};
+
+/**
+ * Handle to a volume that is loaded in the background.
+ *
+ * The handle is cheap to copy and may be polled from the render thread
+ * every frame. Once the load has finished, the volume is moved out of
+ * the handle with `take()`.
+ */
+class VolumeLoadHandle {
+public:
+    VolumeLoadHandle() = default;
+    VolumeLoadHandle(const VolumeLoadHandle&) = default;
+    VolumeLoadHandle(VolumeLoadHandle&&) noexcept = default;
+    ~VolumeLoadHandle() noexcept = default;
+
+    VolumeLoadHandle& operator=(const VolumeLoadHandle&) = default;
+    VolumeLoadHandle& operator=(VolumeLoadHandle&&) noexcept = default;
+
+    /**
+     * Checks if the handle refers to a load.
+     * @return handle refers to a load
+     */
+    bool valid() const;
+
+    /**
+     * Returns the current state of the load.
+     * @return load state
+     */
+    VolumeLoadStatus status() const;
+
+    /**
+     * Checks if the load has finished, failed or was cancelled.
+     * @return load is done
+     */
+    bool done() const;
+
+    /**
+     * Requests the cancellation of the load.
+     */
+    void cancel();
+
+    /**
+     * Blocks until the load is done.
+     */
+    void wait() const;
+
+    /**
+     * Returns the path of the loaded volume.
+     * @return volume path
+     */
+    const std::filesystem::path& path() const;
+
+    /**
+     * Returns the progress counters of the load.
+     * @return progress counters
+     */
+    const PVMLoadProgress& progress() const;
+
+    /**
+     * Returns the error message of a failed load.
+     * @return error message
+     */
+    std::string error() const;
+
+    /**
+     * Moves the loaded volume out of the handle.
+     * Returns a null pointer, if the load is not finished or the volume was already taken.
+     * @return loaded volume
+     */
+    std::unique_ptr<PVMVolume> take();
+
+private:
+    friend class VolumeLoader;
+    struct State;
+
+    explicit VolumeLoadHandle(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> m_state;
+};
+
+/**
+ * Loads PVM volumes without blocking the caller.
+ *
+ * Each load is a task of a `TaskScheduler`, so the normalization of the
+ * volume runs on the same workers as the load itself.
+ */
+class VolumeLoader {
+public:
+    /**
+     * Creates a loader.
+     * @param scheduler scheduler running the loads
+     */
+    VolumeLoader(TaskScheduler& scheduler = TaskScheduler::shared());
+    VolumeLoader(const VolumeLoader&) = delete;
+    VolumeLoader(VolumeLoader&&) = delete;
+
+    /**
+     * Cancels all loads and waits for them.
+     */
+    ~VolumeLoader();
+
+    VolumeLoader& operator=(const VolumeLoader&) = delete;
+    VolumeLoader& operator=(VolumeLoader&&) = delete;
+
+    /**
+     * Enqueues the load of a volume.
+     * @param volume_path path to the volume
+     * @return handle to the load
+     */
+    VolumeLoadHandle load(const std::filesystem::path& volume_path);
+
+    /**
+     * Returns the number of loads that may run at the same time.
+     * @return number of workers of the scheduler
+     */
+    std::size_t thread_count() const;
+
+private:
+    TaskScheduler& m_scheduler;
+    std::vector<std::pair<std::shared_ptr<VolumeLoadHandle::State>, TaskHandle>> m_loads;
+    std::mutex m_mutex;
+};
@@ -0,0 +1,228 @@
+#include <volume_renderer.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#pragma warning(push, 3)
+#include <glm/gtc/matrix_transform.hpp>
+#pragma warning(pop)
+
+namespace {
+
+// The rays start at the camera and pass through the far plane of each pixel.
+// Positions inside of the box are mapped to texture coordinates in [0, 1].
+constexpr const char* volume_shader = R"(
+    struct Uniforms {
+        inverse_view_projection: mat4x4<f32>,
+        eye: vec4<f32>,
+        half_size: vec4<f32>,
+        transfer: vec4<f32>,
+    }
+
+    struct VertexOutput {
+        @builtin(position) position: vec4<f32>,
+        @location(0) ndc: vec2<f32>,
+    }
+
+    @group(0) @binding(0) var<uniform> uniforms: Uniforms;
+    @group(0) @binding(1) var volume: texture_3d<f32>;
+
+    @vertex
+    fn vs_main(@builtin(vertex_index) vertex_index: u32) -> VertexOutput {
+        let uv = vec2<f32>(f32((vertex_index << 1u) & 2u), f32(vertex_index & 2u));
+        var output: VertexOutput;
+        output.ndc = uv * 2.0 - 1.0;
+        output.position = vec4<f32>(output.ndc, 0.0, 1.0);
+        return output;
+    }
+
+    fn load_voxel(position: vec3<f32>) -> f32 {
+        let size = vec3<i32>(textureDimensions(volume));
+        let voxel = clamp(vec3<i32>(position * vec3<f32>(size)), vec3<i32>(0), size - 1);
+        return textureLoad(volume, voxel, 0).r;
+    }
+
+    @fragment
+    fn fs_main(input: VertexOutput) -> @location(0) vec4<f32> {
+        let far = uniforms.inverse_view_projection * vec4<f32>(input.ndc, 1.0, 1.0);
+        let eye = uniforms.eye.xyz;
+        var direction = normalize(far.xyz / far.w - eye);
+        direction = select(direction, vec3<f32>(1e-6), abs(direction) < vec3<f32>(1e-6));
+
+        let t0 = (-uniforms.half_size.xyz - eye) / direction;
+        let t1 = (uniforms.half_size.xyz - eye) / direction;
+        let t_min = min(t0, t1);
+        let t_max = max(t0, t1);
+        let t_near = max(max(max(t_min.x, t_min.y), t_min.z), 0.0);
+        let t_far = min(min(t_max.x, t_max.y), t_max.z);
+        if (t_near >= t_far) {
+            discard;
+        }
+
+        let lower = uniforms.transfer.x;
+        let upper = uniforms.transfer.y;
+        let density = uniforms.transfer.z;
+        let steps = u32(uniforms.transfer.w);
+        let dt = (t_far - t_near) / f32(steps);
+
+        var color = vec3<f32>(0.0);
+        var alpha = 0.0;
+        for (var i = 0u; i < steps && alpha < 0.99; i++) {
+            let position = eye + direction * (t_near + (f32(i) + 0.5) * dt);
+            let value = load_voxel(position / (2.0 * uniforms.half_size.xyz) + 0.5);
+            let intensity = clamp((value - lower) / max(upper - lower, 1e-6), 0.0, 1.0);
+            let sample_alpha = 1.0 - exp(-intensity * density * dt);
+            color += (1.0 - alpha) * sample_alpha * vec3<f32>(intensity);
+            alpha += (1.0 - alpha) * sample_alpha;
+        }
+        return vec4<f32>(color, alpha);
+    }
+)";
+
+struct ShaderUniforms {
+    glm::mat4 inverse_view_projection;
+    glm::vec4 eye;
+    glm::vec4 half_size;
+    glm::vec4 transfer;
+};
+
+}
+
+VolumeRenderer::VolumeRenderer(wgpu::Device& device, wgpu::TextureFormat target_format)
+    : m_device { device }
+    , m_pipeline { nullptr }
+    , m_bind_group_layout { nullptr }
+    , m_uniforms { nullptr }
+    , m_bind_group { nullptr }
+{
+    wgpu::ShaderModuleWGSLDescriptor wgsl_module_desc { wgpu::Default };
+    wgsl_module_desc.code = volume_shader;
+    wgpu::ShaderModuleDescriptor module_desc { wgpu::Default };
+    module_desc.nextInChain = reinterpret_cast<wgpu::ChainedStruct*>(&wgsl_module_desc);
+    auto shader_module = this->m_device.createShaderModule(module_desc);
+    if (!shader_module) {
+        throw std::runtime_error("could not create the volume shader module");
+    }
+
+    // The colors are premultiplied by the accumulated opacity.
+    wgpu::BlendState blend_state { wgpu::Default };
+    blend_state.color.operation = wgpu::BlendOperation::Add;
+    blend_state.color.srcFactor = wgpu::BlendFactor::One;
+    blend_state.color.dstFactor = wgpu::BlendFactor::OneMinusSrcAlpha;
+    blend_state.alpha.operation = wgpu::BlendOperation::Add;
+    blend_state.alpha.srcFactor = wgpu::BlendFactor::One;
+    blend_state.alpha.dstFactor = wgpu::BlendFactor::OneMinusSrcAlpha;
+
+    auto fragment_targets = std::array { wgpu::ColorTargetState { wgpu::Default } };
+    fragment_targets[0].format = target_format;
+    fragment_targets[0].blend = &blend_state;
+    fragment_targets[0].writeMask = wgpu::ColorWriteMask::All;
+
+    wgpu::FragmentState fragment_state { wgpu::Default };
+    fragment_state.module = shader_module;
+    fragment_state.entryPoint = "fs_main";
+    fragment_state.targetCount = fragment_targets.size();
+    fragment_state.targets = fragment_targets.data();
+
+    wgpu::RenderPipelineDescriptor pipeline_desc { wgpu::Default };
+    pipeline_desc.label = "Volume renderer";
+    pipeline_desc.layout = nullptr;
+    pipeline_desc.vertex.module = shader_module;
+    pipeline_desc.vertex.entryPoint = "vs_main";
+    pipeline_desc.fragment = &fragment_state;
+    pipeline_desc.depthStencil = nullptr;
+    pipeline_desc.primitive.topology = wgpu::PrimitiveTopology::TriangleList;
+    pipeline_desc.multisample.count = 1;
+    pipeline_desc.multisample.mask = 0xFFFFFFFF;
+    this->m_pipeline = this->m_device.createRenderPipeline(pipeline_desc);
+    shader_module.release();
+    if (!this->m_pipeline) {
+        throw std::runtime_error("could not create the volume render pipeline");
+    }
+    this->m_bind_group_layout = this->m_pipeline.getBindGroupLayout(0);
+
+    wgpu::BufferDescriptor desc { wgpu::Default };
+    desc.label = "Volume renderer uniforms";
+    desc.usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
+    desc.size = sizeof(ShaderUniforms);
+    this->m_uniforms = this->m_device.createBuffer(desc);
+    if (!this->m_uniforms) {
+        throw std::runtime_error("could not create the volume renderer uniforms");
+    }
+}
+
+VolumeRenderer::~VolumeRenderer()
+{
+    if (this->m_bind_group) {
+        this->m_bind_group.release();
+    }
+
+    if (this->m_uniforms) {
+        this->m_uniforms.destroy();
+        this->m_uniforms.release();
+    }
+
+    if (this->m_bind_group_layout) {
+        this->m_bind_group_layout.release();
+    }
+
+    if (this->m_pipeline) {
+        this->m_pipeline.release();
+    }
+}
+
+void VolumeRenderer::prepare(VolumeTexture& texture, glm::vec3 size, const VolumeRenderSettings& settings, float aspect)
+{
+    glm::vec3 half_size { 0.5f * size / std::max(std::max(size.x, size.y), size.z) };
+
+    // The up vector is switched if the camera looks along it.
+    glm::vec3 up { 0.0f, 1.0f, 0.0f };
+    glm::vec3 view_direction { settings.target - settings.eye };
+    if (glm::length(glm::cross(view_direction, up)) < 1e-6f * glm::length(view_direction)) {
+        up = glm::vec3 { 0.0f, 0.0f, 1.0f };
+    }
+    glm::mat4 view { glm::lookAt(settings.eye, settings.target, up) };
+    glm::mat4 projection { glm::perspective(glm::radians(settings.fov_y), aspect, 0.01f, 100.0f) };
+
+    ShaderUniforms uniforms {
+        glm::inverse(projection * view),
+        glm::vec4 { settings.eye, 1.0f },
+        glm::vec4 { half_size, 0.0f },
+        glm::vec4 { settings.window_lower, settings.window_upper, settings.density,
+            static_cast<float>(std::max<std::uint32_t>(settings.steps, 1)) },
+    };
+    auto queue = this->m_device.getQueue();
+    queue.writeBuffer(this->m_uniforms, 0, &uniforms, sizeof(uniforms));
+    queue.release();
+
+    // Textures are replaced when new volumes are staged, so the bind group
+    // is recreated every frame instead of tracking their lifetimes.
+    if (this->m_bind_group) {
+        this->m_bind_group.release();
+    }
+
+    auto entries = std::array { wgpu::BindGroupEntry { wgpu::Default }, wgpu::BindGroupEntry { wgpu::Default } };
+    entries[0].binding = 0;
+    entries[0].buffer = this->m_uniforms;
+    entries[0].size = sizeof(ShaderUniforms);
+    entries[1].binding = 1;
+    entries[1].textureView = texture.view();
+
+    wgpu::BindGroupDescriptor group_desc { wgpu::Default };
+    group_desc.layout = this->m_bind_group_layout;
+    group_desc.entryCount = entries.size();
+    group_desc.entries = entries.data();
+    this->m_bind_group = this->m_device.createBindGroup(group_desc);
+}
+
+void VolumeRenderer::draw(wgpu::RenderPassEncoder& pass_encoder)
+{
+    if (!this->m_bind_group) {
+        return;
+    }
+
+    pass_encoder.setPipeline(this->m_pipeline);
+    pass_encoder.setBindGroup(0, this->m_bind_group, 0, nullptr);
+    pass_encoder.draw(3, 1, 0, 0);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+#include <webgpu/webgpu.hpp>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <volume_texture.h>
+
+/**
+ * Camera and transfer function of the volume renderer.
+ *
+ * The volume is centered at the origin and scaled so that its longest side
+ * has a length of 1, positions of the camera are given in these units.
+ * Normalized values below the lower end of the transfer window are
+ * transparent, values above its upper end have the full density.
+ */
+struct VolumeRenderSettings {
+    glm::vec3 eye { 0.0f, 0.0f, 2.0f };
+    glm::vec3 target { 0.0f, 0.0f, 0.0f };
+    float fov_y { 45.0f };
+    float window_lower { 0.0f };
+    float window_upper { 1.0f };
+    float density { 8.0f };
+    std::uint32_t steps { 256 };
+};
+
+/**
+ * Direct volume renderer marching rays through the first component of a volume texture.
+ *
+ * The volume is drawn with a full-screen triangle and blended over the
+ * content of the target, using emission-absorption compositing from front to
+ * back. The voxels are fetched without filtering, as 32-bit float textures
+ * can not be filtered without an optional device feature.
+ */
+class VolumeRenderer {
+public:
+    /**
+     * Creates the render pipeline.
+     * @param device device used for rendering
+     * @param target_format format of the color target
+     */
+    VolumeRenderer(wgpu::Device& device, wgpu::TextureFormat target_format);
+    VolumeRenderer(const VolumeRenderer&) = delete;
+    VolumeRenderer(VolumeRenderer&&) = delete;
+    ~VolumeRenderer();
+
+    VolumeRenderer& operator=(const VolumeRenderer&) = delete;
+    VolumeRenderer& operator=(VolumeRenderer&&) = delete;
+
+    /**
+     * Updates the camera, transfer function and texture of the next draw.
+     * @param texture texture of the volume
+     * @param size physical size of the volume
+     * @param settings camera and transfer function
+     * @param aspect ratio of the width and height of the target
+     */
+    void prepare(VolumeTexture& texture, glm::vec3 size, const VolumeRenderSettings& settings, float aspect);
+
+    /**
+     * Records the draw of the prepared volume.
+     * @param pass_encoder render pass drawing into a target of the format of the pipeline
+     */
+    void draw(wgpu::RenderPassEncoder& pass_encoder);
+
+private:
+    wgpu::Device m_device;
+    wgpu::RenderPipeline m_pipeline;
+    wgpu::BindGroupLayout m_bind_group_layout;
+    wgpu::Buffer m_uniforms;
+    wgpu::BindGroup m_bind_group;
+};
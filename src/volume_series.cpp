@@ -0,0 +1,215 @@
+#include <volume_series.h>
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+std::vector<std::filesystem::path> find_frames(const std::filesystem::path& pattern)
+{
+    std::string file_pattern { pattern.filename().string() };
+    std::size_t placeholder_start { file_pattern.find('#') };
+    if (placeholder_start == std::string::npos) {
+        throw std::invalid_argument("series pattern contains no '#' placeholder");
+    }
+    std::size_t placeholder_end { file_pattern.find_first_not_of('#', placeholder_start) };
+    if (placeholder_end == std::string::npos) {
+        placeholder_end = file_pattern.size();
+    }
+
+    std::string prefix { file_pattern.substr(0, placeholder_start) };
+    std::string suffix { file_pattern.substr(placeholder_end) };
+    std::size_t min_digits { placeholder_end - placeholder_start };
+
+    std::filesystem::path directory { pattern.parent_path() };
+    if (directory.empty()) {
+        directory = ".";
+    }
+
+    std::vector<std::pair<unsigned long long, std::filesystem::path>> frames {};
+    for (const auto& entry : std::filesystem::directory_iterator { directory }) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+
+        std::string name { entry.path().filename().string() };
+        if (name.size() < prefix.size() + suffix.size() + min_digits || !name.starts_with(prefix) || !name.ends_with(suffix)) {
+            continue;
+        }
+
+        std::string digits { name.substr(prefix.size(), name.size() - prefix.size() - suffix.size()) };
+        if (!std::all_of(digits.begin(), digits.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+            continue;
+        }
+        frames.emplace_back(std::stoull(digits), entry.path());
+    }
+
+    if (frames.empty()) {
+        throw std::runtime_error("no frames match the series pattern");
+    }
+    std::sort(frames.begin(), frames.end());
+
+    std::vector<std::filesystem::path> paths {};
+    paths.reserve(frames.size());
+    for (auto& frame : frames) {
+        paths.push_back(std::move(frame.second));
+    }
+    return paths;
+}
+
+}
+
+VolumeSeries::VolumeSeries(const std::filesystem::path& pattern, VolumeLoader& loader,
+    std::size_t cache_budget, std::size_t prefetch_count)
+    : m_frames { find_frames(pattern) }
+    , m_loader { loader }
+    , m_cache { cache_budget }
+    , m_pending {}
+    , m_failed {}
+    , m_prefetch_count { prefetch_count }
+    , m_frame_bytes { 0 }
+{
+}
+
+VolumeSeries::~VolumeSeries()
+{
+    for (auto& [frame, load] : this->m_pending) {
+        load.cancel();
+    }
+}
+
+std::size_t VolumeSeries::frame_count() const
+{
+    return this->m_frames.size();
+}
+
+const std::filesystem::path& VolumeSeries::frame_path(std::size_t frame) const
+{
+    return this->m_frames.at(frame);
+}
+
+std::shared_ptr<const PVMVolume> VolumeSeries::request(std::size_t frame)
+{
+    if (frame >= this->m_frames.size()) {
+        throw std::out_of_range("frame index out of range");
+    }
+
+    this->collect();
+    this->prefetch(frame);
+
+    auto volume = this->m_cache.find(frame);
+    return volume ? *volume : nullptr;
+}
+
+std::shared_ptr<const PVMVolume> VolumeSeries::wait(std::size_t frame)
+{
+    if (auto volume = this->request(frame)) {
+        return volume;
+    }
+
+    auto it = this->m_pending.find(frame);
+    if (it == this->m_pending.end()) {
+        return nullptr;
+    }
+
+    VolumeLoadHandle load { std::move(it->second) };
+    this->m_pending.erase(it);
+    load.wait();
+
+    std::shared_ptr<const PVMVolume> volume { load.take() };
+    if (!volume) {
+        this->m_failed.insert(frame);
+        return nullptr;
+    }
+    this->m_frame_bytes = volume->byte_size();
+    this->m_cache.insert(frame, volume, volume->byte_size());
+    return volume;
+}
+
+bool VolumeSeries::failed(std::size_t frame) const
+{
+    return this->m_failed.contains(frame);
+}
+
+std::size_t VolumeSeries::prefetch_count() const
+{
+    return this->m_prefetch_count;
+}
+
+void VolumeSeries::set_prefetch_count(std::size_t count)
+{
+    this->m_prefetch_count = count;
+}
+
+std::size_t VolumeSeries::resident_bytes() const
+{
+    return this->m_cache.size();
+}
+
+std::size_t VolumeSeries::cache_budget() const
+{
+    return this->m_cache.budget();
+}
+
+std::size_t VolumeSeries::evict(std::size_t bytes)
+{
+    return this->m_cache.shrink(bytes);
+}
+
+std::size_t VolumeSeries::pending_count() const
+{
+    return this->m_pending.size();
+}
+
+void VolumeSeries::collect()
+{
+    for (auto it = this->m_pending.begin(); it != this->m_pending.end();) {
+        VolumeLoadHandle& load { it->second };
+        if (!load.done()) {
+            ++it;
+            continue;
+        }
+
+        std::shared_ptr<const PVMVolume> volume { load.take() };
+        if (volume) {
+            this->m_frame_bytes = volume->byte_size();
+            this->m_cache.insert(it->first, std::move(volume), this->m_frame_bytes);
+        } else if (load.status() == VolumeLoadStatus::Failed) {
+            this->m_failed.insert(it->first);
+        }
+        it = this->m_pending.erase(it);
+    }
+}
+
+void VolumeSeries::prefetch(std::size_t frame)
+{
+    // Never prefetch more frames than fit into the cache, otherwise the
+    // prefetched frames would evict each other before they are shown.
+    std::size_t frame_count { this->m_frames.size() };
+    std::size_t window { std::min(this->m_prefetch_count + 1, frame_count) };
+    if (this->m_frame_bytes != 0) {
+        window = std::min(window, std::max<std::size_t>(this->m_cache.budget() / this->m_frame_bytes, 1));
+    }
+
+    // Drop the loads that fell out of the window, e.g. after seeking.
+    for (auto it = this->m_pending.begin(); it != this->m_pending.end();) {
+        std::size_t offset { (it->first + frame_count - frame) % frame_count };
+        if (offset >= window) {
+            it->second.cancel();
+            it = this->m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (std::size_t i { 0 }; i < window; ++i) {
+        std::size_t index { (frame + i) % frame_count };
+        if (this->m_cache.contains(index) || this->m_pending.contains(index) || this->m_failed.contains(index)) {
+            continue;
+        }
+        this->m_pending.emplace(index, this->m_loader.load(this->m_frames[index]));
+    }
+}
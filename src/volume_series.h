@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <lru_cache.h>
+#include <pvm_volume.h>
+#include <volume_loader.h>
+
+/**
+ * Time series of PVM volumes, one file per time step.
+ *
+ * The frames are found with a file pattern, where a run of '#' characters
+ * stands for the frame number, e.g. `data/step_####.pvm`. Requesting a frame
+ * never blocks: missing frames are loaded in the background together with the
+ * following frames, and loaded frames are kept in a LRU cache bounded by a byte
+ * budget.
+ */
+class VolumeSeries {
+public:
+    /**
+     * Finds the frames of a series.
+     * @param pattern file pattern of the frames
+     * @param loader loader used for reading the frames
+     * @param cache_budget maximum number of bytes held by the frame cache
+     * @param prefetch_count number of frames loaded ahead of the requested one
+     */
+    VolumeSeries(const std::filesystem::path& pattern, VolumeLoader& loader,
+        std::size_t cache_budget, std::size_t prefetch_count = 4);
+    VolumeSeries(const VolumeSeries&) = delete;
+    VolumeSeries(VolumeSeries&&) = delete;
+    ~VolumeSeries();
+
+    VolumeSeries& operator=(const VolumeSeries&) = delete;
+    VolumeSeries& operator=(VolumeSeries&&) = delete;
+
+    /**
+     * Returns the number of frames in the series.
+     * @return number of frames
+     */
+    std::size_t frame_count() const;
+
+    /**
+     * Returns the path of a frame.
+     * @param frame frame index
+     * @return frame path
+     */
+    const std::filesystem::path& frame_path(std::size_t frame) const;
+
+    /**
+     * Returns a frame if it is resident and prefetches the following frames.
+     * @param frame frame index
+     * @return frame volume, or nullptr if the frame is not loaded yet
+     */
+    std::shared_ptr<const PVMVolume> request(std::size_t frame);
+
+    /**
+     * Returns a frame, blocking until it is loaded.
+     * @param frame frame index
+     * @return frame volume, or nullptr if the frame could not be loaded
+     */
+    std::shared_ptr<const PVMVolume> wait(std::size_t frame);
+
+    /**
+     * Checks if a frame could not be loaded.
+     * @param frame frame index
+     * @return loading the frame failed
+     */
+    bool failed(std::size_t frame) const;
+
+    /**
+     * Returns the number of frames loaded ahead of the requested one.
+     * @return prefetch count
+     */
+    std::size_t prefetch_count() const;
+
+    /**
+     * Sets the number of frames loaded ahead of the requested one.
+     * @param count prefetch count
+     */
+    void set_prefetch_count(std::size_t count);
+
+    /**
+     * Returns the number of bytes held by the frame cache.
+     * @return resident bytes
+     */
+    std::size_t resident_bytes() const;
+
+    /**
+     * Returns the maximum number of bytes held by the frame cache.
+     * @return cache budget
+     */
+    std::size_t cache_budget() const;
+
+    /**
+     * Evicts the least recently used frames, e.g. when a memory budget is exceeded.
+     * The cache is not locked, so like `request` this may only be called from the main thread.
+     * @param bytes minimum number of bytes to free
+     * @return number of bytes freed
+     */
+    std::size_t evict(std::size_t bytes);
+
+    /**
+     * Returns the number of frames that are currently being loaded.
+     * @return number of pending loads
+     */
+    std::size_t pending_count() const;
+
+private:
+    void collect();
+    void prefetch(std::size_t frame);
+
+    std::vector<std::filesystem::path> m_frames;
+    VolumeLoader& m_loader;
+    LRUCache<std::size_t, std::shared_ptr<const PVMVolume>> m_cache;
+    std::unordered_map<std::size_t, VolumeLoadHandle> m_pending;
+    std::unordered_set<std::size_t> m_failed;
+    std::size_t m_prefetch_count;
+    std::size_t m_frame_bytes;
+};
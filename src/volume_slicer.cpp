@@ -0,0 +1,347 @@
+#include <volume_slicer.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <task_scheduler.h>
+#include <volumeio.h>
+
+namespace {
+
+// Number of pixels whose coordinates and weights are computed together.
+constexpr std::size_t block_size { 8 };
+
+// Number of rows computed by each task.
+constexpr std::size_t rows_per_task { 16 };
+
+// Calls `function(row)` for all rows, in blocks on the workers of the calling scheduler.
+template <typename Function>
+void parallel_rows(std::size_t rows, const Function& function)
+{
+    glm::vec<3, std::size_t> extends { 1, rows, 1 };
+    TaskScheduler::current().parallel_for(extends, glm::vec<3, std::size_t> { 1, rows_per_task, 1 }, [&](const PVMRegion& block) {
+        for (std::size_t row { block.offset.y }; row < block.offset.y + block.extends.y; ++row) {
+            function(row);
+        }
+    });
+}
+
+void hash_combine(std::size_t& seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+}
+
+SlicePlane SlicePlane::axis_aligned(const PVMVolume& volume, SliceAxis axis, std::size_t index, std::size_t component)
+{
+    if (component >= volume.components()) {
+        throw std::out_of_range("component index out of range");
+    }
+
+    glm::vec3 origin { 0.0f };
+    switch (axis) {
+    case SliceAxis::X:
+        if (index >= volume.size_x()) {
+            throw std::out_of_range("x slice out of range");
+        }
+        origin.x = static_cast<float>(index);
+        return SlicePlane { origin, glm::vec3 { 0.0f, 1.0f, 0.0f }, glm::vec3 { 0.0f, 0.0f, 1.0f }, volume.size_y(), volume.size_z(), component };
+    case SliceAxis::Y:
+        if (index >= volume.size_y()) {
+            throw std::out_of_range("y slice out of range");
+        }
+        origin.y = static_cast<float>(index);
+        return SlicePlane { origin, glm::vec3 { 1.0f, 0.0f, 0.0f }, glm::vec3 { 0.0f, 0.0f, 1.0f }, volume.size_x(), volume.size_z(), component };
+    case SliceAxis::Z:
+        if (index >= volume.size_z()) {
+            throw std::out_of_range("z slice out of range");
+        }
+        origin.z = static_cast<float>(index);
+        return SlicePlane { origin, glm::vec3 { 1.0f, 0.0f, 0.0f }, glm::vec3 { 0.0f, 1.0f, 0.0f }, volume.size_x(), volume.size_y(), component };
+    default:
+        throw std::invalid_argument("invalid slice axis");
+    }
+}
+
+SlicePlane SlicePlane::oblique(const PVMVolume& volume, glm::vec3 center, glm::vec3 normal,
+    std::size_t width, std::size_t height, float spacing, std::size_t component)
+{
+    if (component >= volume.components()) {
+        throw std::out_of_range("component index out of range");
+    }
+    if (glm::length(normal) == 0.0f) {
+        throw std::invalid_argument("plane normal must not be zero");
+    }
+
+    // Build an orthonormal basis of the plane in physical space.
+    normal = glm::normalize(normal);
+    glm::vec3 helper { std::abs(normal.x) < 0.9f ? glm::vec3 { 1.0f, 0.0f, 0.0f } : glm::vec3 { 0.0f, 1.0f, 0.0f } };
+    glm::vec3 u { glm::normalize(glm::cross(helper, normal)) };
+    glm::vec3 v { glm::cross(normal, u) };
+
+    glm::vec3 origin { center - u * (spacing * static_cast<float>(width - 1) * 0.5f) - v * (spacing * static_cast<float>(height - 1) * 0.5f) };
+
+    // Voxel i covers [i * scale, (i + 1) * scale), so its center lies at (i + 0.5) * scale.
+    glm::vec3 scale { volume.scale() };
+    return SlicePlane { origin / scale - 0.5f, u * spacing / scale, v * spacing / scale, width, height, component };
+}
+
+SliceImage::SliceImage(std::size_t width, std::size_t height)
+    : m_pixels(width * height, 0.0f)
+    , m_pixels_memory { MemoryTag::Slices, width * height * sizeof(float) }
+    , m_width { width }
+    , m_height { height }
+{
+}
+
+std::size_t SliceImage::width() const
+{
+    return this->m_width;
+}
+
+std::size_t SliceImage::height() const
+{
+    return this->m_height;
+}
+
+float SliceImage::pixel(std::size_t x, std::size_t y) const
+{
+    if (x >= this->m_width || y >= this->m_height) {
+        throw std::out_of_range("pixel out of range");
+    }
+    return this->m_pixels[x + y * this->m_width];
+}
+
+float* SliceImage::data()
+{
+    return this->m_pixels.data();
+}
+
+const float* SliceImage::data() const
+{
+    return this->m_pixels.data();
+}
+
+std::size_t SliceImage::byte_size() const
+{
+    return this->m_pixels.size() * sizeof(float);
+}
+
+std::vector<unsigned char> SliceImage::to_8bit() const
+{
+    std::vector<unsigned char> pixels(this->m_pixels.size());
+    std::transform(this->m_pixels.begin(), this->m_pixels.end(), pixels.begin(), [](float value) {
+        // NaN, e.g. of constant components, maps to zero.
+        float clamped { value > 0.0f ? std::min(value, 1.0f) : 0.0f };
+        return static_cast<unsigned char>(clamped * 255.0f + 0.5f);
+    });
+    return pixels;
+}
+
+void SliceImage::write_pnm(const std::filesystem::path& path, bool high_precision) const
+{
+    if (this->m_width == 0 || this->m_height == 0) {
+        throw std::invalid_argument("cannot write an empty image");
+    }
+
+    std::string path_string { path.string() };
+    if (!high_precision) {
+        auto pixels = this->to_8bit();
+        writePNMimage(path_string.c_str(), pixels.data(), static_cast<unsigned int>(this->m_width),
+            static_cast<unsigned int>(this->m_height), 1);
+        return;
+    }
+
+    // 16-bit PNM files store big-endian values up to 32767.
+    std::vector<unsigned char> pixels(this->m_pixels.size() * 2);
+    for (std::size_t i { 0 }; i < this->m_pixels.size(); ++i) {
+        float value { this->m_pixels[i] };
+        float clamped { value > 0.0f ? std::min(value, 1.0f) : 0.0f };
+        auto quantized = static_cast<unsigned int>(clamped * 32767.0f + 0.5f);
+        pixels[2 * i] = static_cast<unsigned char>(quantized >> 8);
+        pixels[2 * i + 1] = static_cast<unsigned char>(quantized & 0xff);
+    }
+    writePNMimage(path_string.c_str(), pixels.data(), static_cast<unsigned int>(this->m_width),
+        static_cast<unsigned int>(this->m_height), 2);
+}
+
+VolumeSlicer::VolumeSlicer(std::shared_ptr<const PVMVolume> volume, std::size_t cache_budget)
+    : m_volume { std::move(volume) }
+    , m_mutex {}
+    , m_cache { cache_budget }
+{
+    if (!this->m_volume) {
+        throw std::invalid_argument("slicer requires a volume");
+    }
+}
+
+std::shared_ptr<const SliceImage> VolumeSlicer::slice(const SlicePlane& plane)
+{
+    if (plane.component >= this->m_volume->components()) {
+        throw std::out_of_range("component index out of range");
+    }
+
+    {
+        std::scoped_lock lock { this->m_mutex };
+        if (auto cached = this->m_cache.find(plane)) {
+            return *cached;
+        }
+    }
+
+    // Extract without holding the lock, so other slices can be served meanwhile.
+    auto image = std::make_shared<SliceImage>(plane.width, plane.height);
+    this->extract(plane, *image);
+
+    std::scoped_lock lock { this->m_mutex };
+    this->m_cache.insert(plane, image, image->byte_size());
+    return image;
+}
+
+std::shared_ptr<const SliceImage> VolumeSlicer::slice(SliceAxis axis, std::size_t index, std::size_t component)
+{
+    return this->slice(SlicePlane::axis_aligned(*this->m_volume, axis, index, component));
+}
+
+const std::shared_ptr<const PVMVolume>& VolumeSlicer::volume() const
+{
+    return this->m_volume;
+}
+
+std::size_t VolumeSlicer::cached_bytes() const
+{
+    std::scoped_lock lock { this->m_mutex };
+    return this->m_cache.size();
+}
+
+std::size_t VolumeSlicer::PlaneHash::operator()(const SlicePlane& plane) const
+{
+    std::size_t seed { 0 };
+    for (const glm::vec3& vector : { plane.origin, plane.u, plane.v }) {
+        for (int i { 0 }; i < 3; ++i) {
+            hash_combine(seed, std::bit_cast<std::uint32_t>(vector[i]));
+        }
+    }
+    hash_combine(seed, plane.width);
+    hash_combine(seed, plane.height);
+    hash_combine(seed, plane.component);
+    return seed;
+}
+
+void VolumeSlicer::extract(const SlicePlane& plane, SliceImage& image) const
+{
+    const PVMVolume& volume { *this->m_volume };
+    const float* data { volume.data() };
+    const std::size_t components { volume.components() };
+    const std::size_t channel { components - 1 - plane.component };
+    const std::ptrdiff_t size[3] { static_cast<std::ptrdiff_t>(volume.size_x()),
+        static_cast<std::ptrdiff_t>(volume.size_y()), static_cast<std::ptrdiff_t>(volume.size_z()) };
+    const std::ptrdiff_t stride[3] { static_cast<std::ptrdiff_t>(components),
+        static_cast<std::ptrdiff_t>(components) * size[0], static_cast<std::ptrdiff_t>(components) * size[0] * size[1] };
+
+    // Planes on the voxel grid are copied without resampling.
+    auto is_axis = [](glm::vec3 vector) {
+        return glm::abs(vector) == glm::vec3 { 1.0f, 0.0f, 0.0f } || glm::abs(vector) == glm::vec3 { 0.0f, 1.0f, 0.0f }
+            || glm::abs(vector) == glm::vec3 { 0.0f, 0.0f, 1.0f };
+    };
+    bool on_grid { is_axis(plane.u) && is_axis(plane.v) && glm::floor(plane.origin) == plane.origin };
+
+    if (on_grid) {
+        glm::ivec3 u { plane.u };
+        glm::ivec3 v { plane.v };
+        glm::ivec3 origin { plane.origin };
+        std::ptrdiff_t u_offset { u.x * stride[0] + u.y * stride[1] + u.z * stride[2] };
+        parallel_rows(plane.height, [&](std::size_t row) {
+            float* output { image.data() + row * plane.width };
+            glm::ivec3 start { origin + v * static_cast<int>(row) };
+            for (std::size_t column { 0 }; column < plane.width; ++column) {
+                glm::ivec3 position { start + u * static_cast<int>(column) };
+                bool inside { position.x >= 0 && position.x < size[0] && position.y >= 0 && position.y < size[1]
+                    && position.z >= 0 && position.z < size[2] };
+                if (!inside) {
+                    output[column] = 0.0f;
+                    continue;
+                }
+
+                // Continue along the row while it stays inside of the volume.
+                const float* input { data + position.x * stride[0] + position.y * stride[1] + position.z * stride[2] + channel };
+                for (; column < plane.width; ++column, input += u_offset) {
+                    position = start + u * static_cast<int>(column);
+                    if (position.x < 0 || position.x >= size[0] || position.y < 0 || position.y >= size[1]
+                        || position.z < 0 || position.z >= size[2]) {
+                        output[column] = 0.0f;
+                        break;
+                    }
+                    output[column] = *input;
+                }
+            }
+        });
+        return;
+    }
+
+    parallel_rows(plane.height, [&](std::size_t row) {
+        float* output { image.data() + row * plane.width };
+        glm::vec3 row_origin { plane.origin + plane.v * static_cast<float>(row) };
+
+        alignas(32) float weights[3][block_size];
+        alignas(32) float corners[8][block_size];
+        alignas(32) std::ptrdiff_t offsets[3][block_size];
+        alignas(32) std::ptrdiff_t next[3][block_size];
+        alignas(32) bool inside[block_size];
+
+        for (std::size_t block { 0 }; block < plane.width; block += block_size) {
+            std::size_t count { std::min(block_size, plane.width - block) };
+
+            // Coordinates, clamped cell corners and interpolation weights.
+            for (int axis { 0 }; axis < 3; ++axis) {
+                float max_coordinate { static_cast<float>(size[axis] - 1) };
+                for (std::size_t i { 0 }; i < block_size; ++i) {
+                    float coordinate { row_origin[axis] + plane.u[axis] * static_cast<float>(block + i) };
+                    float clamped { std::clamp(coordinate, 0.0f, max_coordinate) };
+                    float cell { std::floor(clamped) };
+                    weights[axis][i] = clamped - cell;
+                    offsets[axis][i] = static_cast<std::ptrdiff_t>(cell);
+                    next[axis][i] = std::min(offsets[axis][i] + 1, size[axis] - 1) - offsets[axis][i];
+                    if (axis == 0) {
+                        inside[i] = true;
+                    }
+                    inside[i] = inside[i] && coordinate >= -0.5f && coordinate <= max_coordinate + 0.5f;
+                }
+            }
+
+            // Fetch the 8 corners of each cell.
+            for (std::size_t i { 0 }; i < count; ++i) {
+                const float* base { data + offsets[0][i] * stride[0] + offsets[1][i] * stride[1] + offsets[2][i] * stride[2] + channel };
+                std::ptrdiff_t dx { next[0][i] * stride[0] };
+                std::ptrdiff_t dy { next[1][i] * stride[1] };
+                std::ptrdiff_t dz { next[2][i] * stride[2] };
+                corners[0][i] = base[0];
+                corners[1][i] = base[dx];
+                corners[2][i] = base[dy];
+                corners[3][i] = base[dx + dy];
+                corners[4][i] = base[dz];
+                corners[5][i] = base[dx + dz];
+                corners[6][i] = base[dy + dz];
+                corners[7][i] = base[dx + dy + dz];
+            }
+
+            // Blend the corners.
+            for (std::size_t i { 0 }; i < count; ++i) {
+                float wx { weights[0][i] };
+                float wy { weights[1][i] };
+                float wz { weights[2][i] };
+                float c00 { corners[0][i] + (corners[1][i] - corners[0][i]) * wx };
+                float c10 { corners[2][i] + (corners[3][i] - corners[2][i]) * wx };
+                float c01 { corners[4][i] + (corners[5][i] - corners[4][i]) * wx };
+                float c11 { corners[6][i] + (corners[7][i] - corners[6][i]) * wx };
+                float c0 { c00 + (c10 - c00) * wy };
+                float c1 { c01 + (c11 - c01) * wy };
+                output[block + i] = inside[i] ? c0 + (c1 - c0) * wz : 0.0f;
+            }
+        }
+    });
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <lru_cache.h>
+#include <memory_tracker.h>
+#include <pvm_volume.h>
+
+/**
+ * Axes of a volume.
+ */
+enum class SliceAxis {
+    X,
+    Y,
+    Z,
+};
+
+/**
+ * Rectangular plane sampled from a volume.
+ *
+ * Positions are given in voxel coordinates, where the center of voxel
+ * (x, y, z) lies at (x, y, z). Pixel (i, j) of the image samples the
+ * position `origin + i * u + j * v`.
+ */
+struct SlicePlane {
+    glm::vec3 origin;
+    glm::vec3 u;
+    glm::vec3 v;
+    std::size_t width;
+    std::size_t height;
+    std::size_t component;
+
+    /**
+     * Creates the plane of a whole axis-aligned slice.
+     * The image axes are the two remaining volume axes in x, y, z order.
+     * @param volume sliced volume
+     * @param axis axis orthogonal to the slice
+     * @param index index of the slice along the axis
+     * @param component sampled component
+     * @return slice plane
+     */
+    static SlicePlane axis_aligned(const PVMVolume& volume, SliceAxis axis, std::size_t index, std::size_t component = 0);
+
+    /**
+     * Creates an oblique plane from physical positions.
+     * The voxel scale is taken into account, so the plane is not distorted
+     * for anisotropic volumes.
+     * @param volume sliced volume
+     * @param center center of the plane, in the units of `voxel_position_start`
+     * @param normal normal of the plane
+     * @param width number of pixels in each row
+     * @param height number of rows
+     * @param spacing distance between two pixels, in the units of `voxel_position_start`
+     * @param component sampled component
+     * @return slice plane
+     */
+    static SlicePlane oblique(const PVMVolume& volume, glm::vec3 center, glm::vec3 normal,
+        std::size_t width, std::size_t height, float spacing, std::size_t component = 0);
+
+    bool operator==(const SlicePlane&) const = default;
+};
+
+/**
+ * Image of normalized values sampled from a volume.
+ */
+class SliceImage {
+public:
+    /**
+     * Creates an image filled with zeros.
+     * @param width number of pixels in each row
+     * @param height number of rows
+     */
+    SliceImage(std::size_t width, std::size_t height);
+    SliceImage(const SliceImage&) = default;
+    SliceImage(SliceImage&&) noexcept = default;
+    ~SliceImage() = default;
+
+    SliceImage& operator=(const SliceImage&) = default;
+    SliceImage& operator=(SliceImage&&) noexcept = default;
+
+    std::size_t width() const;
+    std::size_t height() const;
+
+    /**
+     * Returns the normalized value of a pixel.
+     * @param x column of the pixel
+     * @param y row of the pixel
+     * @return pixel value
+     */
+    float pixel(std::size_t x, std::size_t y) const;
+
+    /**
+     * Returns the pixels, row by row.
+     * @return pixel data
+     */
+    float* data();
+    const float* data() const;
+
+    /**
+     * Returns the size of the pixel data in bytes.
+     * @return data size
+     */
+    std::size_t byte_size() const;
+
+    /**
+     * Converts the image to 8-bit values. Values outside of [0, 1] are clamped.
+     * @return pixels, row by row
+     */
+    std::vector<unsigned char> to_8bit() const;
+
+    /**
+     * Writes the image as grayscale PNM file using `writePNMimage`.
+     * @param path path of the written file
+     * @param high_precision write 15-bit instead of 8-bit values
+     */
+    void write_pnm(const std::filesystem::path& path, bool high_precision = false) const;
+
+private:
+    std::vector<float> m_pixels;
+    TrackedAllocation m_pixels_memory;
+    std::size_t m_width;
+    std::size_t m_height;
+};
+
+/**
+ * Extracts axis-aligned and oblique slices from a volume.
+ *
+ * The rows of a slice are computed on the workers of the calling
+ * `TaskScheduler`. Oblique slices are resampled trilinearly, in blocks of
+ * pixels whose coordinate and weight computations the compiler can vectorize.
+ * Axis-aligned slices are copied without resampling. Recent slices are kept
+ * in an LRU cache, so scrubbing back and forth does not recompute them.
+ */
+class VolumeSlicer {
+public:
+    /**
+     * Creates a slicer for a volume.
+     * @param volume sliced volume
+     * @param cache_budget maximum number of bytes of cached slices
+     */
+    VolumeSlicer(std::shared_ptr<const PVMVolume> volume, std::size_t cache_budget = 32 << 20);
+    VolumeSlicer(const VolumeSlicer&) = delete;
+    VolumeSlicer(VolumeSlicer&&) = delete;
+    ~VolumeSlicer() = default;
+
+    VolumeSlicer& operator=(const VolumeSlicer&) = delete;
+    VolumeSlicer& operator=(VolumeSlicer&&) = delete;
+
+    /**
+     * Returns the slice on a plane, computing it if it is not cached.
+     * Pixels outside of the volume are zero.
+     * @param plane sampled plane
+     * @return slice image
+     */
+    std::shared_ptr<const SliceImage> slice(const SlicePlane& plane);
+
+    /**
+     * Returns a whole axis-aligned slice.
+     * @param axis axis orthogonal to the slice
+     * @param index index of the slice along the axis
+     * @param component sampled component
+     * @return slice image
+     */
+    std::shared_ptr<const SliceImage> slice(SliceAxis axis, std::size_t index, std::size_t component = 0);
+
+    /**
+     * Returns the sliced volume.
+     * @return volume
+     */
+    const std::shared_ptr<const PVMVolume>& volume() const;
+
+    /**
+     * Returns the number of bytes of the cached slices.
+     * @return cached bytes
+     */
+    std::size_t cached_bytes() const;
+
+private:
+    struct PlaneHash {
+        std::size_t operator()(const SlicePlane& plane) const;
+    };
+
+    void extract(const SlicePlane& plane, SliceImage& image) const;
+
+    std::shared_ptr<const PVMVolume> m_volume;
+    mutable std::mutex m_mutex;
+    LRUCache<SlicePlane, std::shared_ptr<const SliceImage>, PlaneHash> m_cache;
+};
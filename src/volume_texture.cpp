@@ -0,0 +1,243 @@
+#include <volume_texture.h>
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+VolumeTexture::VolumeTexture(wgpu::Device& device, glm::vec<3, std::size_t> extends, std::size_t components)
+    : m_texture { nullptr }
+    , m_view { nullptr }
+    , m_extends { extends }
+    , m_components { components }
+    , m_memory { MemoryTag::GPUTextures }
+{
+    wgpu::TextureDescriptor desc { wgpu::Default };
+    desc.label = "Volume texture";
+    desc.dimension = wgpu::TextureDimension::_3D;
+    desc.size.width = static_cast<std::uint32_t>(extends.x);
+    desc.size.height = static_cast<std::uint32_t>(extends.y);
+    desc.size.depthOrArrayLayers = static_cast<std::uint32_t>(extends.z);
+    desc.format = VolumeTexture::format(components);
+    // Storage binding and copy source allow filling and reading it back with compute shaders.
+    desc.usage = wgpu::TextureUsage::TextureBinding | wgpu::TextureUsage::StorageBinding
+        | wgpu::TextureUsage::CopyDst | wgpu::TextureUsage::CopySrc;
+    desc.mipLevelCount = 1;
+    desc.sampleCount = 1;
+    this->m_texture = device.createTexture(desc);
+    if (!this->m_texture) {
+        throw std::runtime_error("could not create the volume texture");
+    }
+    this->m_view = this->m_texture.createView();
+    this->m_memory.resize(this->byte_size());
+}
+
+VolumeTexture::VolumeTexture(VolumeTexture&& texture)
+    : m_texture { std::exchange(texture.m_texture, nullptr) }
+    , m_view { std::exchange(texture.m_view, nullptr) }
+    , m_extends { texture.m_extends }
+    , m_components { texture.m_components }
+    , m_memory { std::move(texture.m_memory) }
+{
+}
+
+VolumeTexture::~VolumeTexture()
+{
+    if (this->m_view) {
+        this->m_view.release();
+    }
+
+    if (this->m_texture) {
+        this->m_texture.destroy();
+        this->m_texture.release();
+    }
+}
+
+bool VolumeTexture::supported(std::size_t components)
+{
+    return components == 1 || components == 2 || components == 4;
+}
+
+wgpu::TextureFormat VolumeTexture::format(std::size_t components)
+{
+    switch (components) {
+    case 1:
+        return wgpu::TextureFormat::R32Float;
+    case 2:
+        return wgpu::TextureFormat::RG32Float;
+    case 4:
+        return wgpu::TextureFormat::RGBA32Float;
+    default:
+        throw std::invalid_argument("no texture format for the number of components");
+    }
+}
+
+bool VolumeTexture::compatible(const PVMVolume& volume) const
+{
+    return volume.extends() == this->m_extends && volume.components() == this->m_components;
+}
+
+void VolumeTexture::upload(wgpu::Queue& queue, const PVMVolume& volume)
+{
+    if (!this->compatible(volume)) {
+        throw std::invalid_argument("volume does not match the texture");
+    }
+
+    wgpu::ImageCopyTexture destination { wgpu::Default };
+    destination.texture = this->m_texture;
+    destination.mipLevel = 0;
+    destination.aspect = wgpu::TextureAspect::All;
+
+    wgpu::TextureDataLayout layout { wgpu::Default };
+    layout.offset = 0;
+    layout.bytesPerRow = static_cast<std::uint32_t>(this->m_extends.x * this->m_components * sizeof(float));
+    layout.rowsPerImage = static_cast<std::uint32_t>(this->m_extends.y);
+
+    wgpu::Extent3D size { wgpu::Default };
+    size.width = static_cast<std::uint32_t>(this->m_extends.x);
+    size.height = static_cast<std::uint32_t>(this->m_extends.y);
+    size.depthOrArrayLayers = static_cast<std::uint32_t>(this->m_extends.z);
+
+    queue.writeTexture(destination, volume.data(), volume.byte_size(), layout, size);
+}
+
+void VolumeTexture::upload(wgpu::Queue& queue, const PVMVolume& volume, glm::vec<3, std::size_t> offset)
+{
+    glm::vec<3, std::size_t> volume_extends { volume.extends() };
+    if (volume.components() != this->m_components || glm::any(glm::greaterThan(offset + this->m_extends, volume_extends))) {
+        throw std::invalid_argument("region does not match the texture");
+    }
+
+    wgpu::ImageCopyTexture destination { wgpu::Default };
+    destination.texture = this->m_texture;
+    destination.mipLevel = 0;
+    destination.aspect = wgpu::TextureAspect::All;
+
+    // The rows of the region are read in place, with the strides of the whole volume.
+    std::size_t voxel_bytes { this->m_components * sizeof(float) };
+    std::size_t row_bytes { volume_extends.x * voxel_bytes };
+    std::size_t slice_bytes { row_bytes * volume_extends.y };
+    std::size_t first_byte { offset.x * voxel_bytes + offset.y * row_bytes + offset.z * slice_bytes };
+    std::size_t last_byte { (offset.x + this->m_extends.x) * voxel_bytes + (offset.y + this->m_extends.y - 1) * row_bytes
+        + (offset.z + this->m_extends.z - 1) * slice_bytes };
+
+    wgpu::TextureDataLayout layout { wgpu::Default };
+    layout.offset = 0;
+    layout.bytesPerRow = static_cast<std::uint32_t>(row_bytes);
+    layout.rowsPerImage = static_cast<std::uint32_t>(volume_extends.y);
+
+    wgpu::Extent3D size { wgpu::Default };
+    size.width = static_cast<std::uint32_t>(this->m_extends.x);
+    size.height = static_cast<std::uint32_t>(this->m_extends.y);
+    size.depthOrArrayLayers = static_cast<std::uint32_t>(this->m_extends.z);
+
+    const auto* data = reinterpret_cast<const unsigned char*>(volume.data());
+    queue.writeTexture(destination, data + first_byte, last_byte - first_byte, layout, size);
+}
+
+void VolumeTexture::upload(wgpu::Queue& queue, const PlanarVolume& volume, std::size_t component)
+{
+    if (volume.extends() != this->m_extends || this->m_components != 1) {
+        throw std::invalid_argument("component does not match the texture");
+    }
+    std::span<const float> plane { volume.plane(component) };
+
+    wgpu::ImageCopyTexture destination { wgpu::Default };
+    destination.texture = this->m_texture;
+    destination.mipLevel = 0;
+    destination.aspect = wgpu::TextureAspect::All;
+
+    wgpu::TextureDataLayout layout { wgpu::Default };
+    layout.offset = 0;
+    layout.bytesPerRow = static_cast<std::uint32_t>(this->m_extends.x * sizeof(float));
+    layout.rowsPerImage = static_cast<std::uint32_t>(this->m_extends.y);
+
+    wgpu::Extent3D size { wgpu::Default };
+    size.width = static_cast<std::uint32_t>(this->m_extends.x);
+    size.height = static_cast<std::uint32_t>(this->m_extends.y);
+    size.depthOrArrayLayers = static_cast<std::uint32_t>(this->m_extends.z);
+
+    queue.writeTexture(destination, plane.data(), plane.size_bytes(), layout, size);
+}
+
+glm::vec<3, std::size_t> VolumeTexture::extends() const
+{
+    return this->m_extends;
+}
+
+std::size_t VolumeTexture::byte_size() const
+{
+    return this->m_extends.x * this->m_extends.y * this->m_extends.z * this->m_components * sizeof(float);
+}
+
+wgpu::Texture& VolumeTexture::texture()
+{
+    return this->m_texture;
+}
+
+wgpu::TextureView& VolumeTexture::view()
+{
+    return this->m_view;
+}
+
+VolumeTextureDoubleBuffer::VolumeTextureDoubleBuffer(wgpu::Device& device)
+    : m_device { device }
+    , m_textures {}
+    , m_volumes {}
+    , m_front { 0 }
+    , m_staged { false }
+{
+}
+
+void VolumeTextureDoubleBuffer::stage(std::shared_ptr<const PVMVolume> volume)
+{
+    if (!volume || !VolumeTexture::supported(volume->components())) {
+        return;
+    }
+
+    std::size_t back { 1 - this->m_front };
+    auto& texture = this->m_textures[back];
+    if (!texture || !texture->compatible(*volume)) {
+        texture = std::make_unique<VolumeTexture>(this->m_device, volume->extends(), volume->components());
+    }
+
+    auto queue = this->m_device.getQueue();
+    texture->upload(queue, *volume);
+    queue.release();
+
+    this->m_volumes[back] = std::move(volume);
+    this->m_staged = true;
+}
+
+void VolumeTextureDoubleBuffer::stage(std::unique_ptr<VolumeTexture> texture)
+{
+    if (!texture) {
+        return;
+    }
+
+    std::size_t back { 1 - this->m_front };
+    this->m_textures[back] = std::move(texture);
+    this->m_volumes[back] = nullptr;
+    this->m_staged = true;
+}
+
+bool VolumeTextureDoubleBuffer::swap()
+{
+    if (!this->m_staged) {
+        return false;
+    }
+
+    this->m_front = 1 - this->m_front;
+    this->m_staged = false;
+    return true;
+}
+
+VolumeTexture* VolumeTextureDoubleBuffer::front()
+{
+    return this->m_textures[this->m_front].get();
+}
+
+const std::shared_ptr<const PVMVolume>& VolumeTextureDoubleBuffer::front_volume() const
+{
+    return this->m_volumes[this->m_front];
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+
+#include <webgpu/webgpu.hpp>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+#include <memory_tracker.h>
+#include <pvm_volume.h>
+#include <volume_layout.h>
+
+/**
+ * 3D texture holding the normalized data of a volume.
+ */
+class VolumeTexture {
+public:
+    /**
+     * Creates an uninitialized volume texture.
+     * @param device device owning the texture
+     * @param extends number of voxels in each direction
+     * @param components number of components of each voxel
+     */
+    VolumeTexture(wgpu::Device& device, glm::vec<3, std::size_t> extends, std::size_t components);
+    VolumeTexture(const VolumeTexture&) = delete;
+    VolumeTexture(VolumeTexture&&);
+    ~VolumeTexture();
+
+    VolumeTexture& operator=(const VolumeTexture&) = delete;
+    VolumeTexture& operator=(VolumeTexture&&) = delete;
+
+    /**
+     * Checks if a texture format exists for a number of components.
+     * @param components number of components of each voxel
+     * @return components can be uploaded
+     */
+    static bool supported(std::size_t components);
+
+    /**
+     * Returns the texture format used for a number of components.
+     * @param components number of components of each voxel
+     * @return texture format
+     */
+    static wgpu::TextureFormat format(std::size_t components);
+
+    /**
+     * Checks if the volume can be uploaded into the texture.
+     * @param volume volume to check
+     * @return volume matches the extends and components of the texture
+     */
+    bool compatible(const PVMVolume& volume) const;
+
+    /**
+     * Enqueues a copy of the volume data into the texture.
+     * @param queue queue of the device owning the texture
+     * @param volume volume to upload
+     */
+    void upload(wgpu::Queue& queue, const PVMVolume& volume);
+
+    /**
+     * Enqueues a copy of a region of the volume data into the texture.
+     * The region starts at `offset` and has the extends of the texture.
+     * @param queue queue of the device owning the texture
+     * @param volume volume to upload
+     * @param offset first voxel of the region
+     */
+    void upload(wgpu::Queue& queue, const PVMVolume& volume, glm::vec<3, std::size_t> offset);
+
+    /**
+     * Enqueues a copy of a single component into a texture with one component.
+     * The plane of the component is read in place.
+     * @param queue queue of the device owning the texture
+     * @param volume volume with the planar layout
+     * @param component uploaded component
+     */
+    void upload(wgpu::Queue& queue, const PlanarVolume& volume, std::size_t component);
+
+    /**
+     * Returns the number of voxels in each direction.
+     * @return extends of the texture
+     */
+    glm::vec<3, std::size_t> extends() const;
+
+    /**
+     * Returns the size of the texture data in bytes.
+     * @return texture size
+     */
+    std::size_t byte_size() const;
+
+    wgpu::Texture& texture();
+    wgpu::TextureView& view();
+
+private:
+    wgpu::Texture m_texture;
+    wgpu::TextureView m_view;
+    glm::vec<3, std::size_t> m_extends;
+    std::size_t m_components;
+    TrackedAllocation m_memory;
+};
+
+/**
+ * Pair of volume textures for uploading time steps without stalling the renderer.
+ *
+ * The renderer samples the front texture, while the next volume is uploaded
+ * into the back texture. `swap()` exchanges both at a frame boundary.
+ */
+class VolumeTextureDoubleBuffer {
+public:
+    VolumeTextureDoubleBuffer(wgpu::Device& device);
+    VolumeTextureDoubleBuffer(const VolumeTextureDoubleBuffer&) = delete;
+    VolumeTextureDoubleBuffer(VolumeTextureDoubleBuffer&&) = default;
+    ~VolumeTextureDoubleBuffer() = default;
+
+    VolumeTextureDoubleBuffer& operator=(const VolumeTextureDoubleBuffer&) = delete;
+    VolumeTextureDoubleBuffer& operator=(VolumeTextureDoubleBuffer&&) = delete;
+
+    /**
+     * Uploads a volume into the back texture.
+     * Volumes without a matching texture format are ignored.
+     * @param volume volume to upload
+     */
+    void stage(std::shared_ptr<const PVMVolume> volume);
+
+    /**
+     * Makes an already filled texture the back texture.
+     * The texture has no associated volume.
+     * @param texture texture to stage
+     */
+    void stage(std::unique_ptr<VolumeTexture> texture);
+
+    /**
+     * Makes the last staged volume the front.
+     * @return a staged volume was swapped to the front
+     */
+    bool swap();
+
+    /**
+     * Returns the texture sampled by the renderer.
+     * @return front texture, or nullptr if nothing was uploaded yet
+     */
+    VolumeTexture* front();
+
+    /**
+     * Returns the volume contained in the front texture.
+     * @return front volume
+     */
+    const std::shared_ptr<const PVMVolume>& front_volume() const;
+
+private:
+    wgpu::Device m_device;
+    std::array<std::unique_ptr<VolumeTexture>, 2> m_textures;
+    std::array<std::shared_ptr<const PVMVolume>, 2> m_volumes;
+    std::size_t m_front;
+    bool m_staged;
+};
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#pragma warning(push, 3)
+#include <glm/glm.hpp>
+#pragma warning(pop)
+
+/**
+ * Component count of a `VolumeView` that is only known at runtime.
+ */
+inline constexpr std::size_t dynamic_components { 0 };
+
+/**
+ * Non-owning view of voxels with interleaved components, x-fastest.
+ *
+ * The components of each voxel are stored in reversed order, like in
+ * `PVMVolume::data()` and in the slices of `read_pvm_slices`. If the number of
+ * components is a template argument, all index arithmetic uses it as a
+ * constant, so loops over the components of a voxel are unrolled and loops
+ * over the voxels vectorize. Views with `dynamic_components` take the count
+ * at runtime and serve as generic fallback. The accessors are not bounds
+ * checked.
+ */
+template <typename T, std::size_t Components = dynamic_components>
+class VolumeView {
+public:
+    static constexpr std::size_t static_components { Components };
+
+    /**
+     * Creates a view of voxel data.
+     * @param data first component of the first voxel
+     * @param extends number of voxels in each direction
+     * @param components number of components of each voxel, must match `Components` unless it is dynamic
+     */
+    VolumeView(T* data, glm::vec<3, std::size_t> extends, std::size_t components = Components)
+        : m_data { data }
+        , m_extends { extends }
+        , m_components { components }
+    {
+        if (components == 0) {
+            throw std::invalid_argument("a volume view requires at least one component");
+        }
+        if (Components != dynamic_components && components != Components) {
+            throw std::invalid_argument("component count does not match the view");
+        }
+    }
+
+    /**
+     * Converts a view, e.g. from a mutable to a constant or from a dynamic to a fixed component count.
+     * Conversions to a fixed component count are explicit and checked.
+     * @param view converted view
+     */
+    template <typename U, std::size_t OtherComponents>
+        requires std::is_convertible_v<U*, T*>
+    explicit(Components != dynamic_components && OtherComponents != Components)
+        VolumeView(const VolumeView<U, OtherComponents>& view)
+        : VolumeView(view.data(), view.extends(), view.components())
+    {
+    }
+
+    VolumeView(const VolumeView&) = default;
+    VolumeView(VolumeView&&) noexcept = default;
+    ~VolumeView() = default;
+
+    VolumeView& operator=(const VolumeView&) = default;
+    VolumeView& operator=(VolumeView&&) noexcept = default;
+
+    /**
+     * Returns the number of components for each voxel.
+     * @return components for each voxel
+     */
+    std::size_t components() const
+    {
+        if constexpr (Components == dynamic_components) {
+            return this->m_components;
+        } else {
+            return Components;
+        }
+    }
+
+    /**
+     * Returns the extends (size_x, size_y, size_z) of the volume.
+     * @return volume extends
+     */
+    glm::vec<3, std::size_t> extends() const
+    {
+        return this->m_extends;
+    }
+
+    /**
+     * Returns the number of voxels.
+     * @return voxel count
+     */
+    std::size_t voxel_count() const
+    {
+        return this->m_extends.x * this->m_extends.y * this->m_extends.z;
+    }
+
+    /**
+     * Returns the viewed data.
+     * @return first component of the first voxel
+     */
+    T* data() const
+    {
+        return this->m_data;
+    }
+
+    /**
+     * Returns the linear index of a voxel.
+     * @param x x grid position
+     * @param y y grid position
+     * @param z z grid position
+     * @return voxel index
+     */
+    std::size_t voxel_index(std::size_t x, std::size_t y, std::size_t z) const
+    {
+        return x + (y + z * this->m_extends.y) * this->m_extends.x;
+    }
+
+    /**
+     * Returns a component of a voxel.
+     * @param voxel linear voxel index
+     * @param component voxel component
+     * @return component value
+     */
+    T& at(std::size_t voxel, std::size_t component) const
+    {
+        return this->m_data[voxel * this->components() + (this->components() - 1 - component)];
+    }
+
+    /**
+     * Returns a component of a voxel.
+     * @param x x grid position
+     * @param y y grid position
+     * @param z z grid position
+     * @param component voxel component
+     * @return component value
+     */
+    T& operator()(std::size_t x, std::size_t y, std::size_t z, std::size_t component) const
+    {
+        return this->at(this->voxel_index(x, y, z), component);
+    }
+
+private:
+    T* m_data;
+    glm::vec<3, std::size_t> m_extends;
+    std::size_t m_components;
+};
+
+/**
+ * Calls a function with a view specialized for the component count of a volume.
+ *
+ * Volumes with one to four components get a view with a fixed count, all
+ * others the dynamic view itself. The function is instantiated for each of
+ * them, so it is usually a generic lambda, and has to return the same type
+ * for all of them.
+ * @param view dynamic view of the volume
+ * @param function function taking a `VolumeView`
+ * @return result of the function
+ */
+template <typename T, typename Function>
+decltype(auto) visit_components(const VolumeView<T>& view, Function&& function)
+{
+    switch (view.components()) {
+    case 1:
+        return std::forward<Function>(function)(VolumeView<T, 1> { view });
+    case 2:
+        return std::forward<Function>(function)(VolumeView<T, 2> { view });
+    case 3:
+        return std::forward<Function>(function)(VolumeView<T, 3> { view });
+    case 4:
+        return std::forward<Function>(function)(VolumeView<T, 4> { view });
+    default:
+        return std::forward<Function>(function)(view);
+    }
+}
+
+namespace volume_view_detail {
+
+// Per-component values kept in registers for fixed component counts.
+template <std::size_t Components>
+using ComponentValues = std::conditional_t<Components == dynamic_components, std::vector<float>,
+    std::array<float, Components>>;
+
+template <std::size_t Components>
+ComponentValues<Components> component_values(std::size_t components, float value)
+{
+    ComponentValues<Components> values {};
+    if constexpr (Components == dynamic_components) {
+        values.resize(components);
+    }
+    std::fill(values.begin(), values.end(), value);
+    return values;
+}
+
+// Neighbors and difference weights of the central differences along one
+// axis, falling back to one-sided differences at the borders.
+struct AxisStencil {
+    std::vector<std::size_t> lower;
+    std::vector<std::size_t> upper;
+    std::vector<float> weight;
+};
+
+inline AxisStencil axis_stencil(std::size_t size, std::size_t stride)
+{
+    AxisStencil stencil { std::vector<std::size_t>(size), std::vector<std::size_t>(size), std::vector<float>(size) };
+    for (std::size_t i { 0 }; i < size; ++i) {
+        std::size_t lower { i > 0 ? i - 1 : 0 };
+        std::size_t upper { i + 1 < size ? i + 1 : i };
+        stencil.lower[i] = lower * stride;
+        stencil.upper[i] = upper * stride;
+        stencil.weight[i] = upper > lower ? 1.0f / static_cast<float>(upper - lower) : 0.0f;
+    }
+    return stencil;
+}
+
+inline std::size_t histogram_bin(float value, float bin_scale, std::size_t bins)
+{
+    // NaNs of constant components end up in the first bin.
+    return value > 0.0f ? std::min(static_cast<std::size_t>(value * bin_scale), bins - 1) : 0;
+}
+
+}
+
+/**
+ * Extends value ranges by the components of the voxels of a view.
+ * @param view voxels
+ * @param ranges minimum (x) and maximum (y) of each component, updated in place
+ */
+template <typename T, std::size_t Components>
+void accumulate_voxel_ranges(VolumeView<T, Components> view, std::span<glm::vec2> ranges)
+{
+    std::size_t components { view.components() };
+    auto minimum = volume_view_detail::component_values<Components>(components, 0.0f);
+    auto maximum = volume_view_detail::component_values<Components>(components, 0.0f);
+    for (std::size_t slot { 0 }; slot < components; ++slot) {
+        minimum[slot] = ranges[components - 1 - slot].x;
+        maximum[slot] = ranges[components - 1 - slot].y;
+    }
+
+    const T* data { view.data() };
+    std::size_t voxels { view.voxel_count() };
+    for (std::size_t i { 0 }; i < voxels; ++i) {
+        for (std::size_t slot { 0 }; slot < components; ++slot) {
+            float value { static_cast<float>(data[i * components + slot]) };
+            minimum[slot] = std::min(minimum[slot], value);
+            maximum[slot] = std::max(maximum[slot], value);
+        }
+    }
+
+    for (std::size_t slot { 0 }; slot < components; ++slot) {
+        ranges[components - 1 - slot] = glm::vec2 { minimum[slot], maximum[slot] };
+    }
+}
+
+/**
+ * Maps the components of each voxel from their range to [0, 1].
+ * Constant components become NaN, like in `PVMVolume`.
+ * @param input voxels to normalize, may be the same data as the output
+ * @param ranges minimum (x) and maximum (y) of each component
+ * @param output normalized voxels, with the extends and components of the input
+ */
+template <typename T, std::size_t Components>
+void normalize_voxels(VolumeView<T, Components> input, std::span<const glm::vec2> ranges,
+    VolumeView<float, Components> output)
+{
+    std::size_t components { input.components() };
+    auto offset = volume_view_detail::component_values<Components>(components, 0.0f);
+    auto extent = volume_view_detail::component_values<Components>(components, 0.0f);
+    for (std::size_t slot { 0 }; slot < components; ++slot) {
+        offset[slot] = ranges[components - 1 - slot].x;
+        extent[slot] = ranges[components - 1 - slot].y - ranges[components - 1 - slot].x;
+    }
+
+    const T* source { input.data() };
+    float* destination { output.data() };
+    std::size_t voxels { input.voxel_count() };
+    for (std::size_t i { 0 }; i < voxels; ++i) {
+        for (std::size_t slot { 0 }; slot < components; ++slot) {
+            float value { static_cast<float>(source[i * components + slot]) };
+            destination[i * components + slot] = (value - offset[slot]) / extent[slot];
+        }
+    }
+}
+
+/**
+ * Counts the normalized values of a component in equally sized bins covering [0, 1].
+ * @param view normalized voxels
+ * @param component voxel component
+ * @param bins number of bins, at least 1
+ * @return number of values in each bin
+ */
+template <typename T, std::size_t Components>
+std::vector<std::size_t> voxel_histogram(VolumeView<T, Components> view, std::size_t component, std::size_t bins)
+{
+    if (component >= view.components()) {
+        throw std::out_of_range("component index out of range");
+    }
+    if (bins == 0) {
+        throw std::invalid_argument("histogram requires at least one bin");
+    }
+
+    std::vector<std::size_t> histogram(bins, 0);
+    std::size_t components { view.components() };
+    const T* data { view.data() + (components - 1 - component) };
+    std::size_t voxels { view.voxel_count() };
+    float bin_scale { static_cast<float>(bins) };
+    for (std::size_t i { 0 }; i < voxels; ++i) {
+        ++histogram[volume_view_detail::histogram_bin(static_cast<float>(data[i * components]), bin_scale, bins)];
+    }
+    return histogram;
+}
+
+/**
+ * Computes the gradient of a component with central differences.
+ * The differences are one-sided at the borders, and zero along axes with a
+ * single voxel. The gradient is given in values per voxel, independent of
+ * the voxel scale.
+ * @param view voxels
+ * @param component voxel component
+ * @return gradient of each voxel, x-fastest
+ */
+template <typename T, std::size_t Components>
+std::vector<glm::vec3> voxel_gradient(VolumeView<T, Components> view, std::size_t component)
+{
+    if (component >= view.components()) {
+        throw std::out_of_range("component index out of range");
+    }
+
+    // The neighbors of all voxels are looked up from tables, so the inner
+    // loop has no special cases for the borders.
+    glm::vec<3, std::size_t> extends { view.extends() };
+    auto x_stencil = volume_view_detail::axis_stencil(extends.x, 1);
+    auto y_stencil = volume_view_detail::axis_stencil(extends.y, extends.x);
+    auto z_stencil = volume_view_detail::axis_stencil(extends.z, extends.x * extends.y);
+
+    std::size_t components { view.components() };
+    const T* data { view.data() + (components - 1 - component) };
+    std::vector<glm::vec3> gradient(view.voxel_count());
+    for (std::size_t z { 0 }; z < extends.z; ++z) {
+        for (std::size_t y { 0 }; y < extends.y; ++y) {
+            std::size_t row { view.voxel_index(0, y, z) };
+            std::size_t y_row { row - y * extends.x };
+            std::size_t z_row { row - z * extends.x * extends.y };
+            float y_weight { y_stencil.weight[y] };
+            float z_weight { z_stencil.weight[z] };
+            const T* y_lower { data + (y_row + y_stencil.lower[y]) * components };
+            const T* y_upper { data + (y_row + y_stencil.upper[y]) * components };
+            const T* z_lower { data + (z_row + z_stencil.lower[z]) * components };
+            const T* z_upper { data + (z_row + z_stencil.upper[z]) * components };
+            const T* x_row { data + row * components };
+            glm::vec3* output { gradient.data() + row };
+            for (std::size_t x { 0 }; x < extends.x; ++x) {
+                output[x] = glm::vec3 {
+                    (static_cast<float>(x_row[x_stencil.upper[x] * components])
+                        - static_cast<float>(x_row[x_stencil.lower[x] * components]))
+                        * x_stencil.weight[x],
+                    (static_cast<float>(y_upper[x * components]) - static_cast<float>(y_lower[x * components])) * y_weight,
+                    (static_cast<float>(z_upper[x * components]) - static_cast<float>(z_lower[x * components])) * z_weight,
+                };
+            }
+        }
+    }
+    return gradient;
+}
+
+/**
+ * Interpolates a component trilinearly.
+ * @param view voxels
+ * @param position finite position in voxel coordinates, with the voxel centers at integers, clamped to the volume
+ * @param component voxel component, not checked
+ * @return interpolated value
+ */
+template <typename T, std::size_t Components>
+float sample_voxel(VolumeView<T, Components> view, glm::vec3 position, std::size_t component)
+{
+    glm::vec<3, std::size_t> extends { view.extends() };
+    glm::vec3 upper_bound { glm::vec3 { extends - glm::vec<3, std::size_t> { 1 } } };
+    glm::vec3 p { glm::clamp(position, glm::vec3 { 0.0f }, upper_bound) };
+    glm::vec<3, std::size_t> lower { p };
+    glm::vec<3, std::size_t> upper { glm::min(lower + glm::vec<3, std::size_t> { 1 }, extends - glm::vec<3, std::size_t> { 1 }) };
+    glm::vec3 t { p - glm::vec3 { lower } };
+
+    auto value = [&](std::size_t x, std::size_t y, std::size_t z) { return static_cast<float>(view(x, y, z, component)); };
+    float c00 { glm::mix(value(lower.x, lower.y, lower.z), value(upper.x, lower.y, lower.z), t.x) };
+    float c10 { glm::mix(value(lower.x, upper.y, lower.z), value(upper.x, upper.y, lower.z), t.x) };
+    float c01 { glm::mix(value(lower.x, lower.y, upper.z), value(upper.x, lower.y, upper.z), t.x) };
+    float c11 { glm::mix(value(lower.x, upper.y, upper.z), value(upper.x, upper.y, upper.z), t.x) };
+    return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z);
+}
+
+/**
+ * Interpolates a component trilinearly at many positions.
+ * @param view voxels
+ * @param positions finite positions in voxel coordinates, with the voxel centers at integers, clamped to the volume
+ * @param component voxel component
+ * @param output interpolated value of each position
+ */
+template <typename T, std::size_t Components>
+void sample_voxels(VolumeView<T, Components> view, std::span<const glm::vec3> positions, std::size_t component,
+    std::span<float> output)
+{
+    if (component >= view.components()) {
+        throw std::out_of_range("component index out of range");
+    }
+    if (output.size() != positions.size()) {
+        throw std::invalid_argument("output size does not match the positions");
+    }
+
+    for (std::size_t i { 0 }; i < positions.size(); ++i) {
+        output[i] = sample_voxel(view, positions[i], component);
+    }
+}